@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Общие средства замеров. Каждый bench/*.cpp - отдельная программа, которой нужны только
+// заголовки репозитория:
+//   g++ -std=c++17 -O2 -DNDEBUG -pthread -I. bench/bench_pool_allocator.cpp -o bench_pool_allocator
+//   ./bench_pool_allocator [элементов] >> bench_output.txt
+// Время каждого замера - лучшее из нескольких повторов, чтобы отсечь случайные задержки.
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+// Размер задачи из первого аргумента командной строки или по умолчанию
+inline std::size_t size_arg(int argc, char** argv, std::size_t fallback) {
+  if (argc > 1) {
+    return static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10));
+  }
+  return fallback;
+}
+
+// Наименьшее время одного вызова f в секундах из repeats повторов
+template<typename F>
+double best_of(int repeats, F f) {
+  double best = 0;
+  for (int i = 0; i < repeats; ++i) {
+    auto start = Clock::now();
+    f();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (i == 0 || seconds < best) {
+      best = seconds;
+    }
+  }
+  return best;
+}
+
+// Не дает компилятору выбросить вычисление, результат которого иначе не используется
+inline volatile std::uint64_t sink;
+
+inline void keep(std::uint64_t value) {
+  sink = value;
+}
+
+inline std::vector<std::int64_t> sorted_keys(std::size_t count) {
+  std::vector<std::int64_t> keys(count);
+  std::iota(keys.begin(), keys.end(), std::int64_t(0));
+  return keys;
+}
+
+inline std::vector<std::int64_t> shuffled_keys(std::size_t count, std::uint64_t seed = 42) {
+  std::vector<std::int64_t> keys = sorted_keys(count);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64(seed));
+  return keys;
+}
+
+// Строка отчета: время на операцию и, если задано, на одну операцию базового варианта
+inline void report(const char* name, std::size_t operations, double seconds, double baseline = 0) {
+  double per_op = seconds * 1e9 / static_cast<double>(operations);
+  if (baseline > 0) {
+    std::printf("  %-44s %10.1f ns/op  x%.2f\n", name, per_op, baseline / seconds);
+  } else {
+    std::printf("  %-44s %10.1f ns/op\n", name, per_op);
+  }
+  std::fflush(stdout);
+}
+
+} // namespace bench
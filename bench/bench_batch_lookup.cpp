@@ -0,0 +1,45 @@
+// contains_batch против цикла по contains на дереве больше кэша последнего уровня.
+// Запросы приходят группами по 16, 64 и 256 ключей, как в одном запросе клиента.
+#include "bench/bench.h"
+#include "bst.h"
+
+using Tree = BinarySearchTree<std::int64_t, std::less<std::int64_t>, std::allocator<std::int64_t>, RedBlackBalance>;
+
+constexpr std::size_t kQueries = 1 << 20;
+
+int main(int argc, char** argv) {
+  // Узлы вставляются в случайном порядке и лежат в памяти вразброс относительно порядка ключей
+  std::size_t count = bench::size_arg(argc, argv, 1 << 22);
+  Tree tree;
+  for (std::int64_t key : bench::shuffled_keys(count)) {
+    tree.insert(2 * key);
+  }
+  std::mt19937_64 gen(5);
+  std::vector<std::int64_t> queries(kQueries);
+  for (std::int64_t& key : queries) {
+    key = static_cast<std::int64_t>(gen() % (2 * count));
+  }
+  std::printf("%zu keys (about %zu MB of nodes), %zu queries\n", count, count * 48 >> 20, kQueries);
+
+  double base = bench::best_of(3, [&] {
+    std::uint64_t found = 0;
+    for (std::int64_t key : queries) {
+      found += tree.contains(key) ? 1 : 0;
+    }
+    bench::keep(found);
+  });
+  bench::report("loop over contains", kQueries, base);
+  std::vector<char> results(kQueries);
+  for (std::size_t group : {16, 64, 256}) {
+    double seconds = bench::best_of(3, [&] {
+      for (std::size_t i = 0; i < kQueries; i += group) {
+        tree.contains_batch(queries.begin() + i, queries.begin() + i + group, results.begin() + i);
+      }
+      bench::keep(static_cast<std::uint64_t>(results[gen() % kQueries]));
+    });
+    char name[64];
+    std::snprintf(name, sizeof(name), "contains_batch, groups of %zu", group);
+    bench::report(name, kQueries, seconds, base);
+  }
+  return 0;
+}
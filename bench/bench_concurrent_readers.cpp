@@ -0,0 +1,79 @@
+// Масштабирование читателей ConcurrentTree: от 1 до 64 потоков выполняют contains по случайным
+// ключам, без писателя и при одном писателе, который непрерывно вставляет и удаляет ключи.
+// Печатается суммарная пропускная способность всех читателей.
+#include <atomic>
+#include <thread>
+
+#include "bench/bench.h"
+#include "concurrent_tree.h"
+
+using Tree = ConcurrentTree<std::int64_t>;
+
+constexpr std::size_t kQueriesPerThread = 1 << 18;
+
+// readers потоков выполняют по kQueriesPerThread поисков одновременно
+void readAll(const Tree& tree, std::size_t count, std::size_t readers) {
+  std::vector<std::thread> threads;
+  std::atomic<bool> start{false};
+  std::atomic<std::uint64_t> found{0};
+  for (std::size_t t = 0; t < readers; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937_64 gen(t + 1);
+      while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      std::uint64_t hits = 0;
+      for (std::size_t i = 0; i < kQueriesPerThread; ++i) {
+        hits += tree.contains(static_cast<std::int64_t>(gen() % (2 * count))) ? 1 : 0;
+      }
+      found.fetch_add(hits, std::memory_order_relaxed);
+    });
+  }
+  start.store(true, std::memory_order_release);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  bench::keep(found.load());
+}
+
+int main(int argc, char** argv) {
+  std::size_t count = bench::size_arg(argc, argv, 1 << 20);
+  Tree tree;
+  for (std::int64_t key : bench::shuffled_keys(count)) {
+    tree.insert(2 * key);
+  }
+  std::printf("%zu keys, %zu queries per reader, %u hardware threads\n", count, kQueriesPerThread,
+              std::thread::hardware_concurrency());
+
+  for (bool with_writer : {false, true}) {
+    std::printf(with_writer ? "one writer inserting and erasing odd keys:\n" : "readers only:\n");
+    std::atomic<bool> stop{false};
+    std::thread writer;
+    if (with_writer) {
+      writer = std::thread([&] {
+        std::mt19937_64 gen(99);
+        while (!stop.load(std::memory_order_relaxed)) {
+          std::int64_t key = static_cast<std::int64_t>(2 * (gen() % count) + 1);
+          tree.insert(key);
+          tree.erase(key);
+        }
+      });
+    }
+    double single = 0;
+    for (std::size_t readers = 1; readers <= 64; readers *= 2) {
+      double seconds = bench::best_of(3, [&] { readAll(tree, count, readers); });
+      double operations = static_cast<double>(readers * kQueriesPerThread);
+      if (readers == 1) {
+        single = operations / seconds;
+      }
+      std::printf("  %2zu readers  %8.2f Mops/s  x%.2f\n", readers, operations / seconds * 1e-6,
+                  operations / seconds / single);
+      std::fflush(stdout);
+    }
+    stop.store(true);
+    if (writer.joinable()) {
+      writer.join();
+    }
+  }
+  return 0;
+}
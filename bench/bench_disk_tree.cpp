@@ -0,0 +1,80 @@
+// DiskTree при разном бюджете буферного пула: 1x, 4x и 16x от базового бюджета, равного
+// 1/16 страниц файла, то есть от шестнадцатой части файла до всего файла в памяти.
+// Для каждого бюджета - случайные поиски, случайные вставки и полный обход, плюс число
+// прочитанных страниц на операцию. Файл лежит в страничном кэше ОС, поэтому промах пула
+// стоит системного вызова и копирования страницы, а не обращения к диску.
+#include <cstdio>
+#include <string>
+
+#include "bench/bench.h"
+#include "disk_tree.h"
+
+using Tree = DiskTree<std::int64_t>;
+
+constexpr std::size_t kQueries = 1 << 18;
+
+int main(int argc, char** argv) {
+  std::size_t count = bench::size_arg(argc, argv, 1 << 21);
+  std::string path = "bench_disk_tree.dat";
+  std::remove(path.c_str());
+  std::uint64_t file_pages = 0;
+  {
+    Tree tree(path.c_str(), 1024);
+    for (std::int64_t key : bench::shuffled_keys(count)) {
+      tree.insert(2 * key);
+    }
+    tree.flush();
+    file_pages = tree.buffer_pool().page_count();
+  }
+  std::size_t base = std::max<std::size_t>(Tree::kMinBufferPages, (file_pages + 15) / 16);
+  std::printf("%zu keys, %llu pages of %zu bytes, base budget %zu pages\n", count,
+              static_cast<unsigned long long>(file_pages), BufferPool::kPageSize, base);
+
+  std::mt19937_64 gen(11);
+  std::vector<std::int64_t> queries(kQueries);
+  for (std::int64_t& key : queries) {
+    key = static_cast<std::int64_t>(gen() % (2 * count));
+  }
+  for (std::size_t factor : {1, 4, 16}) {
+    std::size_t budget = base * factor;
+    std::printf("budget %zux (%zu pages):\n", factor, budget);
+    Tree tree(path.c_str(), budget);
+    char name[64];
+
+    std::uint64_t reads = tree.buffer_pool().reads();
+    double seconds = bench::best_of(3, [&] {
+      std::uint64_t found = 0;
+      for (std::int64_t key : queries) {
+        found += tree.contains(key) ? 1 : 0;
+      }
+      bench::keep(found);
+    });
+    double per_op = static_cast<double>(tree.buffer_pool().reads() - reads) / (3.0 * kQueries);
+    std::snprintf(name, sizeof(name), "contains (%.2f page reads/op)", per_op);
+    bench::report(name, kQueries, seconds);
+
+    reads = tree.buffer_pool().reads();
+    seconds = bench::best_of(1, [&] {
+      for (std::int64_t key : queries) {
+        tree.insert(key | 1); // Нечетные ключи, которых в файле нет
+      }
+    });
+    per_op = static_cast<double>(tree.buffer_pool().reads() - reads) / kQueries;
+    std::snprintf(name, sizeof(name), "insert (%.2f page reads/op)", per_op);
+    bench::report(name, kQueries, seconds);
+    for (std::int64_t key : queries) {
+      tree.erase(key | 1);
+    }
+
+    seconds = bench::best_of(3, [&] {
+      std::uint64_t sum = 0;
+      for (std::int64_t value : tree) {
+        sum += static_cast<std::uint64_t>(value);
+      }
+      bench::keep(sum);
+    });
+    bench::report("in-order scan", count, seconds);
+  }
+  std::remove(path.c_str());
+  return 0;
+}
@@ -0,0 +1,98 @@
+// Пропускная способность FineGrainedTree в зависимости от числа потоков против
+// BinarySearchTree под одним std::mutex. Каждый поток выполняет смесь операций над случайными
+// ключами: половина - contains, по четверти - insert и erase; дерево заполнено наполовину.
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "bench/bench.h"
+#include "bst.h"
+#include "fine_grained_tree.h"
+
+constexpr std::size_t kOperationsPerThread = 1 << 18;
+
+// Красно-черное дерево, все операции которого сериализует один мьютекс
+class LockedTree {
+ public:
+  bool contains(std::int64_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tree_.contains(key);
+  }
+
+  bool insert(std::int64_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tree_.insert(key).second;
+  }
+
+  std::size_t erase(std::int64_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tree_.erase(key);
+  }
+
+ private:
+  std::mutex mutex_;
+  BinarySearchTree<std::int64_t, std::less<std::int64_t>, std::allocator<std::int64_t>, RedBlackBalance> tree_;
+};
+
+template<typename Tree>
+void runMix(Tree& tree, std::size_t count, std::size_t threads_count) {
+  std::vector<std::thread> threads;
+  std::atomic<bool> start{false};
+  std::atomic<std::uint64_t> result{0};
+  for (std::size_t t = 0; t < threads_count; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937_64 gen(t + 7);
+      while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      std::uint64_t changed = 0;
+      for (std::size_t i = 0; i < kOperationsPerThread; ++i) {
+        std::uint64_t random = gen();
+        std::int64_t key = static_cast<std::int64_t>((random >> 2) % (2 * count));
+        switch (random & 3) {
+          case 0:
+            changed += tree.insert(key) ? 1 : 0;
+            break;
+          case 1:
+            changed += tree.erase(key);
+            break;
+          default:
+            changed += tree.contains(key) ? 1 : 0;
+        }
+      }
+      result.fetch_add(changed, std::memory_order_relaxed);
+    });
+  }
+  start.store(true, std::memory_order_release);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  bench::keep(result.load());
+}
+
+template<typename Tree>
+void fill(Tree& tree, std::size_t count) {
+  for (std::int64_t key : bench::shuffled_keys(count)) {
+    tree.insert(2 * key);
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t count = bench::size_arg(argc, argv, 1 << 20);
+  FineGrainedTree<std::int64_t> fine;
+  LockedTree locked;
+  fill(fine, count);
+  fill(locked, count);
+  std::printf("%zu keys, %zu operations per thread, %u hardware threads\n", count, kOperationsPerThread,
+              std::thread::hardware_concurrency());
+  std::printf("  threads   mutex + BinarySearchTree   FineGrainedTree\n");
+  for (std::size_t threads = 1; threads <= 64; threads *= 2) {
+    double operations = static_cast<double>(threads * kOperationsPerThread);
+    double base = bench::best_of(3, [&] { runMix(locked, count, threads); });
+    double seconds = bench::best_of(3, [&] { runMix(fine, count, threads); });
+    std::printf("  %7zu   %17.2f Mops/s   %8.2f Mops/s  x%.2f\n", threads, operations / base * 1e-6,
+                operations / seconds * 1e-6, base / seconds);
+    std::fflush(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,86 @@
+// Снимок freeze() против живого красно-черного дерева: contains и lower_bound по случайным
+// ключам (половина есть в множестве) и полный обход по возрастанию, для деревьев от
+// помещающихся в кэш до превышающих его.
+#include "bench/bench.h"
+#include "bst.h"
+
+using Tree = BinarySearchTree<std::int64_t, std::less<std::int64_t>, std::allocator<std::int64_t>, RedBlackBalance>;
+
+constexpr std::size_t kQueries = 1 << 20;
+
+template<typename Set>
+double lookups(const Set& set, const std::vector<std::int64_t>& queries) {
+  return bench::best_of(3, [&] {
+    std::uint64_t found = 0;
+    for (std::int64_t key : queries) {
+      found += set.contains(key) ? 1 : 0;
+    }
+    bench::keep(found);
+  });
+}
+
+template<typename It>
+double scan(It first, It last) {
+  return bench::best_of(3, [&] {
+    std::uint64_t sum = 0;
+    for (It it = first; it != last; ++it) {
+      sum += static_cast<std::uint64_t>(*it);
+    }
+    bench::keep(sum);
+  });
+}
+
+void run(std::size_t count) {
+  // Ключи четные, запросы - любые числа из того же диапазона: половина промахивается
+  std::vector<std::int64_t> keys = bench::shuffled_keys(count);
+  Tree tree;
+  for (std::int64_t& key : keys) {
+    key *= 2;
+    tree.insert(key);
+  }
+  auto frozen = tree.freeze();
+  std::mt19937_64 gen(3);
+  std::vector<std::int64_t> queries(kQueries);
+  for (std::int64_t& key : queries) {
+    key = static_cast<std::int64_t>(gen() % (2 * count));
+  }
+  std::printf("%zu keys, %zu queries\n", count, kQueries);
+  double base = lookups(tree, queries);
+  bench::report("contains, live tree", kQueries, base);
+  bench::report("contains, frozen", kQueries, lookups(frozen, queries), base);
+  auto live_bound = [&] {
+    return bench::best_of(3, [&] {
+      std::uint64_t sum = 0;
+      for (std::int64_t key : queries) {
+        auto it = tree.lower_bound(key);
+        sum += static_cast<std::uint64_t>(it == tree.end<InOrder>() ? 0 : *it);
+      }
+      bench::keep(sum);
+    });
+  };
+  auto frozen_bound = [&] {
+    return bench::best_of(3, [&] {
+      std::uint64_t sum = 0;
+      for (std::int64_t key : queries) {
+        auto it = frozen.lower_bound(key);
+        sum += static_cast<std::uint64_t>(it == frozen.end() ? 0 : *it);
+      }
+      bench::keep(sum);
+    });
+  };
+  base = live_bound();
+  bench::report("lower_bound, live tree", kQueries, base);
+  bench::report("lower_bound, frozen", kQueries, frozen_bound(), base);
+  base = scan(tree.begin<InOrder>(), tree.end<InOrder>());
+  bench::report("in-order scan, live tree", count, base);
+  bench::report("in-order scan, frozen", count, scan(frozen.begin(), frozen.end()), base);
+  bench::report("freeze()", count, bench::best_of(3, [&] { bench::keep(tree.freeze().size()); }));
+}
+
+int main(int argc, char** argv) {
+  std::size_t largest = bench::size_arg(argc, argv, 1 << 22);
+  for (std::size_t count = 1 << 10; count <= largest; count <<= 4) {
+    run(count);
+  }
+  return 0;
+}
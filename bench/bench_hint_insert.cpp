@@ -0,0 +1,62 @@
+// Вставка с подсказкой end() против обычной вставки на потоках ключей по возрастанию,
+// почти отсортированном (1% ключей переставлен на небольшое расстояние) и случайном.
+// Последний столбец - ускорение относительно insert(value).
+#include "bench/bench.h"
+#include "bst.h"
+
+// Каждый сотый ключ меняется местами с ключом на расстоянии до 16 позиций
+std::vector<std::int64_t> nearlySorted(std::size_t count) {
+  std::vector<std::int64_t> keys = bench::sorted_keys(count);
+  std::mt19937_64 gen(7);
+  for (std::size_t i = 0; i + 16 < count; i += 100) {
+    std::swap(keys[i], keys[i + 1 + gen() % 16]);
+  }
+  return keys;
+}
+
+template<typename Tree>
+double plainInsert(const std::vector<std::int64_t>& keys) {
+  return bench::best_of(3, [&] {
+    Tree tree;
+    for (std::int64_t key : keys) {
+      tree.insert(key);
+    }
+    bench::keep(tree.size());
+  });
+}
+
+// size() в конце входит в замер: он досчитывает отложенные размеры поддеревьев
+template<typename Tree>
+double hintedInsert(const std::vector<std::int64_t>& keys) {
+  return bench::best_of(3, [&] {
+    Tree tree;
+    for (std::int64_t key : keys) {
+      tree.insert(tree.template end<InOrder>(), key);
+    }
+    bench::keep(tree.size());
+  });
+}
+
+template<typename Tree>
+void run(const char* title, const std::vector<std::int64_t>& keys) {
+  std::printf("%s\n", title);
+  double base = plainInsert<Tree>(keys);
+  bench::report("insert(value)", keys.size(), base);
+  bench::report("insert(end(), value)", keys.size(), hintedInsert<Tree>(keys), base);
+}
+
+template<typename Balance>
+void runAll(const char* balance, std::size_t count) {
+  using Tree = BinarySearchTree<std::int64_t, std::less<std::int64_t>, std::allocator<std::int64_t>, Balance>;
+  std::printf("== %s, %zu keys\n", balance, count);
+  run<Tree>("monotonic", bench::sorted_keys(count));
+  run<Tree>("nearly sorted", nearlySorted(count));
+  run<Tree>("random", bench::shuffled_keys(count));
+}
+
+int main(int argc, char** argv) {
+  std::size_t count = bench::size_arg(argc, argv, 1 << 20);
+  runAll<RedBlackBalance>("RedBlackBalance", count);
+  runAll<AvlBalance>("AvlBalance", count);
+  return 0;
+}
@@ -0,0 +1,59 @@
+// LoggedTree: стоимость вставки при группах по 1, 64 и 1024 изменения на fdatasync и время
+// восстановления при открытии - из одного журнала и из снимка с хвостом журнала.
+// Файлы создаются в текущем каталоге, поэтому fdatasync идет на настоящий диск.
+#include <cstdio>
+#include <string>
+
+#include "bench/bench.h"
+#include "log_tree.h"
+
+using Tree = BinarySearchTree<std::int64_t, std::less<std::int64_t>, std::allocator<std::int64_t>, RedBlackBalance>;
+
+void removeFiles(const std::string& path) {
+  std::remove((path + ".log").c_str());
+  std::remove((path + ".snapshot").c_str());
+}
+
+int main(int argc, char** argv) {
+  std::size_t count = bench::size_arg(argc, argv, 1 << 20);
+  std::string path = "bench_logged_tree";
+  std::vector<std::int64_t> keys = bench::shuffled_keys(count);
+  std::printf("%zu keys\n", count);
+
+  // При группе из одного изменения fdatasync на каждую вставку, поэтому вставок меньше
+  for (std::size_t group : {1, 64, 1024}) {
+    std::size_t inserts = group == 1 ? std::min<std::size_t>(count, 2000) : count;
+    removeFiles(path);
+    double seconds = bench::best_of(1, [&] {
+      LoggedTree<Tree> tree(path, group);
+      for (std::size_t i = 0; i < inserts; ++i) {
+        tree.insert(keys[i]);
+      }
+      tree.commit();
+    });
+    char name[64];
+    std::snprintf(name, sizeof(name), "insert, group of %zu", group);
+    bench::report(name, inserts, seconds);
+  }
+
+  // Последний прогон оставил журнал на count записей без снимка
+  double seconds = bench::best_of(3, [&] {
+    LoggedTree<Tree> tree(path);
+    bench::keep(tree.size());
+  });
+  bench::report("recover from log only", count, seconds);
+  {
+    LoggedTree<Tree> tree(path);
+    tree.checkpoint();
+    for (std::size_t i = 0; i < count / 10; ++i) {
+      tree.erase(keys[i]);
+    }
+  }
+  seconds = bench::best_of(3, [&] {
+    LoggedTree<Tree> tree(path);
+    bench::keep(tree.size());
+  });
+  bench::report("recover from snapshot + 10% log", count, seconds);
+  removeFiles(path);
+  return 0;
+}
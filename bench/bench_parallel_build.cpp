@@ -0,0 +1,46 @@
+// Построение дерева из неотсортированного диапазона: assign_parallel на пуле потоков против
+// повторной вставки и конструктора std::set от диапазона. Ключи случайные, с повторами.
+#include <set>
+#include <thread>
+
+#include "bench/bench.h"
+#include "bst.h"
+#include "thread_pool.h"
+
+using Tree = BinarySearchTree<std::int64_t, std::less<std::int64_t>, std::allocator<std::int64_t>, RedBlackBalance>;
+
+int main(int argc, char** argv) {
+  std::size_t count = bench::size_arg(argc, argv, 1 << 22);
+  std::vector<std::int64_t> values(count);
+  std::mt19937_64 gen(3);
+  for (std::int64_t& value : values) {
+    value = static_cast<std::int64_t>(gen() % count);
+  }
+  std::printf("%zu random values, %u hardware threads\n", count, std::thread::hardware_concurrency());
+
+  double base = bench::best_of(3, [&] {
+    Tree tree;
+    for (std::int64_t value : values) {
+      tree.insert(value);
+    }
+    bench::keep(tree.size());
+  });
+  bench::report("repeated insert", count, base);
+  double seconds = bench::best_of(3, [&] {
+    std::set<std::int64_t> set(values.begin(), values.end());
+    bench::keep(set.size());
+  });
+  bench::report("std::set range constructor", count, seconds, base);
+  for (std::size_t workers : {1, 2, 4, 8}) {
+    ThreadPool pool(workers);
+    seconds = bench::best_of(3, [&] {
+      Tree tree;
+      tree.assign_parallel(pool, values.begin(), values.end());
+      bench::keep(tree.size());
+    });
+    char name[64];
+    std::snprintf(name, sizeof(name), "assign_parallel, %zu workers", workers);
+    bench::report(name, count, seconds, base);
+  }
+  return 0;
+}
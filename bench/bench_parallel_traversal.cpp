@@ -0,0 +1,48 @@
+// Масштабирование параллельных reduce, count_if и for_each на дереве из 10M элементов
+// против последовательного обхода итераторами. Пул создается с 1, 2, 4 и 8 рабочими потоками.
+#include <thread>
+
+#include "bench/bench.h"
+#include "bst.h"
+#include "thread_pool.h"
+
+using Tree = BinarySearchTree<std::int64_t, std::less<std::int64_t>, std::allocator<std::int64_t>, RedBlackBalance>;
+
+int main(int argc, char** argv) {
+  std::size_t count = bench::size_arg(argc, argv, 10'000'000);
+  std::vector<std::int64_t> keys = bench::sorted_keys(count);
+  Tree tree(SortedUnique(), keys.begin(), keys.end());
+  keys = {};
+  std::printf("%zu elements, %u hardware threads\n", count, std::thread::hardware_concurrency());
+
+  double sequential = bench::best_of(3, [&] {
+    std::uint64_t sum = 0;
+    for (auto it = tree.begin<InOrder>(); it != tree.end<InOrder>(); ++it) {
+      sum += static_cast<std::uint64_t>(*it);
+    }
+    bench::keep(sum);
+  });
+  bench::report("sequential sum over iterators", count, sequential);
+  for (std::size_t workers : {1, 2, 4, 8}) {
+    ThreadPool pool(workers);
+    char name[64];
+    double seconds = bench::best_of(3, [&] { bench::keep(tree.reduce(pool, std::int64_t(0), std::plus<>())); });
+    std::snprintf(name, sizeof(name), "reduce, %zu workers", workers);
+    bench::report(name, count, seconds, sequential);
+    seconds = bench::best_of(3, [&] {
+      bench::keep(tree.count_if(pool, [](std::int64_t value) { return value % 3 == 0; }));
+    });
+    std::snprintf(name, sizeof(name), "count_if, %zu workers", workers);
+    bench::report(name, count, seconds, sequential);
+    seconds = bench::best_of(3, [&] {
+      tree.for_each(pool, [](std::int64_t value) {
+        if (value < 0) {
+          bench::keep(static_cast<std::uint64_t>(value));
+        }
+      });
+    });
+    std::snprintf(name, sizeof(name), "for_each, %zu workers", workers);
+    bench::report(name, count, seconds, sequential);
+  }
+  return 0;
+}
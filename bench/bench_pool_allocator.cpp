@@ -0,0 +1,87 @@
+// PoolAllocator против std::allocator на красно-черном дереве: вставки и удаления
+// по возрастанию и вразнобой, их смесь на дереве постоянного размера и clear.
+#include "bench/bench.h"
+#include "bst.h"
+#include "pool_allocator.h"
+
+template<typename Alloc>
+using Tree = BinarySearchTree<std::int64_t, std::less<std::int64_t>, Alloc, RedBlackBalance>;
+
+// Вставка всех ключей, затем удаление в том же порядке
+template<typename Alloc>
+double insertErase(const std::vector<std::int64_t>& keys) {
+  return bench::best_of(3, [&] {
+    Tree<Alloc> tree;
+    for (std::int64_t key : keys) {
+      tree.insert(key);
+    }
+    for (std::int64_t key : keys) {
+      tree.erase(key);
+    }
+    bench::keep(tree.size());
+  });
+}
+
+// Дерево из половины ключей, затем поочередно удаление имеющегося и вставка отсутствующего
+template<typename Alloc>
+double churn(const std::vector<std::int64_t>& keys) {
+  std::size_t half = keys.size() / 2;
+  Tree<Alloc> tree;
+  for (std::size_t i = 0; i < half; ++i) {
+    tree.insert(keys[i]);
+  }
+  return bench::best_of(3, [&] {
+    for (std::size_t i = 0; i < half; ++i) {
+      tree.erase(keys[i]);
+      tree.insert(keys[half + i]);
+    }
+    for (std::size_t i = 0; i < half; ++i) {
+      tree.erase(keys[half + i]);
+      tree.insert(keys[i]);
+    }
+    bench::keep(tree.size());
+  });
+}
+
+// Время только clear, без построения дерева; лучшее из трех
+template<typename Alloc>
+double clearTree(const std::vector<std::int64_t>& keys) {
+  double best = 0;
+  for (int i = 0; i < 3; ++i) {
+    Tree<Alloc> tree;
+    for (std::int64_t key : keys) {
+      tree.insert(key);
+    }
+    double seconds = bench::best_of(1, [&] { tree.clear(); });
+    if (i == 0 || seconds < best) {
+      best = seconds;
+    }
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+  std::size_t count = bench::size_arg(argc, argv, 1 << 20);
+  std::vector<std::int64_t> sequential = bench::sorted_keys(count);
+  std::vector<std::int64_t> random = bench::shuffled_keys(count);
+  using Std = std::allocator<std::int64_t>;
+  using Pool = PoolAllocator<std::int64_t>;
+  std::printf("PoolAllocator vs std::allocator, %zu keys, RedBlackBalance\n", count);
+
+  double base = insertErase<Std>(sequential);
+  bench::report("sequential insert+erase, std::allocator", 2 * count, base);
+  bench::report("sequential insert+erase, PoolAllocator", 2 * count, insertErase<Pool>(sequential), base);
+  base = insertErase<Std>(random);
+  bench::report("random insert+erase, std::allocator", 2 * count, base);
+  bench::report("random insert+erase, PoolAllocator", 2 * count, insertErase<Pool>(random), base);
+  base = churn<Std>(sequential);
+  bench::report("sequential erase/insert churn, std::allocator", 2 * count, base);
+  bench::report("sequential erase/insert churn, PoolAllocator", 2 * count, churn<Pool>(sequential), base);
+  base = churn<Std>(random);
+  bench::report("random erase/insert churn, std::allocator", 2 * count, base);
+  bench::report("random erase/insert churn, PoolAllocator", 2 * count, churn<Pool>(random), base);
+  base = clearTree<Std>(random);
+  bench::report("clear, std::allocator", count, base);
+  bench::report("clear, PoolAllocator", count, clearTree<Pool>(random), base);
+  return 0;
+}
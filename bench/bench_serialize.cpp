@@ -0,0 +1,59 @@
+// Скорость save и load в памяти (std::stringstream не участвует: поток пишет в заранее
+// выделенный буфер) в ГБ/с полезных данных. Для сравнения - построение того же дерева
+// повторной вставкой из отсортированного массива.
+#include <streambuf>
+
+#include "bench/bench.h"
+#include "bst.h"
+
+using Tree = BinarySearchTree<std::int64_t, std::less<std::int64_t>, std::allocator<std::int64_t>, RedBlackBalance>;
+
+// Поток поверх массива байтов без перевыделений
+class ArrayBuffer : public std::streambuf {
+ public:
+  explicit ArrayBuffer(std::size_t bytes) : data_(bytes) {
+    rewind();
+  }
+
+  void rewind() {
+    setp(data_.data(), data_.data() + data_.size());
+    setg(data_.data(), data_.data(), data_.data() + data_.size());
+  }
+
+ private:
+  std::vector<char> data_;
+};
+
+int main(int argc, char** argv) {
+  std::size_t count = bench::size_arg(argc, argv, 1 << 23);
+  std::vector<std::int64_t> keys = bench::sorted_keys(count);
+  Tree tree(SortedUnique(), keys.begin(), keys.end());
+  double gigabytes = static_cast<double>(count * sizeof(std::int64_t)) / 1e9;
+  ArrayBuffer buffer(count * sizeof(std::int64_t) + 4096);
+  std::ostream out(&buffer);
+  std::istream in(&buffer);
+  std::printf("%zu keys, %.2f GB of values\n", count, gigabytes);
+
+  double seconds = bench::best_of(5, [&] {
+    buffer.rewind();
+    tree.save(out);
+  });
+  std::printf("  %-44s %10.2f GB/s\n", "save", gigabytes / seconds);
+  seconds = bench::best_of(5, [&] {
+    buffer.rewind();
+    Tree loaded;
+    loaded.load(in);
+    bench::keep(loaded.size());
+  });
+  std::printf("  %-44s %10.2f GB/s\n", "load", gigabytes / seconds);
+  double insert = bench::best_of(3, [&] {
+    Tree built;
+    for (std::int64_t key : keys) {
+      built.insert(built.end<InOrder>(), key);
+    }
+    bench::keep(built.size());
+  });
+  std::printf("  %-44s %10.2f GB/s  load x%.2f\n", "hinted insert of sorted keys", gigabytes / insert,
+              insert / seconds);
+  return 0;
+}
@@ -0,0 +1,68 @@
+// Полный обход вперед и назад для каждого тега обхода: прошитое дерево (Threaded) против
+// обычного, где шаг идет по ссылкам на родителя. Прошивка ускоряет только InOrder;
+// PreOrder и PostOrder приведены, чтобы было видно, что на них она не влияет.
+#include "bench/bench.h"
+#include "bst.h"
+
+template<typename Threading>
+using Tree = BinarySearchTree<std::int64_t, std::less<std::int64_t>, std::allocator<std::int64_t>, RedBlackBalance,
+                              NoAugment, Threading>;
+
+template<typename Tag, typename Tree>
+double forward(const Tree& tree) {
+  return bench::best_of(5, [&] {
+    std::uint64_t sum = 0;
+    for (auto it = tree.template begin<Tag>(); it != tree.template end<Tag>(); ++it) {
+      sum += static_cast<std::uint64_t>(*it);
+    }
+    bench::keep(sum);
+  });
+}
+
+template<typename Tag, typename Tree>
+double backward(const Tree& tree) {
+  return bench::best_of(5, [&] {
+    std::uint64_t sum = 0;
+    auto first = tree.template begin<Tag>();
+    for (auto it = tree.template end<Tag>(); it != first;) {
+      --it;
+      sum += static_cast<std::uint64_t>(*it);
+    }
+    bench::keep(sum);
+  });
+}
+
+// Обход назад начинается с --end(), чего PreOrder не поддерживает
+template<typename Tag>
+void compare(const char* tag, const Tree<Unthreaded>& plain, const Tree<Threaded>& threaded, std::size_t count) {
+  char name[64];
+  double base = forward<Tag>(plain);
+  std::snprintf(name, sizeof(name), "%s ++, parent walk", tag);
+  bench::report(name, count, base);
+  std::snprintf(name, sizeof(name), "%s ++, threaded", tag);
+  bench::report(name, count, forward<Tag>(threaded), base);
+  if constexpr (std::is_same_v<Tag, PreOrder>) {
+    return;
+  }
+  base = backward<Tag>(plain);
+  std::snprintf(name, sizeof(name), "%s --, parent walk", tag);
+  bench::report(name, count, base);
+  std::snprintf(name, sizeof(name), "%s --, threaded", tag);
+  bench::report(name, count, backward<Tag>(threaded), base);
+}
+
+int main(int argc, char** argv) {
+  // Случайный порядок вставки разбрасывает узлы в памяти относительно порядка ключей
+  std::size_t count = bench::size_arg(argc, argv, 1 << 20);
+  Tree<Unthreaded> plain;
+  Tree<Threaded> threaded;
+  for (std::int64_t key : bench::shuffled_keys(count)) {
+    plain.insert(key);
+    threaded.insert(key);
+  }
+  std::printf("%zu keys, red-black tree\n", count);
+  compare<InOrder>("InOrder", plain, threaded, count);
+  compare<PreOrder>("PreOrder", plain, threaded, count);
+  compare<PostOrder>("PostOrder", plain, threaded, count);
+  return 0;
+}
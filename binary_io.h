@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Сохраненные данные повреждены, обрезаны или записаны для другого типа
+class FormatError : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+template<typename T>
+struct BinarySerializer;
+
+// Общий заголовок сохраненных контейнеров: сигнатура контейнера, версия формата, метка порядка
+// байтов, размер значения, флаги и количество элементов. Числа пишутся в порядке байтов
+// платформы; файл с другим порядком отвергается при чтении по метке.
+struct BinaryFormat {
+  static constexpr std::uint32_t kVersion = 1;
+  static constexpr std::uint32_t kByteOrderMark = 0x01020304;
+  static constexpr std::uint32_t kRawFlag = 1; // Значения записаны сплошным блоком байтов
+  // Размер заголовка в байтах
+  static constexpr std::size_t kHeaderBytes = 4 + 4 * sizeof(std::uint32_t) + sizeof(std::uint64_t);
+
+  struct Header {
+    std::uint32_t value_size;
+    std::uint32_t flags;
+    std::uint64_t count;
+  };
+
+  static void writeBytes(std::ostream& out, const void* data, std::size_t bytes) {
+    if (!out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes))) {
+      throw std::ios_base::failure("BinaryFormat: write failed");
+    }
+  }
+
+  static void readBytes(std::istream& in, void* data, std::size_t bytes) {
+    if (!in.read(static_cast<char*>(data), static_cast<std::streamsize>(bytes))) {
+      throw FormatError("BinaryFormat: unexpected end of stream");
+    }
+  }
+
+  template<typename U>
+  static void writeNumber(std::ostream& out, U value) {
+    writeBytes(out, &value, sizeof(U));
+  }
+
+  template<typename U>
+  static U readNumber(std::istream& in) {
+    U value;
+    readBytes(in, &value, sizeof(U));
+    return value;
+  }
+
+  static void writeHeader(std::ostream& out, const char (&magic)[5], const Header& header) {
+    unsigned char bytes[kHeaderBytes];
+    writeHeader(bytes, magic, header);
+    writeBytes(out, bytes, kHeaderBytes);
+  }
+
+  // То же в память, например в страницу файла; нужно kHeaderBytes байт
+  static void writeHeader(unsigned char* data, const char (&magic)[5], const Header& header) {
+    std::memcpy(data, magic, 4);
+    storeNumber(data + 4, kVersion);
+    storeNumber(data + 8, kByteOrderMark);
+    storeNumber(data + 12, header.value_size);
+    storeNumber(data + 16, header.flags);
+    storeNumber(data + 20, header.count);
+  }
+
+  // Проверяет сигнатуру, версию и порядок байтов; размер значения и флаги проверяет вызывающий
+  static Header readHeader(std::istream& in, const char (&magic)[5]) {
+    unsigned char bytes[kHeaderBytes];
+    readBytes(in, bytes, kHeaderBytes);
+    return readHeader(bytes, kHeaderBytes, magic);
+  }
+
+  // То же для заголовка, уже лежащего в памяти, например в отображенном файле
+  static Header readHeader(const unsigned char* data, std::size_t size, const char (&magic)[5]) {
+    if (size < kHeaderBytes) {
+      throw FormatError("BinaryFormat: unexpected end of data");
+    }
+    if (std::memcmp(data, magic, 4) != 0) {
+      throw FormatError("BinaryFormat: wrong signature");
+    }
+    if (loadNumber<std::uint32_t>(data + 4) != kVersion) {
+      throw FormatError("BinaryFormat: unsupported version");
+    }
+    if (loadNumber<std::uint32_t>(data + 8) != kByteOrderMark) {
+      throw FormatError("BinaryFormat: foreign byte order");
+    }
+    Header header;
+    header.value_size = loadNumber<std::uint32_t>(data + 12);
+    header.flags = loadNumber<std::uint32_t>(data + 16);
+    header.count = loadNumber<std::uint64_t>(data + 20);
+    return header;
+  }
+
+  template<typename U>
+  static void storeNumber(unsigned char* data, U value) {
+    std::memcpy(data, &value, sizeof(U));
+  }
+
+  // U не обязан иметь конструктор по умолчанию: байты копируются в неинициализированный член union
+  template<typename U>
+  static U loadNumber(const unsigned char* data) {
+    union Raw {
+      U value;
+      Raw() noexcept {}
+    } raw;
+    std::memcpy(std::addressof(raw.value), data, sizeof(U));
+    return raw.value;
+  }
+
+  // Заголовок для значений типа T
+  template<typename T>
+  static Header headerFor(std::uint64_t count) {
+    return Header{static_cast<std::uint32_t>(sizeof(T)), BinarySerializer<T>::kRaw ? kRawFlag : 0, count};
+  }
+
+  template<typename T>
+  static bool matches(const Header& header) {
+    Header expected = headerFor<T>(header.count);
+    return header.value_size == expected.value_size && header.flags == expected.flags;
+  }
+};
+
+// Двоичное представление значения. Тривиально копируемые типы пишутся байтами как есть (kRaw),
+// и контейнеры переносят их целыми блоками. Для остальных типов нужна специализация с
+// kRaw = false и функциями write/read.
+template<typename T>
+struct BinarySerializer {
+  static_assert(std::is_trivially_copyable_v<T>, "BinarySerializer must be specialized for this type");
+
+  static constexpr bool kRaw = true;
+
+  static void write(std::ostream& out, const T& value) {
+    BinaryFormat::writeBytes(out, &value, sizeof(T));
+  }
+
+  static T read(std::istream& in);
+};
+
+// Строка: длина в символах, затем символы
+template<typename Char, typename Traits, typename Alloc>
+struct BinarySerializer<std::basic_string<Char, Traits, Alloc>> {
+  static_assert(std::is_trivially_copyable_v<Char>);
+
+  static constexpr bool kRaw = false;
+
+  static void write(std::ostream& out, const std::basic_string<Char, Traits, Alloc>& value);
+  static std::basic_string<Char, Traits, Alloc> read(std::istream& in);
+};
+
+template<typename T>
+T BinarySerializer<T>::read(std::istream& in) {
+  union Raw {
+    T value;
+    Raw() noexcept {}
+  } raw; // Как и в BinaryFormat::loadNumber, конструктор по умолчанию у T не нужен
+  BinaryFormat::readBytes(in, std::addressof(raw.value), sizeof(T));
+  return raw.value;
+}
+
+template<typename Char, typename Traits, typename Alloc>
+void BinarySerializer<std::basic_string<Char, Traits, Alloc>>::write(
+    std::ostream& out, const std::basic_string<Char, Traits, Alloc>& value) {
+  BinaryFormat::writeNumber<std::uint64_t>(out, value.size());
+  BinaryFormat::writeBytes(out, value.data(), value.size() * sizeof(Char));
+}
+
+template<typename Char, typename Traits, typename Alloc>
+std::basic_string<Char, Traits, Alloc> BinarySerializer<std::basic_string<Char, Traits, Alloc>>::read(
+    std::istream& in) {
+  std::uint64_t length = BinaryFormat::readNumber<std::uint64_t>(in);
+  std::basic_string<Char, Traits, Alloc> value;
+  // Длина из поврежденного файла может быть огромной, поэтому строка растет по мере чтения
+  constexpr std::uint64_t kChunk = 4096;
+  while (length != 0) {
+    std::uint64_t part = length < kChunk ? length : kChunk;
+    std::size_t offset = value.size();
+    value.resize(offset + part);
+    BinaryFormat::readBytes(in, &value[offset], part * sizeof(Char));
+    length -= part;
+  }
+  return value;
+}
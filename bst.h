@@ -1,12 +1,628 @@
+#pragma once
+
 #include <memory>
 #include <functional>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "binary_io.h"
+#include "frozen_tree.h"
+#include "thread_pool.h"
 
 // Определение тегов для различных видов обхода
 struct InOrder {};
 struct PreOrder {};
 struct PostOrder {};
 
-template<typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+// Тег для построения дерева из уже отсортированного диапазона без повторов
+struct SortedUnique {};
+
+// Общие структурные операции для политик балансировки.
+// После любого изменения ссылок узла вызывается node->pull(), пересчитывающий
+// размер поддерева (и сводку аугментации) по потомкам.
+struct BalanceBase {
+ protected:
+  // Пересчитывает служебные данные от узла до корня
+  template<typename Node>
+  static void pull_up(Node* node) {
+    for (; node != nullptr; node = node->parent) {
+      node->pull();
+    }
+  }
+
+  template<typename Node>
+  static Node* minimum(Node* node) {
+    while (node->left != nullptr) {
+      node = node->left;
+    }
+    return node;
+  }
+
+  // Ставит поддерево new_node на место узла old_node
+  template<typename Node>
+  static void transplant(Node*& root, Node* old_node, Node* new_node) {
+    if (old_node->parent == nullptr) {
+      root = new_node;
+    } else if (old_node == old_node->parent->left) {
+      old_node->parent->left = new_node;
+    } else {
+      old_node->parent->right = new_node;
+    }
+    if (new_node != nullptr) {
+      new_node->parent = old_node->parent;
+    }
+  }
+
+  // Вырезает узел из дерева, не трогая значения. Если у узла два потомка, на его место
+  // переносится преемник. Возвращает узел, который фактически покинул свою позицию
+  // (сам z или его преемник), в x - поддерево, занявшее эту позицию, в x_parent - его родителя.
+  template<typename Node>
+  static Node* splice_out(Node*& root, Node* z, Node*& x, Node*& x_parent) {
+    Node* y = z;
+    if (z->left == nullptr) {
+      x = z->right;
+      x_parent = z->parent;
+      transplant(root, z, z->right);
+    } else if (z->right == nullptr) {
+      x = z->left;
+      x_parent = z->parent;
+      transplant(root, z, z->left);
+    } else {
+      y = minimum(z->right);
+      x = y->right;
+      if (y->parent == z) {
+        x_parent = y;
+      } else {
+        x_parent = y->parent;
+        transplant(root, y, y->right);
+        y->right = z->right;
+        y->right->parent = y;
+      }
+      transplant(root, z, y);
+      y->left = z->left;
+      y->left->parent = y;
+    }
+    z->left = z->right = z->parent = nullptr;
+    pull_up(x_parent); // Размеры обновляются до перебалансировки, повороты поддерживают их локально
+    return y;
+  }
+
+  // Делает mid корнем поддерева с потомками left и right
+  template<typename Node>
+  static void link(Node* left, Node* mid, Node* right) {
+    mid->left = left;
+    mid->right = right;
+    if (left != nullptr) {
+      left->parent = mid;
+    }
+    if (right != nullptr) {
+      right->parent = mid;
+    }
+    mid->pull();
+  }
+
+  template<typename Node>
+  static Node* rotate_left(Node*& root, Node* x) {
+    Node* y = x->right;
+    x->right = y->left;
+    if (y->left != nullptr) {
+      y->left->parent = x;
+    }
+    transplant(root, x, y);
+    y->left = x;
+    x->parent = y;
+    x->pull();
+    y->pull();
+    return y;
+  }
+
+  template<typename Node>
+  static Node* rotate_right(Node*& root, Node* x) {
+    Node* y = x->left;
+    x->left = y->right;
+    if (y->right != nullptr) {
+      y->right->parent = x;
+    }
+    transplant(root, x, y);
+    y->right = x;
+    x->parent = y;
+    x->pull();
+    y->pull();
+    return y;
+  }
+};
+
+// Без балансировки: дерево повторяет порядок вставок
+struct NoBalance : BalanceBase {
+  struct node_base {};
+
+  template<typename Node>
+  static void insert_fixup(Node*&, Node*) {}
+
+  template<typename Node>
+  static void on_build(Node*, std::size_t, std::size_t) {}
+
+  template<typename Node>
+  static void unlink(Node*& root, Node* z) {
+    Node* x;
+    Node* x_parent;
+    splice_out(root, z, x, x_parent);
+  }
+
+  // Ранг поддерева для join; без балансировки он не нужен
+  template<typename Node>
+  static int rank(const Node*) {
+    return 0;
+  }
+
+  template<typename Node>
+  static int child_rank(const Node*, int, const Node*) {
+    return 0;
+  }
+
+  template<typename Node>
+  static int parent_rank(const Node*, const Node*, int) {
+    return 0;
+  }
+
+  // Объединяет left < mid < right в одно дерево
+  template<typename Node>
+  static Node* join(Node* left, int, Node* mid, Node* right, int, int& rank) {
+    link(left, mid, right);
+    mid->parent = nullptr;
+    rank = 0;
+    return mid;
+  }
+};
+
+// Красно-черное дерево: высота не больше 2*log2(n + 1)
+struct RedBlackBalance : BalanceBase {
+  struct node_base {
+    bool red = true; // Новый узел всегда красный
+  };
+
+  // Возвращает true, если черная высота дерева выросла: красный корень перекрашен в черный
+  template<typename Node>
+  static bool insert_fixup(Node*& root, Node* node) {
+    while (node != root && node->parent->red) {
+      Node* parent = node->parent;
+      Node* grandparent = parent->parent; // Существует, так как красный узел не может быть корнем
+      if (parent == grandparent->left) {
+        Node* uncle = grandparent->right;
+        if (uncle != nullptr && uncle->red) {
+          // Перекрашиваем и поднимаем нарушение на два уровня вверх
+          parent->red = false;
+          uncle->red = false;
+          grandparent->red = true;
+          node = grandparent;
+        } else {
+          if (node == parent->right) {
+            node = parent;
+            rotate_left(root, node);
+            parent = node->parent;
+          }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_right(root, grandparent);
+        }
+      } else {
+        Node* uncle = grandparent->left;
+        if (uncle != nullptr && uncle->red) {
+          parent->red = false;
+          uncle->red = false;
+          grandparent->red = true;
+          node = grandparent;
+        } else {
+          if (node == parent->left) {
+            node = parent;
+            rotate_right(root, node);
+            parent = node->parent;
+          }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_left(root, grandparent);
+        }
+      }
+    }
+    bool grew = root->red;
+    root->red = false;
+    return grew;
+  }
+
+  // Вызывается для узлов идеально сбалансированного дерева снизу вверх. Уровни с глубиной меньше
+  // complete_depth заполнены полностью и красятся в черный, неполный нижний уровень - в красный.
+  template<typename Node>
+  static void on_build(Node* node, std::size_t depth, std::size_t complete_depth) {
+    node->red = depth >= complete_depth;
+  }
+
+  template<typename Node>
+  static void unlink(Node*& root, Node* z) {
+    Node* x;
+    Node* x_parent;
+    Node* y = splice_out(root, z, x, x_parent);
+    if (y != z) {
+      // Преемник занимает позицию z вместе с ее цветом, а в z остается цвет освободившейся позиции
+      std::swap(y->red, z->red);
+    }
+    if (!z->red) {
+      erase_fixup(root, x, x_parent);
+    }
+  }
+
+  // Ранг поддерева - черная высота после перекрашивания его корня в черный
+  // (черные узлы на пути до nullptr, включая корень)
+  template<typename Node>
+  static int rank(const Node* root) {
+    int result = is_red(root) ? 1 : 0;
+    for (const Node* node = root; node != nullptr; node = node->left) {
+      result += node->red ? 0 : 1;
+    }
+    return result;
+  }
+
+  // Ранги соседних узлов выражаются друг через друга по их исходным цветам
+  template<typename Node>
+  static int child_rank(const Node*, int parent_rank, const Node* child) {
+    return parent_rank - 1 + (is_red(child) ? 1 : 0);
+  }
+
+  template<typename Node>
+  static int parent_rank(const Node*, const Node* child, int child_rank) {
+    return child_rank + 1 - (is_red(child) ? 1 : 0);
+  }
+
+  // Объединяет left < mid < right по их рангам. Если ранги равны, черный mid становится корнем;
+  // иначе mid красным подвешивается вдоль края более высокого дерева к поддереву того же ранга,
+  // и красно-красное нарушение исправляется как при вставке. O(|left_rank - right_rank| + 1).
+  template<typename Node>
+  static Node* join(Node* left, int left_rank, Node* mid, Node* right, int right_rank, int& rank) {
+    if (left != nullptr) {
+      left->red = false;
+    }
+    if (right != nullptr) {
+      right->red = false;
+    }
+    if (left_rank == right_rank) {
+      link(left, mid, right);
+      mid->parent = nullptr;
+      mid->red = false;
+      rank = left_rank + 1;
+      return mid;
+    }
+    bool into_left = left_rank > right_rank;
+    Node* root = into_left ? left : right;
+    int target = into_left ? right_rank : left_rank;
+    int current = into_left ? left_rank : right_rank;
+    Node* parent = nullptr;
+    Node* node = root;
+    while (node != nullptr && (node->red || current != target)) {
+      current -= node->red ? 0 : 1;
+      parent = node;
+      node = into_left ? node->right : node->left;
+    }
+    mid->red = true;
+    if (into_left) {
+      link(node, mid, right);
+      parent->right = mid;
+    } else {
+      link(left, mid, node);
+      parent->left = mid;
+    }
+    mid->parent = parent;
+    pull_up(parent);
+    rank = (into_left ? left_rank : right_rank) + (insert_fixup(root, mid) ? 1 : 0);
+    return root;
+  }
+
+ private:
+  template<typename Node>
+  static bool is_red(const Node* node) {
+    return node != nullptr && node->red;
+  }
+
+  // x несет "лишний" черный цвет; x может быть nullptr, поэтому родитель передается отдельно
+  template<typename Node>
+  static void erase_fixup(Node*& root, Node* x, Node* x_parent) {
+    while (x != root && !is_red(x)) {
+      if (x == x_parent->left) {
+        Node* sibling = x_parent->right;
+        if (sibling->red) {
+          sibling->red = false;
+          x_parent->red = true;
+          rotate_left(root, x_parent);
+          sibling = x_parent->right;
+        }
+        if (!is_red(sibling->left) && !is_red(sibling->right)) {
+          sibling->red = true;
+          x = x_parent;
+          x_parent = x_parent->parent;
+        } else {
+          if (!is_red(sibling->right)) {
+            sibling->left->red = false;
+            sibling->red = true;
+            rotate_right(root, sibling);
+            sibling = x_parent->right;
+          }
+          sibling->red = x_parent->red;
+          x_parent->red = false;
+          sibling->right->red = false;
+          rotate_left(root, x_parent);
+          x = root;
+        }
+      } else {
+        Node* sibling = x_parent->left;
+        if (sibling->red) {
+          sibling->red = false;
+          x_parent->red = true;
+          rotate_right(root, x_parent);
+          sibling = x_parent->left;
+        }
+        if (!is_red(sibling->left) && !is_red(sibling->right)) {
+          sibling->red = true;
+          x = x_parent;
+          x_parent = x_parent->parent;
+        } else {
+          if (!is_red(sibling->left)) {
+            sibling->right->red = false;
+            sibling->red = true;
+            rotate_left(root, sibling);
+            sibling = x_parent->left;
+          }
+          sibling->red = x_parent->red;
+          x_parent->red = false;
+          sibling->left->red = false;
+          rotate_right(root, x_parent);
+          x = root;
+        }
+      }
+    }
+    if (x != nullptr) {
+      x->red = false;
+    }
+  }
+};
+
+// АВЛ-дерево: высоты поддеревьев отличаются не больше чем на 1, высота не больше 1.44*log2(n + 2)
+struct AvlBalance : BalanceBase {
+  struct node_base {
+    int height = 1; // Высота поддерева, лист имеет высоту 1
+  };
+
+  template<typename Node>
+  static void insert_fixup(Node*& root, Node* node) {
+    retrace(root, node->parent);
+  }
+
+  template<typename Node>
+  static void on_build(Node* node, std::size_t, std::size_t) {
+    update_height(node);
+  }
+
+  template<typename Node>
+  static void unlink(Node*& root, Node* z) {
+    Node* x;
+    Node* x_parent;
+    Node* y = splice_out(root, z, x, x_parent);
+    if (y != z) {
+      std::swap(y->height, z->height);
+    }
+    retrace(root, x_parent);
+  }
+
+  // Ранг поддерева - его высота, она хранится в узлах
+  template<typename Node>
+  static int rank(const Node* root) {
+    return height(root);
+  }
+
+  template<typename Node>
+  static int child_rank(const Node*, int, const Node* child) {
+    return height(child);
+  }
+
+  template<typename Node>
+  static int parent_rank(const Node* parent, const Node*, int) {
+    return parent->height;
+  }
+
+  // Объединяет left < mid < right. Если высоты различаются больше чем на 1, mid подвешивается
+  // вдоль края более высокого дерева к поддереву высоты не больше меньшей + 1 и баланс
+  // восстанавливается вверх как при вставке. O(|разность высот| + 1).
+  template<typename Node>
+  static Node* join(Node* left, int, Node* mid, Node* right, int, int& rank) {
+    int left_height = height(left);
+    int right_height = height(right);
+    if (left_height - right_height <= 1 && right_height - left_height <= 1) {
+      link(left, mid, right);
+      mid->parent = nullptr;
+      update_height(mid);
+      rank = mid->height;
+      return mid;
+    }
+    bool into_left = left_height > right_height;
+    Node* root = into_left ? left : right;
+    int target = (into_left ? right_height : left_height) + 1;
+    Node* parent = nullptr;
+    Node* node = root;
+    while (height(node) > target) {
+      parent = node;
+      node = into_left ? node->right : node->left;
+    }
+    if (into_left) {
+      link(node, mid, right);
+      parent->right = mid;
+    } else {
+      link(left, mid, node);
+      parent->left = mid;
+    }
+    mid->parent = parent;
+    update_height(mid);
+    pull_up(parent);
+    retrace(root, parent);
+    rank = root->height;
+    return root;
+  }
+
+ private:
+  template<typename Node>
+  static int height(const Node* node) {
+    return node != nullptr ? node->height : 0;
+  }
+
+  template<typename Node>
+  static void update_height(Node* node) {
+    node->height = 1 + std::max(height(node->left), height(node->right));
+  }
+
+  template<typename Node>
+  static Node* rotate_left_avl(Node*& root, Node* x) {
+    Node* y = rotate_left(root, x);
+    update_height(x);
+    update_height(y);
+    return y;
+  }
+
+  template<typename Node>
+  static Node* rotate_right_avl(Node*& root, Node* x) {
+    Node* y = rotate_right(root, x);
+    update_height(x);
+    update_height(y);
+    return y;
+  }
+
+  // Восстанавливает баланс узла, возвращает новый корень его поддерева
+  template<typename Node>
+  static Node* rebalance(Node*& root, Node* node) {
+    int balance = height(node->left) - height(node->right);
+    if (balance > 1) {
+      if (height(node->left->left) < height(node->left->right)) {
+        rotate_left_avl(root, node->left);
+      }
+      return rotate_right_avl(root, node);
+    }
+    if (balance < -1) {
+      if (height(node->right->right) < height(node->right->left)) {
+        rotate_right_avl(root, node->right);
+      }
+      return rotate_left_avl(root, node);
+    }
+    update_height(node);
+    return node;
+  }
+
+  // Поднимается к корню, пока высота поддеревьев меняется
+  template<typename Node>
+  static void retrace(Node*& root, Node* node) {
+    while (node != nullptr) {
+      int old_height = node->height;
+      node = rebalance(root, node);
+      if (node->height == old_height) {
+        break;
+      }
+      node = node->parent;
+    }
+  }
+};
+
+// Аугментация узлов моноидом: каждый узел хранит сводку своего поддерева, что позволяет
+// отвечать на aggregate(lo, hi) за O(log n). Политика аугментации задает
+//   summary_type - тип сводки (конструируемый по умолчанию),
+//   identity() - нейтральный элемент,
+//   summarize(value) - сводку одного значения,
+//   combine(lhs, rhs) - ассоциативное объединение сводок соседних диапазонов (lhs левее rhs).
+// Функции вызываются при каждом пересчете узла и не должны бросать исключений.
+struct NoAugment {};
+
+template<typename T>
+struct SumAugment {
+  using summary_type = T;
+
+  static summary_type identity() {
+    return summary_type();
+  }
+
+  static summary_type summarize(const T& value) {
+    return value;
+  }
+
+  static summary_type combine(const summary_type& lhs, const summary_type& rhs) {
+    return lhs + rhs;
+  }
+};
+
+template<typename T>
+struct MinAugment {
+  using summary_type = T;
+
+  static summary_type identity() {
+    return std::numeric_limits<T>::max();
+  }
+
+  static summary_type summarize(const T& value) {
+    return value;
+  }
+
+  static summary_type combine(const summary_type& lhs, const summary_type& rhs) {
+    return std::min(lhs, rhs);
+  }
+};
+
+template<typename T>
+struct MaxAugment {
+  using summary_type = T;
+
+  static summary_type identity() {
+    return std::numeric_limits<T>::lowest();
+  }
+
+  static summary_type summarize(const T& value) {
+    return value;
+  }
+
+  static summary_type combine(const summary_type& lhs, const summary_type& rhs) {
+    return std::max(lhs, rhs);
+  }
+};
+
+// Поле сводки в узле; без аугментации узел не растет
+template<typename Augment>
+struct AugmentNodeBase {
+  typename Augment::summary_type summary;
+};
+
+template<>
+struct AugmentNodeBase<NoAugment> {};
+
+// Прошивка: Threaded добавляет в каждый узел ссылки на соседей в порядке ключей, и ++/-- в
+// InOrder выполняются за O(1) в худшем случае одним переходом по ссылке. Ссылки поддерживаются
+// всеми изменяющими операциями; цена - два указателя на узел. Прошивка есть только для InOrder:
+// итераторы PreOrder и PostOrder от нее не зависят и, как и без нее, ходят по ссылкам на
+// родителя - O(1) амортизированно за полный обход и O(h) на отдельный шаг.
+struct Unthreaded {};
+struct Threaded {};
+
+template<typename Threading, typename Node>
+struct ThreadNodeBase {};
+
+template<typename Node>
+struct ThreadNodeBase<Threaded, Node> {
+  Node* prev = nullptr; // Предыдущий по порядку ключей
+  Node* next = nullptr; // Следующий по порядку ключей
+};
+
+// Константные методы можно вызывать из нескольких потоков одновременно, с одним исключением:
+// после вставок с подсказкой размеры поддеревьев отложены, и первый вызов rank, select,
+// aggregate или countNodes досчитывает их, записывая в узлы. Если дерево читают из нескольких
+// потоков, после таких вставок нужно вызвать settleSizes; любое изменение без подсказки
+// делает это само. size и empty читают отдельный счетчик и исключением не являются.
+template<typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>,
+    typename Balance = NoBalance, typename Augment = NoAugment, typename Threading = Unthreaded>
 class BinarySearchTree {
  public:
   // Определение типов для удобства
@@ -18,20 +634,64 @@ class BinarySearchTree {
   using const_reference = const value_type&;
   using pointer = typename std::allocator_traits<allocator_type>::pointer;
   using const_pointer = typename std::allocator_traits<allocator_type>::const_pointer;
+  using key_type = T;
+  using key_compare = Compare;
+  using value_compare = Compare;
 
  private:
-  // Определение узла дерева
-  struct Node {
+  static constexpr bool kAugmented = !std::is_same_v<Augment, NoAugment>;
+  static constexpr bool kThreaded = std::is_same_v<Threading, Threaded>;
+
+  // Определение узла дерева, служебные поля балансировки берутся из политики, сводка - из аугментации
+  struct Node : Balance::node_base, AugmentNodeBase<Augment>, ThreadNodeBase<Threading, Node> {
     value_type value;
     Node* left;
     Node* right;
     Node* parent;
-    Node(const value_type& val, Node* parent = nullptr)
-        : value(val), parent(parent), left(nullptr), right(nullptr) {}
+    size_type size; // Количество узлов в поддереве, включая этот; 0 - еще не пересчитано, см. settleSizes
+
+    // Значение конструируется на месте из произвольных аргументов
+    template<typename... Args>
+    explicit Node(std::in_place_t, Args&&... args)
+        : value(std::forward<Args>(args)...), left(nullptr), right(nullptr), parent(nullptr), size(1) {
+      if constexpr (kAugmented) {
+        this->summary = Augment::summarize(value);
+      }
+    }
+
+    static size_type size_of(const Node* node) noexcept {
+      return node != nullptr ? node->size : 0;
+    }
+
+    static bool stale(const Node* node) noexcept {
+      return node != nullptr && node->size == 0;
+    }
+
+    // Под устаревшим потомком сам узел тоже считается устаревшим
+    void pull() noexcept {
+      if (stale(left) || stale(right)) {
+        size = 0;
+        return;
+      }
+      size = 1 + size_of(left) + size_of(right);
+      if constexpr (kAugmented) {
+        this->summary = Augment::combine(Augment::combine(summary_of(left), Augment::summarize(value)),
+                                         summary_of(right));
+      }
+    }
+
+    template<typename A = Augment>
+    static typename A::summary_type summary_of(const Node* node) {
+      return node != nullptr ? node->summary : Augment::identity();
+    }
   };
   using NodeAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+  using NodeTraits = std::allocator_traits<NodeAllocator>;
   NodeAllocator node_allocator_;
+  Compare comp_; // Все сравнения ключей идут только через него
   Node* root; // Указатель на корень дерева
+  Node* rightmost_ = nullptr; // Максимум для вставок с подсказкой end(); nullptr - неизвестен
+  size_type count_ = 0; // Число элементов; в отличие от размеров поддеревьев всегда актуально
 
  public:
 
@@ -85,6 +745,10 @@ class BinarySearchTree {
       if (node == nullptr) {
         return;
       }
+      if constexpr (kThreaded) {
+        node = node->next;
+        return;
+      }
       if (node->right != nullptr) {
         node = node->right;
         while (node->left != nullptr) {
@@ -98,6 +762,7 @@ class BinarySearchTree {
       }
     }
 
+    // Обходы PreOrder и PostOrder не прошиты, см. Threaded
     void increment(PreOrder) {
       if (node == nullptr) {
         return;
@@ -156,6 +821,8 @@ class BinarySearchTree {
         while (node->right != nullptr) {
           node = node->right;
         }
+      } else if constexpr (kThreaded) {
+        node = node->prev;
       } else if (node->left != nullptr) {
         node = node->left;
         while (node->right != nullptr) {
@@ -225,36 +892,215 @@ class BinarySearchTree {
     }
   };
 
+  // Узел, извлеченный из дерева вместе со значением (аналог std::set::node_type).
+  // Владеет узлом, пока тот не будет вставлен обратно в это или другое дерево с равным аллокатором.
+  class node_type {
+   public:
+    using value_type = T;
+    using allocator_type = Alloc;
+
+    node_type() noexcept = default;
+
+    node_type(node_type&& other) noexcept : node_(other.node_), alloc_(std::move(other.alloc_)) {
+      other.node_ = nullptr;
+      other.alloc_.reset();
+    }
+
+    node_type& operator=(node_type&& other) noexcept {
+      if (this != &other) {
+        reset();
+        node_ = other.node_;
+        alloc_ = std::move(other.alloc_);
+        other.node_ = nullptr;
+        other.alloc_.reset();
+      }
+      return *this;
+    }
+
+    ~node_type() {
+      reset();
+    }
+
+    bool empty() const noexcept {
+      return node_ == nullptr;
+    }
+
+    explicit operator bool() const noexcept {
+      return node_ != nullptr;
+    }
+
+    // Значение можно менять, пока узел не находится в дереве
+    value_type& value() const {
+      return node_->value;
+    }
+
+    allocator_type get_allocator() const {
+      return allocator_type(*alloc_);
+    }
+
+    void swap(node_type& other) noexcept {
+      using std::swap;
+      swap(node_, other.node_);
+      swap(alloc_, other.alloc_);
+    }
+
+   private:
+    friend class BinarySearchTree;
+
+    node_type(Node* node, const NodeAllocator& alloc) : node_(node), alloc_(alloc) {}
+
+    Node* release() noexcept {
+      Node* node = node_;
+      node_ = nullptr;
+      alloc_.reset();
+      return node;
+    }
+
+    void reset() noexcept {
+      if (node_ != nullptr) {
+        NodeTraits::destroy(*alloc_, node_);
+        NodeTraits::deallocate(*alloc_, node_, 1);
+        node_ = nullptr;
+      }
+      alloc_.reset();
+    }
+
+    Node* node_ = nullptr;
+    std::optional<NodeAllocator> alloc_;
+  };
+
+  // Результат вставки узла: позиция элемента, флаг вставки и узел, если вставка не удалась
+  struct insert_return_type {
+    const_iterator<InOrder> position;
+    bool inserted;
+    node_type node;
+  };
+
   // Конструкторы и деструктор + методы для них
+  // Удаляет поддерево без рекурсии: спускается до листа, удаляет его и возвращается
+  // к родителю по parent. Дополнительная память - O(1) при любой глубине дерева.
   void clear(Node* node) noexcept {
-    if (node) {
-      clear(node->left);
-      clear(node->right);
-      node_allocator_.destroy(node);
-      node_allocator_.deallocate(node, 1);
+    if (node == nullptr) {
+      return;
+    }
+    Node* stop = node->parent;
+    while (node != stop) {
+      if (node->left != nullptr) {
+        node = node->left;
+      } else if (node->right != nullptr) {
+        node = node->right;
+      } else {
+        Node* parent = node->parent;
+        if (parent != stop) {
+          if (parent->left == node) {
+            parent->left = nullptr;
+          } else {
+            parent->right = nullptr;
+          }
+        }
+        deallocateNode(node);
+        node = parent;
+      }
     }
   }
 
   void clear() noexcept {
-    clear(root);
+    // Если деструкторы узлов ничего не делают, а аллокатор умеет освобождать память целиком
+    // (например, PoolAllocator), обход дерева не нужен
+    if (!(std::is_trivially_destructible_v<Node> && releaseAll(node_allocator_, 0))) {
+      clear(root);
+    }
     root = nullptr;
+    rightmost_ = nullptr;
+    count_ = 0;
+  }
+
+  Node* cloneNode(const Node* node, Node* parent) {
+    Node* new_node = allocateNode(node->value);
+    new_node->parent = parent;
+    static_cast<typename Balance::node_base&>(*new_node) = *node; // Копируем служебные поля балансировки
+    static_cast<AugmentNodeBase<Augment>&>(*new_node) = *node;
+    new_node->size = node->size;
+    return new_node;
   }
 
-  Node* copy(Node* node, Node* parent = nullptr) {
+  // Копирует поддерево с сохранением формы без рекурсии: обход в прямом порядке идет
+  // одновременно по исходному дереву и по копии, возврат вверх - по parent.
+  Node* copy(Node* node, size_type count) {
     if (!node) {
       return nullptr;
     }
-    Node* new_node = node_allocator_.allocate(1);
-    node_allocator_.construct(new_node, node->value, parent);
-    new_node->left = copy(node->left, new_node);
-    new_node->right = copy(node->right, new_node);
-    return new_node;
+    reserveNodes(node_allocator_, count, 0); // Узлы копии берутся одним блоком, если аллокатор умеет
+    Node* result = cloneNode(node, nullptr);
+    Node* from = node;
+    Node* to = result;
+    try {
+      while (true) {
+        if (from->left != nullptr && to->left == nullptr) {
+          to->left = cloneNode(from->left, to);
+          from = from->left;
+          to = to->left;
+        } else if (from->right != nullptr && to->right == nullptr) {
+          to->right = cloneNode(from->right, to);
+          from = from->right;
+          to = to->right;
+        } else if (from != node) {
+          from = from->parent;
+          to = to->parent;
+        } else {
+          break;
+        }
+      }
+    } catch (...) {
+      clear(result);
+      throw;
+    }
+    threadInOrder(result);
+
+    return result;
   }
 
   BinarySearchTree() noexcept: node_allocator_(allocator_type()), root(nullptr) {}
 
-  BinarySearchTree(const BinarySearchTree& other) {
-    root = copy(other.root);
+  explicit BinarySearchTree(const allocator_type& alloc) : node_allocator_(alloc), root(nullptr) {}
+
+  explicit BinarySearchTree(const Compare& comp, const allocator_type& alloc = allocator_type())
+      : node_allocator_(alloc), comp_(comp), root(nullptr) {}
+
+  // Построение за O(n) из отсортированного диапазона без повторов
+  template<typename InputIt>
+  BinarySearchTree(SortedUnique, InputIt first, InputIt last, const Compare& comp = Compare(),
+                   const allocator_type& alloc = allocator_type())
+      : node_allocator_(alloc), comp_(comp), root(nullptr) {
+    assign_sorted(first, last);
+  }
+
+  template<typename InputIt>
+  BinarySearchTree(SortedUnique, InputIt first, InputIt last, const allocator_type& alloc)
+      : BinarySearchTree(SortedUnique(), first, last, Compare(), alloc) {}
+
+  // Построение из неотсортированного диапазона на пуле потоков, см. assign_parallel
+  template<typename ForwardIt>
+  BinarySearchTree(ThreadPool& pool, ForwardIt first, ForwardIt last, const Compare& comp = Compare(),
+                   const allocator_type& alloc = allocator_type())
+      : node_allocator_(alloc), comp_(comp), root(nullptr) {
+    assign_parallel(pool, first, last);
+  }
+
+  // Копия получает размеры поддеревьев как есть, вместе с отметками о неактуальности,
+  // поэтому копирование ничего не пишет в other
+  BinarySearchTree(const BinarySearchTree& other) : comp_(other.comp_) {
+    root = copy(other.root, other.count_);
+    count_ = other.count_;
+  }
+
+  // Перемещение забирает узлы целиком, исходное дерево остается пустым
+  BinarySearchTree(BinarySearchTree&& other) noexcept
+      : node_allocator_(std::move(other.node_allocator_)), comp_(other.comp_), root(other.root),
+        rightmost_(other.rightmost_), count_(other.count_) {
+    other.root = nullptr;
+    other.rightmost_ = nullptr;
+    other.count_ = 0;
   }
 
   ~BinarySearchTree() {
@@ -265,21 +1111,82 @@ class BinarySearchTree {
   void swap(BinarySearchTree& other) noexcept {
     using std::swap;
     swap(root, other.root);
+    swap(rightmost_, other.rightmost_);
+    swap(count_, other.count_);
     swap(node_allocator_, other.node_allocator_);
+    swap(comp_, other.comp_);
   }
 
   BinarySearchTree& operator=(const BinarySearchTree& other) {
-    swap(other);
+    if (this != &other) {
+      BinarySearchTree copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  BinarySearchTree& operator=(BinarySearchTree&& other) noexcept(
+      NodeTraits::propagate_on_container_move_assignment::value || NodeTraits::is_always_equal::value) {
+    if (this == &other) {
+      return *this;
+    }
+    clear();
+    comp_ = other.comp_;
+    if constexpr (NodeTraits::propagate_on_container_move_assignment::value) {
+      node_allocator_ = std::move(other.node_allocator_);
+    } else if (node_allocator_ != other.node_allocator_) {
+      // Узлы чужого аллокатора забрать нельзя, поэтому значения перемещаются поштучно
+      Node* list = flatten(other.root);
+      other.root = nullptr;
+      other.rightmost_ = nullptr;
+      other.count_ = 0;
+      try {
+        for (Node* node = list; node != nullptr; node = node->right) {
+          emplace(std::move(node->value));
+        }
+      } catch (...) {
+        other.freeNodeList(list);
+        throw;
+      }
+      other.freeNodeList(list);
+      return *this;
+    }
+    root = other.root;
+    rightmost_ = other.rightmost_;
+    count_ = other.count_;
+    other.root = nullptr;
+    other.rightmost_ = nullptr;
+    other.count_ = 0;
     return *this;
   }
 
   // Методы для работы с узлами
-  Node* allocateNode(const value_type& value) {
-    Node* node = node_allocator_.allocate(1);
+  // Освобождение всей памяти аллокатора разом, если он это поддерживает
+  template<typename A>
+  static auto releaseAll(A& alloc, int) noexcept -> decltype(alloc.release()) {
+    return alloc.release();
+  }
+
+  template<typename A>
+  static bool releaseAll(A&, long) noexcept {
+    return false;
+  }
+
+  template<typename A>
+  static auto reserveNodes(A& alloc, size_type count, int) -> decltype(alloc.reserve(count)) {
+    return alloc.reserve(count);
+  }
+
+  template<typename A>
+  static void reserveNodes(A&, size_type, long) {}
+
+  template<typename... Args>
+  Node* allocateNode(Args&&... args) {
+    Node* node = NodeTraits::allocate(node_allocator_, 1);
     try {
-      node_allocator_.construct(node, value);
+      NodeTraits::construct(node_allocator_, node, std::in_place, std::forward<Args>(args)...);
     } catch (...) {
-      node_allocator_.deallocate(node, 1);
+      NodeTraits::deallocate(node_allocator_, node, 1);
       throw;
     }
 
@@ -288,65 +1195,622 @@ class BinarySearchTree {
 
   void deallocateNode(Node* node) {
     if (node != nullptr) {
-      node_allocator_.destroy(node); // Используем NodeAllocator для уничтожения узла
-      node_allocator_.deallocate(node, 1); // Используем NodeAllocator для освобождения памяти
+      NodeTraits::destroy(node_allocator_, node); // Используем NodeAllocator для уничтожения узла
+      NodeTraits::deallocate(node_allocator_, node, 1); // Используем NodeAllocator для освобождения памяти
     }
   }
 
-  // Методы для работы с элементами
-  void insert(const value_type& value) {
-    Node* newNode = allocateNode(value); // Вызов функции для создания нового узла
-    if (root == nullptr) {
-      root = newNode; // Если дерево пустое, новый узел становится корнем
-    } else {
-      Node* current = root;
-      Node* parent = nullptr;
-      while (current != nullptr) {
-        parent = current; // Сохраняем текущий узел как родителя для будущей вставки
-        if (value < current->value) {
-          current = current->left; // Переходим к левому поддереву
+  // Создает узлы для значений диапазона и связывает их в список через right
+  template<typename InputIt>
+  Node* makeNodeList(InputIt first, InputIt last, size_type& count) {
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+      reserveNodes(node_allocator_, static_cast<size_type>(std::distance(first, last)), 0);
+    }
+    Node* head = nullptr;
+    Node* tail = nullptr;
+    count = 0;
+    try {
+      for (; first != last; ++first) {
+        Node* node = allocateNode(*first);
+        if (tail != nullptr) {
+          tail->right = node;
+        } else {
+          head = node;
+        }
+        tail = node;
+        ++count;
+      }
+    } catch (...) {
+      freeNodeList(head);
+      throw;
+    }
+
+    return head;
+  }
+
+  void freeNodeList(Node* head) noexcept {
+    while (head != nullptr) {
+      Node* next = head->right;
+      deallocateNode(head);
+      head = next;
+    }
+  }
+
+  // Строит идеально сбалансированное поддерево из count первых узлов списка head (связь через right),
+  // сдвигая head за использованные узлы. Глубина рекурсии - O(log n).
+  Node* buildFromList(Node*& head, size_type count, size_type depth, size_type complete_depth) noexcept {
+    if (count == 0) {
+      return nullptr;
+    }
+    size_type left_count = count / 2;
+    Node* left = buildFromList(head, left_count, depth + 1, complete_depth);
+    Node* node = head;
+    head = head->right;
+    node->left = left;
+    node->right = buildFromList(head, count - left_count - 1, depth + 1, complete_depth);
+    node->parent = nullptr;
+    if (node->left != nullptr) {
+      node->left->parent = node;
+    }
+    if (node->right != nullptr) {
+      node->right->parent = node;
+    }
+    node->pull();
+    Balance::on_build(node, depth, complete_depth);
+
+    return node;
+  }
+
+  // Количество полностью заполненных уровней идеально сбалансированного дерева: floor(log2(count + 1))
+  static size_type completeDepth(size_type count) noexcept {
+    size_type complete_depth = 0;
+    while ((size_type(2) << complete_depth) - 1 <= count) {
+      ++complete_depth;
+    }
+
+    return complete_depth;
+  }
+
+  Node* buildFromList(Node* head, size_type count) noexcept {
+    if constexpr (kThreaded) {
+      // Список уже упорядочен, прошивка повторяет его
+      Node* prev = nullptr;
+      for (Node* node = head; node != nullptr; node = node->right) {
+        node->prev = prev;
+        node->next = node->right;
+        prev = node;
+      }
+    }
+
+    return buildFromList(head, count, 0, completeDepth(count));
+  }
+
+  // Прошивает поддерево по порядку ключей: обход по ссылкам на родителей без рекурсии
+  static void threadInOrder(Node* subtree) noexcept {
+    if constexpr (kThreaded) {
+      if (subtree == nullptr) {
+        return;
+      }
+      Node* prev = nullptr;
+      Node* node = leftmost(subtree);
+      while (node != nullptr) {
+        node->prev = prev;
+        if (prev != nullptr) {
+          prev->next = node;
+        }
+        prev = node;
+        if (node->right != nullptr) {
+          node = leftmost(node->right);
         } else {
-          current = current->right; // Переходим к правому поддереву
+          while (node != subtree && node == node->parent->right) {
+            node = node->parent;
+          }
+          node = node != subtree ? node->parent : nullptr;
         }
       }
-      // Определяем, к какому потомку родительского узла присоединить новый узел
-      if (value < parent->value) {
-        parent->left = newNode;
+      prev->next = nullptr;
+    }
+  }
+
+  // Исключает узел из прошивки, кэша максимума и счетчика перед удалением из дерева.
+  // Отложенные вставками с подсказкой размеры досчитываются здесь, а не при чтении.
+  void forgetNode(Node* node) noexcept {
+    settleSizes();
+    --count_;
+    if (node == rightmost_) {
+      rightmost_ = nullptr;
+    }
+    unthread(node);
+  }
+
+  // Исключает узел из прошивки перед удалением из дерева
+  static void unthread(Node* node) noexcept {
+    if constexpr (kThreaded) {
+      if (node->prev != nullptr) {
+        node->prev->next = node->next;
+      }
+      if (node->next != nullptr) {
+        node->next->prev = node->prev;
+      }
+      node->prev = node->next = nullptr;
+    }
+  }
+
+  // Заменяет содержимое дерева элементами отсортированного диапазона без повторов за O(n).
+  // При исключении во время копирования значений дерево остается пустым.
+  template<typename InputIt>
+  void assign_sorted(InputIt first, InputIt last) {
+    clear();
+    size_type count;
+    Node* list = makeNodeList(first, last, count);
+    root = buildFromList(list, count);
+    count_ = count;
+  }
+
+  // Заменяет содержимое дерева элементами неотсортированного диапазона. Значения копируются
+  // в буфер, сортируются параллельно слиянием (устойчиво, поэтому из эквивалентных по comp
+  // остается первый, как при последовательных insert), затем узлы заполняются и связываются
+  // в дерево той же формы, что и у assign_sorted, параллельно по поддеревьям.
+  // Аллокатор вызывается только из текущего потока, он не обязан быть потокобезопасным.
+  // При исключении дерево остается пустым.
+  template<typename ForwardIt>
+  void assign_parallel(ThreadPool& pool, ForwardIt first, ForwardIt last) {
+    clear();
+    size_type count = static_cast<size_type>(std::distance(first, last));
+    if (count < 2) {
+      assign_sorted(first, last);
+      return;
+    }
+    size_type grain = parallelGrain(pool, count);
+    ValueAllocator value_allocator(node_allocator_);
+    value_type* values = ValueTraits::allocate(value_allocator, count);
+    size_type constructed = 0;
+    NodePointerAllocator pointer_allocator(node_allocator_);
+    Node** nodes = nullptr;
+    size_type unique = 0;
+    size_type allocated = 0;
+    bool built = false;
+    auto release_buffers = [&]() noexcept {
+      for (size_type i = 0; i < constructed; ++i) {
+        ValueTraits::destroy(value_allocator, values + i);
+      }
+      ValueTraits::deallocate(value_allocator, values, count);
+      if (nodes != nullptr) {
+        NodePointerTraits::deallocate(pointer_allocator, nodes, unique);
+      }
+    };
+    try {
+      for (; constructed < count; ++constructed, ++first) {
+        ValueTraits::construct(value_allocator, values + constructed, *first);
+      }
+      sortValues(pool, values, values + count, grain);
+      // Соседние отсортированные a <= b эквивалентны, если !(a < b)
+      unique = static_cast<size_type>(std::unique(values, values + count,
+          [this](const value_type& lhs, const value_type& rhs) { return !comp_(lhs, rhs); }) - values);
+
+      // Узлы выделяются подряд в порядке ключей: пул с reserve отдает их одним слябом,
+      // и соседние по порядку узлы оказываются соседними в памяти
+      reserveNodes(node_allocator_, unique, 0);
+      nodes = NodePointerTraits::allocate(pointer_allocator, unique);
+      for (; allocated < unique; ++allocated) {
+        nodes[allocated] = NodeTraits::allocate(node_allocator_, 1);
+      }
+      constructNodes(pool, nodes, values, 0, unique, grain);
+      built = true;
+      root = linkNodes(pool, nodes, 0, unique, 0, completeDepth(unique), grain);
+      count_ = unique;
+      if constexpr (kThreaded) {
+        for (size_type i = 0; i < unique; ++i) {
+          nodes[i]->prev = i > 0 ? nodes[i - 1] : nullptr;
+          nodes[i]->next = i + 1 < unique ? nodes[i + 1] : nullptr;
+        }
+      }
+    } catch (...) {
+      for (size_type i = 0; i < allocated; ++i) {
+        if (built) {
+          NodeTraits::destroy(node_allocator_, nodes[i]);
+        }
+        NodeTraits::deallocate(node_allocator_, nodes[i], 1);
+      }
+      root = nullptr;
+      count_ = 0;
+      release_buffers();
+      throw;
+    }
+    release_buffers();
+  }
+
+  // Записывает дерево в поток в формате BinaryFormat: заголовок, затем значения по возрастанию.
+  // Тривиально копируемые значения копируются блоками байтов, остальные пишет BinarySerializer<T>.
+  void save(std::ostream& out) const {
+    BinaryFormat::writeHeader(out, kFormatMagic, BinaryFormat::headerFor<value_type>(size()));
+    if constexpr (BinarySerializer<value_type>::kRaw) {
+      std::unique_ptr<unsigned char[]> buffer = ioBuffer(size());
+      size_type filled = 0;
+      for (auto it = begin<InOrder>(); it != end<InOrder>(); ++it) {
+        std::memcpy(buffer.get() + filled * sizeof(value_type), std::addressof(*it), sizeof(value_type));
+        if (++filled == kIoChunk) {
+          BinaryFormat::writeBytes(out, buffer.get(), filled * sizeof(value_type));
+          filled = 0;
+        }
+      }
+      BinaryFormat::writeBytes(out, buffer.get(), filled * sizeof(value_type));
+    } else {
+      for (auto it = begin<InOrder>(); it != end<InOrder>(); ++it) {
+        BinarySerializer<value_type>::write(out, *it);
+      }
+    }
+  }
+
+  // Заменяет содержимое дерева данными, записанными save, за O(n) без поиска места для каждого
+  // значения: узлы создаются подряд и связываются в дерево той же формы, что и у assign_sorted.
+  // Порядок значений проверяется по comp. При повреждении данных бросается FormatError;
+  // при любом исключении дерево не меняется.
+  void load(std::istream& in) {
+    BinaryFormat::Header header = BinaryFormat::readHeader(in, kFormatMagic);
+    if (!BinaryFormat::matches<value_type>(header)) {
+      throw FormatError("BinarySearchTree: stored values have a different type");
+    }
+    if (header.count > max_size()) {
+      throw FormatError("BinarySearchTree: stored element count is too large");
+    }
+    size_type count = static_cast<size_type>(header.count);
+    Node* head = nullptr;
+    Node* tail = nullptr;
+    auto append = [&](Node* node) {
+      if (tail != nullptr) {
+        tail->right = node;
       } else {
-        parent->right = newNode;
+        head = node;
       }
-      newNode->parent = parent; // Устанавливаем связь родителя с новым узлом
+      bool ordered = tail == nullptr || comp_(tail->value, node->value);
+      tail = node;
+      if (!ordered) {
+        throw FormatError("BinarySearchTree: stored values are not sorted");
+      }
+    };
+    try {
+      reserveNodes(node_allocator_, count, 0);
+      if constexpr (BinarySerializer<value_type>::kRaw) {
+        std::unique_ptr<unsigned char[]> buffer = ioBuffer(count);
+        // Байты копируются в значение, а не читаются через указатель на буфер: в буфере нет объектов
+        union Raw {
+          value_type value;
+          Raw() noexcept {}
+        } raw;
+        for (size_type done = 0; done < count;) {
+          size_type part = std::min(kIoChunk, count - done);
+          BinaryFormat::readBytes(in, buffer.get(), part * sizeof(value_type));
+          for (size_type i = 0; i < part; ++i) {
+            std::memcpy(std::addressof(raw.value), buffer.get() + i * sizeof(value_type), sizeof(value_type));
+            append(allocateNode(raw.value));
+          }
+          done += part;
+        }
+      } else {
+        for (size_type i = 0; i < count; ++i) {
+          append(allocateNode(BinarySerializer<value_type>::read(in)));
+        }
+      }
+    } catch (...) {
+      freeNodeList(head);
+      throw;
     }
+    clear();
+    root = buildFromList(head, count);
+    count_ = count;
   }
 
-  const_iterator<InOrder> find(const value_type& value) {
-    Node* current = root; // Начинаем поиск с корня дерева
+  // Ищет место для значения. Возвращает узел с равным ключом или nullptr; во втором случае
+  // parent и to_left указывают, куда подвесить новый узел.
+  Node* findInsertPosition(const value_type& value, Node*& parent, bool& to_left) const {
+    Node* current = root;
+    parent = nullptr;
+    to_left = false;
     while (current != nullptr) {
-      if (value == current->value) {
-        return const_iterator<InOrder>(current); // Найденный узел возвращается как итератор
-      } else if (value < current->value) {
-        current = current->left; // Переход к левому поддереву
+      parent = current; // Сохраняем текущий узел как родителя для будущей вставки
+      if (comp_(value, current->value)) {
+        current = current->left; // Переходим к левому поддереву
+        to_left = true;
+      } else if (comp_(current->value, value)) {
+        current = current->right; // Переходим к правому поддереву
+        to_left = false;
       } else {
-        current = current->right; // Переход к правому поддереву
+        return current; // Элемент с таким ключом уже есть
       }
     }
 
-    return const_iterator<InOrder>(nullptr); // Возвращаем итератор на nullptr, если значение не найдено
+    return nullptr;
   }
 
-  bool exist(const value_type& value) {
-    Node* current = root; // Начинаем поиск с корня дерева
-    while (current != nullptr) {
-      if (value == current->value) {
-        return true; // Если значение найдено, возвращаем true
-      } else if (value < current->value) {
-        current = current->left; // Переход к левому поддереву, если значение меньше текущего
+  // Место для значения рядом с подсказкой: если значение должно стоять непосредственно перед hint,
+  // узел подвешивается к hint или к его предшественнику без спуска от корня и почти без сравнений.
+  // Максимум берется из rightmost_, поэтому вставка по возрастанию с подсказкой end() или
+  // с подсказкой на предыдущий вставленный элемент не ходит по правому краю дерева.
+  // При неверной подсказке выполняется обычный поиск, и adjacent становится false.
+  Node* findHintPosition(const_iterator<InOrder> hint, const value_type& value, Node*& parent, bool& to_left,
+                         bool& adjacent) {
+    Node* position = const_cast<Node*>(hint.get_node());
+    adjacent = true;
+    if (position == nullptr) {
+      // Подсказка end(): частый случай вставки по возрастанию
+      Node* max = maxNode();
+      if (max != nullptr && comp_(max->value, value)) {
+        parent = max;
+        to_left = false;
+        return nullptr;
+      }
+      adjacent = false;
+      return findInsertPosition(value, parent, to_left);
+    }
+    if (comp_(value, position->value)) {
+      --hint;
+      Node* before = const_cast<Node*>(hint.get_node());
+      if (before == nullptr || comp_(before->value, value)) {
+        // Значение между before и position: у одного из них свободна нужная ссылка
+        if (position->left == nullptr) {
+          parent = position;
+          to_left = true;
+        } else {
+          parent = before;
+          to_left = false;
+        }
+        return nullptr;
+      }
+    } else if (comp_(position->value, value)) {
+      Node* after = nullptr;
+      if (position != rightmost_) {
+        ++hint;
+        after = const_cast<Node*>(hint.get_node());
+        if (after == nullptr) {
+          rightmost_ = position; // Подсказка оказалась максимумом
+        }
+      }
+      if (after == nullptr || comp_(value, after->value)) {
+        if (position->right == nullptr) {
+          parent = position;
+          to_left = false;
+        } else {
+          parent = after;
+          to_left = true;
+        }
+        return nullptr;
+      }
+    } else {
+      return position; // Ключ совпадает с подсказкой
+    }
+    adjacent = false;
+
+    return findInsertPosition(value, parent, to_left);
+  }
+
+  // Подвешивает новый узел к parent и восстанавливает размеры и баланс. При deferred размеры
+  // и сводки предков не пересчитываются, а помечаются устаревшими (size == 0) до первого уже
+  // помеченного предка: выше него пометка уже стоит. Так вставки подряд в одно место, например
+  // по возрастанию, не проходят путь до корня, и с учетом амортизированно O(1) перебалансировки
+  // красно-черного и АВЛ-дерева при вставках стоят O(1) амортизированно.
+  // Пересчет выполняет settleSizes: следующее изменение без подсказки или первое чтение размеров.
+  void attachNode(Node* node, Node* parent, bool to_left, bool deferred = false) {
+    if (!deferred) {
+      settleSizes();
+    }
+    ++count_;
+    if constexpr (kThreaded) {
+      // Левый потомок встает перед родителем, правый - сразу после
+      Node* prev = nullptr;
+      Node* next = nullptr;
+      if (parent != nullptr) {
+        prev = to_left ? parent->prev : parent;
+        next = to_left ? parent : parent->next;
+      }
+      node->prev = prev;
+      node->next = next;
+      if (prev != nullptr) {
+        prev->next = node;
+      }
+      if (next != nullptr) {
+        next->prev = node;
+      }
+    }
+    node->parent = parent; // Устанавливаем связь родителя с новым узлом
+    if (parent == nullptr) {
+      root = node; // Если дерево пустое, новый узел становится корнем
+      rightmost_ = node;
+    } else if (to_left) {
+      parent->left = node;
+    } else {
+      parent->right = node;
+      if (parent == rightmost_) {
+        rightmost_ = node;
+      }
+    }
+    if (deferred) {
+      node->pull();
+      for (Node* n = parent; n != nullptr && n->size != 0; n = n->parent) {
+        n->size = 0;
+      }
+    } else if constexpr (kAugmented) {
+      // Пересчет начинается с самого узла: его значение могло измениться в node handle
+      for (Node* n = node; n != nullptr; n = n->parent) {
+        n->pull();
+      }
+    } else {
+      // Новый узел попал во все поддеревья на пути к корню; выше устаревшего узла размеры
+      // все равно будут пересчитаны
+      for (Node* n = parent; n != nullptr && n->size != 0; n = n->parent) {
+        ++n->size;
+      }
+    }
+    Balance::insert_fixup(root, node); // Восстанавливаем баланс согласно политике
+  }
+
+  // Приводит извлеченный узел к состоянию только что созданного
+  static void resetNode(Node* node) noexcept {
+    static_cast<typename Balance::node_base&>(*node) = typename Balance::node_base();
+    node->left = node->right = node->parent = nullptr;
+    node->size = 1;
+  }
+
+  template<typename V>
+  std::pair<const_iterator<InOrder>, bool> insertValue(V&& value) {
+    Node* parent;
+    bool to_left;
+    if (Node* existing = findInsertPosition(value, parent, to_left)) {
+      return {const_iterator<InOrder>(existing, root), false};
+    }
+    Node* node = allocateNode(std::forward<V>(value)); // Узел создается только если ключа еще нет
+    attachNode(node, parent, to_left);
+
+    return {const_iterator<InOrder>(node, root), true};
+  }
+
+  template<typename V>
+  const_iterator<InOrder> insertValue(const_iterator<InOrder> hint, V&& value) {
+    Node* parent;
+    bool to_left;
+    bool adjacent;
+    if (Node* existing = findHintPosition(hint, value, parent, to_left, adjacent)) {
+      return const_iterator<InOrder>(existing, root);
+    }
+    Node* node = allocateNode(std::forward<V>(value));
+    attachNode(node, parent, to_left, adjacent); // После полного спуска размеры дешевле обновить сразу
+
+    return const_iterator<InOrder>(node, root);
+  }
+
+  // Методы для работы с элементами. Ключи уникальны: при совпадении возвращается
+  // итератор на имеющийся элемент и false.
+  std::pair<const_iterator<InOrder>, bool> insert(const value_type& value) {
+    return insertValue(value);
+  }
+
+  std::pair<const_iterator<InOrder>, bool> insert(value_type&& value) {
+    return insertValue(std::move(value));
+  }
+
+  // Значение конструируется прямо в узле; если ключ уже есть, узел уничтожается
+  template<typename... Args>
+  std::pair<const_iterator<InOrder>, bool> emplace(Args&&... args) {
+    Node* node = allocateNode(std::forward<Args>(args)...);
+    Node* parent;
+    bool to_left;
+    if (Node* existing = findInsertPosition(node->value, parent, to_left)) {
+      deallocateNode(node);
+      return {const_iterator<InOrder>(existing, root), false};
+    }
+    attachNode(node, parent, to_left);
+
+    return {const_iterator<InOrder>(node, root), true};
+  }
+
+  // Вставка с подсказкой: hint - позиция, перед которой должен оказаться элемент.
+  // При верной подсказке обходится одним-двумя сравнениями и без спуска от корня, а размеры
+  // поддеревьев досчитываются позже (см. attachNode): при следующем изменении без подсказки,
+  // вызове settleSizes или первом чтении размеров в rank, select, aggregate и countNodes.
+  // size и empty размеров поддеревьев не читают.
+  const_iterator<InOrder> insert(const_iterator<InOrder> hint, const value_type& value) {
+    return insertValue(hint, value);
+  }
+
+  const_iterator<InOrder> insert(const_iterator<InOrder> hint, value_type&& value) {
+    return insertValue(hint, std::move(value));
+  }
+
+  template<typename... Args>
+  const_iterator<InOrder> emplace_hint(const_iterator<InOrder> hint, Args&&... args) {
+    Node* node = allocateNode(std::forward<Args>(args)...);
+    Node* parent;
+    bool to_left;
+    bool adjacent;
+    if (Node* existing = findHintPosition(hint, node->value, parent, to_left, adjacent)) {
+      deallocateNode(node);
+      return const_iterator<InOrder>(existing, root);
+    }
+    attachNode(node, parent, to_left, adjacent);
+
+    return const_iterator<InOrder>(node, root);
+  }
+
+  // Вставляет извлеченный узел без выделения памяти и копирования значения
+  insert_return_type insert(node_type&& handle) {
+    if (handle.empty()) {
+      return {end<InOrder>(), false, node_type()};
+    }
+    Node* parent;
+    bool to_left;
+    if (Node* existing = findInsertPosition(handle.value(), parent, to_left)) {
+      return {const_iterator<InOrder>(existing, root), false, std::move(handle)};
+    }
+    Node* node = handle.release();
+    resetNode(node);
+    attachNode(node, parent, to_left);
+
+    return {const_iterator<InOrder>(node, root), true, node_type()};
+  }
+
+  // Поиск с одним сравнением на уровень: спуск как в lower_bound и проверка равенства в конце.
+  // K - либо value_type, либо любой тип, сравнимый прозрачным компаратором.
+  template<typename K>
+  Node* lowerBoundNode(const K& key) const {
+    Node* node = root;
+    Node* result = nullptr; // Изначально устанавливаем результат на nullptr
+    while (node != nullptr) {
+      if (comp_(node->value, key)) {
+        node = node->right; // Значение узла меньше искомого, идем вправо
       } else {
-        current = current->right; // Переход к правому поддереву, если значение больше текущего
+        result = node; // Значение узла больше или равно, запоминаем узел и идем влево
+        node = node->left;
       }
     }
 
-    return false; // Если значение не найдено в дереве, возвращаем false
+    return result;
+  }
+
+  template<typename K>
+  Node* upperBoundNode(const K& key) const {
+    Node* node = root;
+    Node* result = nullptr;
+    while (node != nullptr) {
+      if (comp_(key, node->value)) {
+        result = node; // Значение узла строго больше, запоминаем узел и идем влево
+        node = node->left;
+      } else {
+        node = node->right; // Значение узла меньше или равно искомому, идем вправо
+      }
+    }
+
+    return result;
+  }
+
+  template<typename K>
+  Node* findNode(const K& key) const {
+    Node* node = lowerBoundNode(key);
+    if (node != nullptr && !comp_(key, node->value)) {
+      return node; // Ни один из ключей не меньше другого - они эквивалентны
+    }
+
+    return nullptr;
+  }
+
+  const_iterator<InOrder> find(const value_type& value) const {
+    return const_iterator<InOrder>(findNode(value), root);
+  }
+
+  // Перегрузки с произвольным типом ключа доступны только при Compare::is_transparent,
+  // как у std::set: поиск по std::string_view не создает временную строку
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> find(const K& key) const {
+    return const_iterator<InOrder>(findNode(key), root);
+  }
+
+  bool exist(const value_type& value) const {
+    return findNode(value) != nullptr;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  bool exist(const K& key) const {
+    return findNode(key) != nullptr;
   }
 
   const_iterator<InOrder> findMin() {
@@ -380,212 +1844,349 @@ class BinarySearchTree {
   // Дополнительные методы для работы с элементами
 
   size_type erase(const value_type& value) {
-    Node* current = root;
-    Node* parent = nullptr;
-    size_type erased = 0;
+    return eraseNode(findNode(value));
+  }
 
-    // Поиск узла с заданным значением
-    while (current != nullptr) {
-      if (value == current->value) {
-        break;
-      }
-      parent = current;
-      if (Compare()(value, current->value)) {
-        current = current->left;
-      } else {
-        current = current->right;
-      }
-    }
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  size_type erase(const K& key) {
+    return eraseNode(findNode(key));
+  }
 
-    if (current == nullptr) {
+  size_type eraseNode(Node* node) {
+    if (node == nullptr) {
 
       return 0; // Узел с таким значением не найден
     }
 
-    // Удаляемый узел имеет двух детей
-    if (current->left != nullptr && current->right != nullptr) {
-      // Находим преемника (наименьший узел в правом поддереве удаляемого узла)
-      Node* successor = current->right;
-      while (successor->left != nullptr) {
-        successor = successor->left;
-      }
-      // Копируем значение преемника в удаляемый узел
-      current->value = successor->value;
-      // Удаляем узел-преемник
-      current = successor;
-      // Продолжаем с одним из предыдущих случаев, т.к. у преемника не может быть двух детей
+    // Вырезаем узел целиком (значения не копируются), политика восстанавливает баланс
+    forgetNode(node);
+    Balance::unlink(root, node);
+    deallocateNode(node);
+
+    return 1;
+  }
+
+  // Вынимает узел из дерева без освобождения памяти и передает его во владение node_type
+  node_type extract(const_iterator<InOrder> position) {
+    if (position.get_node() == nullptr) {
+
+      return node_type();
     }
 
-    // Удаляемый узел имеет максимум одного ребенка
-    Node* replacement = (current->left != nullptr) ? current->left : current->right;
+    Node* nodeToRemove = const_cast<Node*>(position.get_node());
+    forgetNode(nodeToRemove);
+    Balance::unlink(root, nodeToRemove);
 
-    if (replacement != nullptr) {
-      // Удаляемый узел не является корнем
-      if (parent != nullptr) {
-        if (parent->left == current) {
-          parent->left = replacement;
-        } else {
-          parent->right = replacement;
+    return node_type(nodeToRemove, node_allocator_);
+  }
+
+  node_type extract(const value_type& value) {
+
+    return extract(find(value));
+  }
+
+  // Разворачивает поддерево в список по возрастанию, связанный через right, за O(n) без
+  // дополнительной памяти. Обход идет справа налево, поэтому правые ссылки меняются только
+  // у уже посещенных узлов, а подъем по parent сравнивает лишь нетронутые left.
+  static Node* flatten(Node* node) noexcept {
+    if (node == nullptr) {
+      return nullptr;
+    }
+    while (node->right != nullptr) {
+      node = node->right;
+    }
+    Node* head = nullptr;
+    while (node != nullptr) {
+      Node* next;
+      if (node->left != nullptr) {
+        next = node->left; // Предшественник - максимум левого поддерева
+        while (next->right != nullptr) {
+          next = next->right;
         }
       } else {
-        root = replacement; // Удаляемый узел является корнем
-      }
-      replacement->parent = parent;
-      deallocateNode(current);
-      erased = 1;
-    } else if (parent == nullptr) {
-      // Удаляемый узел - это корень, но у него нет детей
-      deallocateNode(current);
-      root = nullptr;
-      erased = 1;
-    } else {
-      // Удаляемый узел не является корнем и не имеет детей
-      if (parent->left == current) {
-        parent->left = nullptr;
-      } else {
-        parent->right = nullptr;
+        Node* child = node;
+        next = node->parent;
+        while (next != nullptr && child == next->left) {
+          child = next;
+          next = next->parent;
+        }
       }
-      deallocateNode(current);
-      erased = 1;
+      node->right = head;
+      head = node;
+      node = next;
     }
 
-    return erased;
+    return head;
   }
 
-  const_iterator<InOrder> extract(const_iterator<InOrder> position) {
-    if (position.get_node() == nullptr) {
-
-      return const_iterator<InOrder>(nullptr);
+  // Переносит в дерево элементы source, которых в нем еще нет; совпадающие остаются в source.
+  // Узлы перецепляются без выделения памяти и копирования значений: оба дерева разворачиваются
+  // в списки, сливаются и заново строятся сбалансированными за O(n + m).
+  void merge(BinarySearchTree& source) {
+    if (&source == this || source.root == nullptr) {
+      return;
     }
-
-    Node* nodeToRemove = const_cast<Node*>(position.get_node());
-    Node* successor = nullptr;
-
-    // Узел имеет двух потомков
-    if (nodeToRemove->left != nullptr && nodeToRemove->right != nullptr) {
-      successor = nodeToRemove->right;
-      while (successor->left != nullptr) { // Находим преемника
-        successor = successor->left;
+    if (node_allocator_ != source.node_allocator_) {
+      // Узлы чужого аллокатора нельзя забрать себе, поэтому значения копируются
+      mergeByCopy(source);
+      return;
+    }
+    size_type count = size() + source.size();
+    bool source_after = root == nullptr || comp_(*findMax(), *source.findMin());
+    bool source_before = !source_after && comp_(*source.findMax(), *findMin());
+    Node* own = flatten(root);
+    Node* other = flatten(source.root);
+    root = source.root = nullptr;
+    rightmost_ = source.rightmost_ = nullptr;
+    source.count_ = 0;
+    count_ = count;
+
+    if (source_after || source_before) {
+      // Диапазоны ключей не пересекаются: списки просто сцепляются без сравнений
+      Node* head = source_after ? own : other;
+      Node* tail = head;
+      while (tail != nullptr && tail->right != nullptr) {
+        tail = tail->right;
+      }
+      Node* rest = source_after ? other : own;
+      if (tail != nullptr) {
+        tail->right = rest;
+      } else {
+        head = rest;
       }
-      nodeToRemove->value = successor->value; // Копируем значение преемника в удаляемый узел
-      nodeToRemove = successor; // Теперь удаляем узел-преемник
+      root = buildFromList(head, count);
+      return;
     }
 
-    // Узел имеет не более одного потомка (случаи 1 и 2)
-    successor = (nodeToRemove->left != nullptr) ? nodeToRemove->left : nodeToRemove->right;
+    Node* merged = nullptr;
+    Node* rest = nullptr;
+    Node** merged_tail = &merged;
+    Node** rest_tail = &rest;
+    size_type rest_count = 0;
+    while (own != nullptr && other != nullptr) {
+      if (comp_(own->value, other->value)) {
+        *merged_tail = own;
+        merged_tail = &own->right;
+        own = own->right;
+      } else if (comp_(other->value, own->value)) {
+        *merged_tail = other;
+        merged_tail = &other->right;
+        other = other->right;
+      } else {
+        *merged_tail = own;
+        merged_tail = &own->right;
+        own = own->right;
+        *rest_tail = other; // Равный элемент остается в source
+        rest_tail = &other->right;
+        other = other->right;
+        ++rest_count;
+      }
+    }
+    *merged_tail = own != nullptr ? own : other;
+    *rest_tail = nullptr;
+    root = buildFromList(merged, count - rest_count);
+    source.root = source.buildFromList(rest, rest_count);
+    count_ = count - rest_count;
+    source.count_ = rest_count;
+  }
 
-    if (successor != nullptr) { // Узел имеет одного потомка
-      if (nodeToRemove->parent != nullptr) {
-        if (nodeToRemove == nodeToRemove->parent->left) {
-          nodeToRemove->parent->left = successor;
+  void mergeByCopy(BinarySearchTree& source) {
+    Node* list = flatten(source.root);
+    source.root = nullptr;
+    source.rightmost_ = nullptr;
+    source.count_ = 0;
+    Node* kept = nullptr;
+    Node** kept_tail = &kept;
+    size_type kept_count = 0;
+    try {
+      while (list != nullptr) {
+        Node* next = list->right;
+        if (contains(list->value)) {
+          *kept_tail = list;
+          kept_tail = &list->right;
+          ++kept_count;
         } else {
-          nodeToRemove->parent->right = successor;
+          insert(list->value);
+          source.deallocateNode(list);
         }
-      } else {
-        root = successor; // Удаляемый узел является корнем
+        list = next;
       }
-      successor->parent = nodeToRemove->parent;
-    } else if (nodeToRemove->parent == nullptr) { // Удаляемый узел является корнем и не имеет потомков
-      root = nullptr;
-    } else { // Удаляемый узел не имеет потомков
-      if (nodeToRemove == nodeToRemove->parent->left) {
-        nodeToRemove->parent->left = nullptr;
-      } else {
-        nodeToRemove->parent->right = nullptr;
+    } catch (...) {
+      // Еще не перенесенные элементы возвращаются в source
+      *kept_tail = list;
+      for (; list != nullptr; list = list->right) {
+        ++kept_count;
       }
+      source.root = source.buildFromList(kept, kept_count);
+      source.count_ = kept_count;
+      throw;
     }
+    *kept_tail = nullptr;
+    source.root = source.buildFromList(kept, kept_count);
+    source.count_ = kept_count;
+  }
 
-    // Освобождаем память удаляемого узла
-    deallocateNode(nodeToRemove);
+  // Разрезает дерево по ключу: в first уходят элементы меньше value, в second - остальные.
+  // Узлы переносятся без копирования значений, само дерево остается пустым.
+  // Для сбалансированных политик O(log n), результаты сбалансированы.
+  std::pair<BinarySearchTree, BinarySearchTree> split(const value_type& value) {
+    std::pair<BinarySearchTree, BinarySearchTree> result(BinarySearchTree(comp_, node_allocator_),
+                                                         BinarySearchTree(comp_, node_allocator_));
+    settleSizes(); // Размеры частей берутся из их корней
+    splitNodes(value, result.first.root, result.second.root);
+    result.first.count_ = Node::size_of(result.first.root);
+    result.second.count_ = count_ - result.first.count_;
+    root = nullptr;
+    rightmost_ = nullptr;
+    count_ = 0;
+    if constexpr (kThreaded) {
+      // Порядок внутри частей не меняется, разрывается только связь на границе
+      if (result.first.root != nullptr) {
+        rightmost(result.first.root)->next = nullptr;
+      }
+      if (result.second.root != nullptr) {
+        leftmost(result.second.root)->prev = nullptr;
+      }
+    }
 
-    return const_iterator<InOrder>(successor);
+    return result;
   }
 
-  void insertNodesFrom(Node* node) {
-    if (node != nullptr) {
-      // Вставляем значение текущего узла
-      insert(node->value);
-
-      // Рекурсивно вставляем левое поддерево
-      insertNodesFrom(node->left);
+  // Объединяет деревья с непересекающимися диапазонами ключей (в любом порядке) за O(log n)
+  // без копирования значений. Если диапазоны пересекаются или аллокаторы не равны,
+  // выполняется merge, и элементы right, уже имеющиеся в left, отбрасываются.
+  static BinarySearchTree join(BinarySearchTree left, BinarySearchTree right) {
+    if (right.root == nullptr) {
+      return left;
+    }
+    if (left.root == nullptr) {
+      return right;
+    }
+    if (left.comp_(rightmost(right.root)->value, leftmost(left.root)->value)) {
+      left.swap(right);
+    }
+    if (left.node_allocator_ != right.node_allocator_
+        || !left.comp_(rightmost(left.root)->value, leftmost(right.root)->value)) {
+      left.merge(right);
+      return left;
+    }
+    // Максимум left становится разделителем двух деревьев
+    Node* mid = rightmost(left.root);
+    if constexpr (kThreaded) {
+      Node* next = leftmost(right.root);
+      mid->next = next;
+      next->prev = mid;
+    }
+    Balance::unlink(left.root, mid);
+    int rank;
+    left.root = Balance::join(left.root, Balance::rank(left.root), mid, right.root, Balance::rank(right.root), rank);
+    left.rightmost_ = right.rightmost_;
+    left.count_ += right.count_;
+    right.root = nullptr;
+    right.rightmost_ = nullptr;
+    right.count_ = 0;
+
+    return left;
+  }
 
-      // Рекурсивно вставляем правое поддерево
-      insertNodesFrom(node->right);
+ private:
+  Node* maxNode() noexcept {
+    if (rightmost_ == nullptr && root != nullptr) {
+      rightmost_ = rightmost(root);
     }
+    return rightmost_;
   }
 
-  void merge(BinarySearchTree& source) {
-    // Рекурсивно вставляем каждый узел из source в текущее дерево
-    insertNodesFrom(source.root);
+  static Node* leftmost(Node* node) noexcept {
+    while (node->left != nullptr) {
+      node = node->left;
+    }
+    return node;
+  }
 
-    // Очищаем исходное дерево после слияния
-    source.clear();
+  static Node* rightmost(Node* node) noexcept {
+    while (node->right != nullptr) {
+      node = node->right;
+    }
+    return node;
   }
 
-  size_type count(const value_type& value) const {
-    Node* current = root; // Начинаем поиск с корня дерева
-    while (current != nullptr) {
-      if (value == current->value) {
-        return 1; // Элемент найден, возвращаем 1
-      } else if (Compare()(value, current->value)) {
-        current = current->left; // Переходим к левому поддереву
+  // Спуск по пути поиска value, затем подъем по ссылкам на родителей: каждый узел пути
+  // вместе со своим поддеревьем вне пути присоединяется к левой или правой части.
+  // Ранги узлов пути считаются по исходным цветам до того, как join их изменит.
+  // Рекурсии нет, поэтому вырожденные деревья тоже безопасны.
+  void splitNodes(const value_type& value, Node*& left, Node*& right) {
+    left = right = nullptr;
+    if (root == nullptr) {
+      return;
+    }
+    int rank = Balance::rank(root);
+    Node* node = root;
+    while (true) {
+      Node* child = comp_(node->value, value) ? node->right : node->left;
+      if (child == nullptr) {
+        break;
+      }
+      rank = Balance::child_rank(node, rank, child);
+      node = child;
+    }
+    int left_rank = 0;
+    int right_rank = 0;
+    while (node != nullptr) {
+      Node* parent = node->parent;
+      int parent_rank = parent != nullptr ? Balance::parent_rank(parent, node, rank) : 0;
+      bool goes_left = comp_(node->value, value);
+      Node* other = goes_left ? node->left : node->right; // Поддерево вне пути
+      int other_rank = Balance::child_rank(node, rank, other);
+      if (other != nullptr) {
+        other->parent = nullptr;
+      }
+      if (goes_left) {
+        left = Balance::join(other, other_rank, node, left, left_rank, left_rank);
       } else {
-        current = current->right; // Переходим к правому поддереву
+        right = Balance::join(right, right_rank, node, other, other_rank, right_rank);
       }
+      node = parent;
+      rank = parent_rank;
     }
+  }
 
-    return 0; // Элемент не найден, возвращаем 0
+ public:
+  size_type count(const value_type& value) const {
+    return findNode(value) != nullptr ? 1 : 0;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  size_type count(const K& key) const {
+    return findNode(key) != nullptr ? 1 : 0;
   }
 
   bool contains(const value_type& value) const {
-    Node* current = root; // Начинаем поиск с корня дерева
-    while (current != nullptr) {
-      if (value == current->value) {
-        return true; // Значение найдено
-      } else if (Compare()(value, current->value)) {
-        current = current->left; // Переходим к левому поддереву
-      } else {
-        current = current->right; // Переходим к правому поддереву
-      }
-    }
+    return findNode(value) != nullptr;
+  }
 
-    return false; // Значение не найдено в дереве
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  bool contains(const K& key) const {
+    return findNode(key) != nullptr;
   }
 
+  // Возвращают итератор на найденный узел или на end, если узел не найден
   const_iterator<InOrder> lower_bound(const value_type& value) const {
-    const Node* node = root;
-    const Node* result = nullptr; // Изначально устанавливаем результат на nullptr
+    return const_iterator<InOrder>(lowerBoundNode(value), root);
+  }
 
-    while (node != nullptr) {
-      if (node->value < value) {
-        // Если значение узла меньше искомого, идем вправо
-        node = node->right;
-      } else {
-        // Если значение узла больше или равно, запоминаем узел и идем влево
-        result = node;
-        node = node->left;
-      }
-    }
-    // Возвращаем итератор на найденный узел или на end, если узел не найден
-    return const_iterator<InOrder>(result, root);
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> lower_bound(const K& key) const {
+    return const_iterator<InOrder>(lowerBoundNode(key), root);
   }
 
   const_iterator<InOrder> upper_bound(const value_type& value) const {
-    const Node* node = root;
-    const Node* result = nullptr; // Изначально устанавливаем результат на nullptr
+    return const_iterator<InOrder>(upperBoundNode(value), root);
+  }
 
-    while (node != nullptr) {
-      if (node->value <= value) {
-        // Если значение узла меньше или равно искомому, идем вправо
-        node = node->right;
-      } else {
-        // Если значение узла строго больше, запоминаем узел и идем влево
-        result = node;
-        node = node->left;
-      }
-    }
-    // Возвращаем итератор на найденный узел или на end, если узел не найден
-    return const_iterator<InOrder>(result, root);
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> upper_bound(const K& key) const {
+    return const_iterator<InOrder>(upperBoundNode(key), root);
   }
 
   std::pair<const_iterator<InOrder>, const_iterator<InOrder>> equal_range(const value_type& value) const {
@@ -593,6 +2194,96 @@ class BinarySearchTree {
     return std::make_pair(lower_bound(value), upper_bound(value));
   }
 
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  std::pair<const_iterator<InOrder>, const_iterator<InOrder>> equal_range(const K& key) const {
+
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  // Пакетный поиск: ключи из [first, last) обрабатываются группами, результаты пишутся в out
+  // в порядке ключей. Ключи сравниваются через Compare так же, как в одиночных методах.
+  template<typename ForwardIt, typename OutputIt>
+  OutputIt contains_batch(ForwardIt first, ForwardIt last, OutputIt out) const {
+    lowerBoundBatch(first, last, [this, &out](const auto& key, Node* node) {
+      *out++ = node != nullptr && !comp_(key, node->value);
+    });
+
+    return out;
+  }
+
+  template<typename ForwardIt, typename OutputIt>
+  OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) const {
+    lowerBoundBatch(first, last, [this, &out](const auto& key, Node* node) {
+      bool found = node != nullptr && !comp_(key, node->value);
+      *out++ = const_iterator<InOrder>(found ? node : nullptr, root);
+    });
+
+    return out;
+  }
+
+  template<typename ForwardIt, typename OutputIt>
+  OutputIt lower_bound_batch(ForwardIt first, ForwardIt last, OutputIt out) const {
+    lowerBoundBatch(first, last, [this, &out](const auto&, Node* node) {
+      *out++ = const_iterator<InOrder>(node, root);
+    });
+
+    return out;
+  }
+
+ private:
+  static constexpr size_type kBatchWidth = 16;
+
+  static void prefetchNode(const Node* node) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(node);
+#else
+    (void) node;
+#endif
+  }
+
+  // Одиночный спуск простаивает на каждом промахе кэша. Здесь до kBatchWidth спусков идут
+  // по очереди, каждый на один уровень за проход, а следующий узел запрашивается заранее:
+  // пока обрабатываются остальные ключи группы, он успевает прийти из памяти.
+  // visit(ключ, lower bound или nullptr) вызывается в порядке ключей.
+  template<typename ForwardIt, typename Visit>
+  void lowerBoundBatch(ForwardIt first, ForwardIt last, Visit visit) const {
+    ForwardIt keys[kBatchWidth];
+    Node* nodes[kBatchWidth];
+    Node* results[kBatchWidth];
+    while (first != last) {
+      size_type width = 0;
+      for (; width < kBatchWidth && first != last; ++width, ++first) {
+        keys[width] = first;
+        nodes[width] = root;
+        results[width] = nullptr;
+      }
+
+      for (bool active = true; active;) {
+        active = false;
+        for (size_type i = 0; i < width; ++i) {
+          Node* node = nodes[i];
+          if (node == nullptr) {
+            continue; // Этот спуск уже закончен
+          }
+          if (comp_(node->value, *keys[i])) {
+            node = node->right;
+          } else {
+            results[i] = node;
+            node = node->left;
+          }
+          prefetchNode(node);
+          nodes[i] = node;
+          active |= node != nullptr;
+        }
+      }
+
+      for (size_type i = 0; i < width; ++i) {
+        visit(*keys[i], results[i]);
+      }
+    }
+  }
+
+ public:
   // Методы контейнера
   template<typename Order>
   const_iterator<Order> begin() const {
@@ -733,17 +2424,146 @@ class BinarySearchTree {
   }
 
   size_type countNodes(Node* node) const {
-    if (node == nullptr) {
-      return 0;
-    } else {
+    settle(root);
 
-      return 1 + countNodes(node->left) + countNodes(node->right);
-    }
+    return Node::size_of(node); // Размер поддерева хранится в узле
   }
 
   size_type size() const noexcept {
 
-    return countNodes(root);
+    return count_;
+  }
+
+  // Досчитывает размеры и сводки, отложенные вставками с подсказкой. После этого вызова
+  // константные методы ничего не пишут в узлы до следующей вставки с подсказкой.
+  void settleSizes() noexcept {
+    settle(root);
+  }
+
+ private:
+  // Устаревшие узлы образуют связное поддерево от корня, и обход в обратном порядке идет
+  // только по ним: O(числа устаревших узлов), для k вставок подряд в одно место - O(k + высота).
+  static void settle(Node* top) noexcept {
+    Node* node = top;
+    if (!Node::stale(node)) {
+      return;
+    }
+    while (true) {
+      if (Node::stale(node->left)) {
+        node = node->left;
+      } else if (Node::stale(node->right)) {
+        node = node->right;
+      } else {
+        node->pull(); // Оба потомка уже пересчитаны
+        if (node == top) {
+          break;
+        }
+        node = node->parent;
+      }
+    }
+  }
+
+ public:
+  // Количество элементов, строго меньших value
+  size_type rank(const value_type& value) const {
+    settle(root);
+    size_type result = 0;
+    const Node* node = root;
+    while (node != nullptr) {
+      if (comp_(node->value, value)) {
+        result += Node::size_of(node->left) + 1; // Левое поддерево и сам узел меньше value
+        node = node->right;
+      } else {
+        node = node->left;
+      }
+    }
+
+    return result;
+  }
+
+  // k-й по возрастанию элемент (с нуля) или end, если k >= size()
+  const_iterator<InOrder> select(size_type k) const {
+    settle(root);
+    const Node* node = root;
+    while (node != nullptr) {
+      size_type left_size = Node::size_of(node->left);
+      if (k < left_size) {
+        node = node->left;
+      } else if (k == left_size) {
+        break;
+      } else {
+        k -= left_size + 1;
+        node = node->right;
+      }
+    }
+
+    return const_iterator<InOrder>(node, root);
+  }
+
+  const_iterator<InOrder> nth(size_type k) const {
+
+    return select(k);
+  }
+
+  // Количество элементов в полуинтервале [lo, hi)
+  size_type count_range(const value_type& lo, const value_type& hi) const {
+    if (!comp_(lo, hi)) {
+      return 0;
+    }
+
+    return rank(hi) - rank(lo);
+  }
+
+  // Сводка всех элементов, O(1)
+  template<typename A = Augment>
+  typename A::summary_type aggregate() const {
+    settle(root);
+
+    return Node::summary_of(root);
+  }
+
+  // Сводка элементов полуинтервала [lo, hi) в порядке возрастания, O(log n) для
+  // сбалансированных политик: путь поиска расходится на два, и вдоль каждого берутся
+  // сводки целых поддеревьев
+  template<typename A = Augment>
+  typename A::summary_type aggregate(const value_type& lo, const value_type& hi) const {
+    settle(root);
+    const Node* node = root;
+    while (node != nullptr) {
+      if (comp_(node->value, lo)) {
+        node = node->right;
+      } else if (!comp_(node->value, hi)) {
+        node = node->left;
+      } else {
+        break; // node внутри диапазона: левая граница ищется слева, правая - справа
+      }
+    }
+    if (node == nullptr || !comp_(lo, hi)) {
+      return Augment::identity();
+    }
+
+    // Элементы >= lo левого поддерева: найденные части лежат левее уже собранных
+    typename A::summary_type left = Augment::identity();
+    for (const Node* n = node->left; n != nullptr;) {
+      if (comp_(n->value, lo)) {
+        n = n->right;
+      } else {
+        left = Augment::combine(Augment::combine(Augment::summarize(n->value), Node::summary_of(n->right)), left);
+        n = n->left;
+      }
+    }
+    // Элементы < hi правого поддерева: найденные части лежат правее уже собранных
+    typename A::summary_type right = Augment::identity();
+    for (const Node* n = node->right; n != nullptr;) {
+      if (comp_(n->value, hi)) {
+        right = Augment::combine(right, Augment::combine(Node::summary_of(n->left), Augment::summarize(n->value)));
+        n = n->right;
+      } else {
+        n = n->left;
+      }
+    }
+
+    return Augment::combine(Augment::combine(left, Augment::summarize(node->value)), right);
   }
 
   size_type max_size() const noexcept {
@@ -751,8 +2571,208 @@ class BinarySearchTree {
     return std::allocator_traits<allocator_type>::max_size(node_allocator_);
   }
 
+  key_compare key_comp() const {
+
+    return comp_;
+  }
+
+  value_compare value_comp() const {
+
+    return comp_;
+  }
+
   allocator_type get_allocator() const noexcept {
 
     return node_allocator_;
   }
+
+  // Параллельные обходы на пуле потоков. Диапазон рангов [0, size()) делится пополам, пока
+  // куски больше порога; начало куска находится через select по размерам поддеревьев,
+  // дальше элементы перебираются итератором. Дерево во время обхода не должно меняться.
+
+  // f вызывается для каждого элемента ровно один раз, в неопределенном порядке и из разных потоков
+  template<typename F>
+  void for_each(ThreadPool& pool, F f) const {
+    reduceRanks(pool, [this, &f](size_type first, size_type count) {
+      const_iterator<InOrder> it = select(first);
+      for (size_type i = 0; i < count; ++i, ++it) {
+        f(*it);
+      }
+      return count;
+    }, std::plus<size_type>());
+  }
+
+  // Упорядоченная свертка: результат тот же, что у последовательной op(...op(op(init, v0), v1)...),
+  // если op ассоциативна; коммутативность не требуется. U должен создаваться из value_type.
+  template<typename U, typename BinaryOp>
+  U reduce(ThreadPool& pool, U init, BinaryOp op) const {
+    if (empty()) {
+      return init;
+    }
+    U total = reduceRanks(pool, [this, &op](size_type first, size_type count) {
+      const_iterator<InOrder> it = select(first);
+      U result(*it);
+      for (size_type i = 1; i < count; ++i) {
+        result = op(std::move(result), *++it);
+      }
+      return result;
+    }, op);
+
+    return op(std::move(init), std::move(total));
+  }
+
+  template<typename Predicate>
+  size_type count_if(ThreadPool& pool, Predicate pred) const {
+
+    return reduceRanks(pool, [this, &pred](size_type first, size_type count) {
+      const_iterator<InOrder> it = select(first);
+      size_type result = 0;
+      for (size_type i = 0; i < count; ++i, ++it) {
+        if (pred(*it)) {
+          ++result;
+        }
+      }
+      return result;
+    }, std::plus<size_type>());
+  }
+
+ private:
+  static constexpr size_type kParallelGrain = 2048;
+  static constexpr char kFormatMagic[5] = "BSTR";
+  // Значений в одном блоке ввода-вывода при побайтовой записи, около 64 КБ
+  static constexpr size_type kIoChunk = std::max<size_type>(1, (size_type(1) << 16) / sizeof(value_type));
+
+  // Блок ввода-вывода в куче, не на стеке; для небольших деревьев - по их размеру
+  static std::unique_ptr<unsigned char[]> ioBuffer(size_type count) {
+    size_type values = std::min(kIoChunk, std::max<size_type>(count, 1));
+
+    return std::unique_ptr<unsigned char[]>(new unsigned char[values * sizeof(value_type)]);
+  }
+
+  using ValueAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<value_type>;
+  using ValueTraits = std::allocator_traits<ValueAllocator>;
+  using NodePointerAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Node*>;
+  using NodePointerTraits = std::allocator_traits<NodePointerAllocator>;
+
+  // Около восьми кусков на поток, чтобы перехват работы выравнивал нагрузку
+  static size_type parallelGrain(const ThreadPool& pool, size_type count) noexcept {
+
+    return std::max(kParallelGrain, count / (8 * (pool.size() + 1)));
+  }
+
+  // Устойчивая сортировка слиянием: половины сортируются параллельно, затем сливаются
+  void sortValues(ThreadPool& pool, value_type* first, value_type* last, size_type grain) const {
+    auto less = [this](const value_type& lhs, const value_type& rhs) { return comp_(lhs, rhs); };
+    if (static_cast<size_type>(last - first) <= grain) {
+      std::stable_sort(first, last, less);
+      return;
+    }
+    value_type* middle = first + (last - first) / 2;
+    pool.invoke([&] { sortValues(pool, first, middle, grain); },
+                [&] { sortValues(pool, middle, last, grain); });
+    std::inplace_merge(first, middle, last, less);
+  }
+
+  // Конструирует узлы [first, last) перемещением значений. Либо создаются все узлы диапазона,
+  // либо, при исключении, ни одного.
+  void constructNodes(ThreadPool& pool, Node** nodes, value_type* values, size_type first, size_type last,
+                      size_type grain) {
+    if (last - first <= grain) {
+      size_type i = first;
+      try {
+        for (; i < last; ++i) {
+          NodeTraits::construct(node_allocator_, nodes[i], std::in_place, std::move(values[i]));
+        }
+      } catch (...) {
+        destroyNodes(nodes, first, i);
+        throw;
+      }
+      return;
+    }
+    size_type middle = first + (last - first) / 2;
+    bool left_done = false;
+    bool right_done = false;
+    try {
+      pool.invoke([&] {
+        constructNodes(pool, nodes, values, first, middle, grain);
+        left_done = true;
+      }, [&] {
+        constructNodes(pool, nodes, values, middle, last, grain);
+        right_done = true;
+      });
+    } catch (...) {
+      if (left_done) {
+        destroyNodes(nodes, first, middle);
+      }
+      if (right_done) {
+        destroyNodes(nodes, middle, last);
+      }
+      throw;
+    }
+  }
+
+  void destroyNodes(Node** nodes, size_type first, size_type last) noexcept {
+    for (size_type i = first; i < last; ++i) {
+      NodeTraits::destroy(node_allocator_, nodes[i]);
+    }
+  }
+
+  // Связывает узлы [first, last) в идеально сбалансированное поддерево той же формы,
+  // что строит buildFromList; крупные поддеревья собираются параллельно
+  Node* linkNodes(ThreadPool& pool, Node** nodes, size_type first, size_type last, size_type depth,
+                  size_type complete_depth, size_type grain) {
+    if (first == last) {
+      return nullptr;
+    }
+    size_type middle = first + (last - first) / 2;
+    Node* node = nodes[middle];
+    if (last - first <= grain) {
+      node->left = linkNodes(pool, nodes, first, middle, depth + 1, complete_depth, grain);
+      node->right = linkNodes(pool, nodes, middle + 1, last, depth + 1, complete_depth, grain);
+    } else {
+      pool.invoke([&] { node->left = linkNodes(pool, nodes, first, middle, depth + 1, complete_depth, grain); },
+                  [&] { node->right = linkNodes(pool, nodes, middle + 1, last, depth + 1, complete_depth, grain); });
+    }
+    node->parent = nullptr;
+    if (node->left != nullptr) {
+      node->left->parent = node;
+    }
+    if (node->right != nullptr) {
+      node->right->parent = node;
+    }
+    node->pull();
+    Balance::on_build(node, depth, complete_depth);
+
+    return node;
+  }
+
+  // Результаты кусков объединяются слева направо: combine(левая половина, правая половина)
+  template<typename Leaf, typename Combine>
+  auto reduceRanks(ThreadPool& pool, Leaf leaf, Combine combine) const {
+
+    return reduceRanks(pool, 0, size(), parallelGrain(pool, size()), leaf, combine);
+  }
+
+  template<typename Leaf, typename Combine>
+  auto reduceRanks(ThreadPool& pool, size_type first, size_type last, size_type grain,
+                   Leaf& leaf, Combine& combine) const -> decltype(leaf(first, last)) {
+    using Result = decltype(leaf(first, last));
+    if (last - first <= grain) {
+      return leaf(first, last - first);
+    }
+    size_type middle = first + (last - first) / 2;
+    std::optional<Result> left;
+    std::optional<Result> right;
+    pool.invoke([&] { left.emplace(reduceRanks(pool, first, middle, grain, leaf, combine)); },
+                [&] { right.emplace(reduceRanks(pool, middle, last, grain, leaf, combine)); });
+
+    return combine(std::move(*left), std::move(*right));
+  }
+
+ public:
+  // Неизменяемый снимок текущего содержимого с кэш-дружественным поиском, O(n)
+  FrozenTree<T, Compare, Alloc> freeze() const {
+
+    return FrozenTree<T, Compare, Alloc>(begin<InOrder>(), end<InOrder>(), size(), comp_, node_allocator_);
+  }
 };
@@ -0,0 +1,1188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "bst.h"
+
+// B-дерево с тем же интерфейсом, что и BinarySearchTree: теги обхода, const_iterator<Order>,
+// begin<Order>() и ассоциативные методы совпадают, поэтому контейнеры взаимозаменяемы
+// через псевдоним типа. Любой узел, и лист, и внутренний, занимает не больше NodeBytes байт
+// (по умолчанию четыре кэш-линии): лист заполняется одними ключами, а во внутреннем узле на
+// каждый ключ приходится еще указатель на ребенка, поэтому ключей в нем меньше. На ключ
+// приходится меньше указателей, а на уровень дерева - один-два промаха кэша вместо одного
+// на каждый ключ.
+//
+// Обходы обобщают двоичные: PreOrder - ключи узла по возрастанию, затем поддеревья слева
+// направо; PostOrder - поддеревья слева направо, затем ключи узла.
+template<typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>,
+         std::size_t NodeBytes = 256>
+class BTree {
+ public:
+  using value_type = T;
+  using allocator_type = Alloc;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using pointer = typename std::allocator_traits<allocator_type>::pointer;
+  using const_pointer = typename std::allocator_traits<allocator_type>::const_pointer;
+  using key_type = T;
+  using key_compare = Compare;
+  using value_compare = Compare;
+
+ private:
+  struct LeafNode;
+  struct InternalNode;
+
+  // Заголовок узла: родитель, размер поддерева, число ключей и позиция среди детей родителя.
+  // Ключи лежат сразу за заголовком; память под них не инициализируется до вставки.
+  struct Node {
+    InternalNode* parent = nullptr;
+    size_type size = 0; // Количество элементов в поддереве
+    std::uint16_t count = 0;
+    std::uint16_t position = 0; // Индекс в parent->children
+    bool leaf = true;
+
+    Node() noexcept {}
+
+    // Смещение ключей в листе и во внутреннем узле одинаково, ветвление сводится к нему
+    T* keys() noexcept {
+      return leaf ? static_cast<LeafNode*>(this)->keys() : static_cast<InternalNode*>(this)->keys();
+    }
+
+    const T* keys() const noexcept {
+      return leaf ? static_cast<const LeafNode*>(this)->keys() : static_cast<const InternalNode*>(this)->keys();
+    }
+
+    T& key(size_type i) noexcept {
+      return keys()[i];
+    }
+
+    const T& key(size_type i) const noexcept {
+      return keys()[i];
+    }
+  };
+
+  static constexpr size_type kHeaderBytes = (sizeof(Node) + alignof(T) - 1) / alignof(T) * alignof(T);
+  // Лист заполняется ключами. Во внутреннем узле на каждый ключ приходится еще указатель на
+  // ребенка, плюс один лишний указатель и выравнивание массива детей после ключей.
+  static constexpr size_type kChildBytes = sizeof(void*);
+  static constexpr size_type kMaxLeafKeys =
+      std::max<size_type>(3, NodeBytes > kHeaderBytes ? (NodeBytes - kHeaderBytes) / sizeof(T) : 0);
+  static constexpr size_type kMaxInternalKeys = std::max<size_type>(
+      3, NodeBytes > kHeaderBytes + 2 * kChildBytes
+             ? (NodeBytes - kHeaderBytes - 2 * kChildBytes + 1) / (sizeof(T) + kChildBytes)
+             : 0);
+  static_assert(kMaxLeafKeys <= UINT16_MAX, "NodeBytes is too large for 16-bit key counters");
+
+  template<size_type Keys>
+  struct KeyStorage {
+    alignas(T) unsigned char storage[Keys * sizeof(T)];
+
+    T* keys() noexcept {
+      return std::launder(reinterpret_cast<T*>(storage));
+    }
+
+    const T* keys() const noexcept {
+      return std::launder(reinterpret_cast<const T*>(storage));
+    }
+  };
+
+  struct LeafNode : Node, KeyStorage<kMaxLeafKeys> {
+    using KeyStorage<kMaxLeafKeys>::keys;
+  };
+
+  struct InternalNode : Node, KeyStorage<kMaxInternalKeys> {
+    using KeyStorage<kMaxInternalKeys>::keys;
+
+    Node* children[kMaxInternalKeys + 1];
+
+    InternalNode() noexcept {
+      this->leaf = false;
+    }
+  };
+
+  static size_type maxKeys(const Node* node) noexcept {
+    return node->leaf ? kMaxLeafKeys : kMaxInternalKeys;
+  }
+
+  // Для всех узлов, кроме корня
+  static size_type minKeys(const Node* node) noexcept {
+    return (maxKeys(node) - 1) / 2;
+  }
+
+  using ValueTraits = std::allocator_traits<Alloc>;
+  using LeafAllocator = typename ValueTraits::template rebind_alloc<LeafNode>;
+  using LeafTraits = std::allocator_traits<LeafAllocator>;
+  using InternalAllocator = typename ValueTraits::template rebind_alloc<InternalNode>;
+  using InternalTraits = std::allocator_traits<InternalAllocator>;
+
+  static InternalNode* asInternal(Node* node) noexcept {
+    return static_cast<InternalNode*>(node);
+  }
+
+  static const InternalNode* asInternal(const Node* node) noexcept {
+    return static_cast<const InternalNode*>(node);
+  }
+
+  allocator_type alloc_;
+  Compare comp_; // Все сравнения ключей идут только через него
+  Node* root; // Указатель на корень дерева
+
+ public:
+
+  template<typename Order>
+  class const_iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = const T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator(const Node* node = nullptr, size_type index = 0, const Node* root = nullptr)
+        : node(node), index(index), root(root) {}
+
+    const_iterator& operator++() {
+      increment(Order());
+      return *this;
+    }
+
+    const_iterator& operator--() {
+      decrement(Order());
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator result = *this;
+      --*this;
+      return result;
+    }
+
+    reference operator*() const {
+      return node->key(index);
+    }
+
+    pointer operator->() const {
+      return &node->key(index);
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return node == other.node && index == other.index;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class BTree;
+
+    const Node* node; // nullptr - конец обхода
+    size_type index;      // Номер ключа в узле
+    const Node* root;
+
+    static const Node* child(const Node* node, size_type i) {
+      return asInternal(node)->children[i];
+    }
+
+    static const Node* leftmostLeaf(const Node* node) {
+      while (!node->leaf) {
+        node = child(node, 0);
+      }
+      return node;
+    }
+
+    static const Node* rightmostLeaf(const Node* node) {
+      while (!node->leaf) {
+        node = child(node, node->count);
+      }
+      return node;
+    }
+
+    void increment(InOrder) {
+      if (node == nullptr) {
+        return;
+      }
+      if (!node->leaf) {
+        node = leftmostLeaf(child(node, index + 1)); // Следующий - минимум поддерева справа от ключа
+        index = 0;
+      } else if (index + 1 < node->count) {
+        ++index;
+      } else {
+        // Лист пройден: поднимаемся, пока узел - последний ребенок
+        while (node->parent != nullptr && node->position == node->parent->count) {
+          node = node->parent;
+        }
+        index = node->position;
+        node = node->parent;
+        if (node == nullptr) {
+          index = 0;
+        }
+      }
+    }
+
+    void decrement(InOrder) {
+      if (node == nullptr) {
+        if (root == nullptr) {
+          return;
+        }
+        node = rightmostLeaf(root);
+        index = node->count - 1;
+      } else if (!node->leaf) {
+        node = rightmostLeaf(child(node, index)); // Максимум поддерева слева от ключа
+        index = node->count - 1;
+      } else if (index > 0) {
+        --index;
+      } else {
+        while (node->parent != nullptr && node->position == 0) {
+          node = node->parent;
+        }
+        index = node->position - 1;
+        node = node->parent;
+        if (node == nullptr) {
+          index = 0;
+        }
+      }
+    }
+
+    void increment(PreOrder) {
+      if (node == nullptr) {
+        return;
+      }
+      if (index + 1 < node->count) {
+        ++index;
+      } else if (!node->leaf) {
+        node = child(node, 0); // Ключи узла пройдены, дальше - первое поддерево
+        index = 0;
+      } else {
+        // Поддерево пройдено: переходим к следующему брату ближайшего предка, у которого он есть
+        while (node->parent != nullptr && node->position == node->parent->count) {
+          node = node->parent;
+        }
+        node = node->parent != nullptr ? child(node->parent, node->position + 1) : nullptr;
+        index = 0;
+      }
+    }
+
+    void decrement(PreOrder) {
+      if (node == nullptr) {
+        if (root == nullptr) {
+          return;
+        }
+        node = rightmostLeaf(root); // Последним в PreOrder посещается самый правый лист
+        index = node->count - 1;
+      } else if (index > 0) {
+        --index;
+      } else if (node->parent == nullptr) {
+        node = nullptr; // Корень - начало обхода
+      } else if (node->position == 0) {
+        node = node->parent; // Перед первым поддеревом идут ключи родителя
+        index = node->count - 1;
+      } else {
+        node = rightmostLeaf(child(node->parent, node->position - 1));
+        index = node->count - 1;
+      }
+    }
+
+    void increment(PostOrder) {
+      if (node == nullptr) {
+        return;
+      }
+      if (index + 1 < node->count) {
+        ++index;
+      } else if (node->parent == nullptr) {
+        node = nullptr; // Ключи корня посещаются последними
+        index = 0;
+      } else if (node->position < node->parent->count) {
+        node = leftmostLeaf(child(node->parent, node->position + 1));
+        index = 0;
+      } else {
+        node = node->parent; // Все поддеревья родителя пройдены, дальше - его ключи
+        index = 0;
+      }
+    }
+
+    void decrement(PostOrder) {
+      if (node == nullptr) {
+        if (root == nullptr) {
+          return;
+        }
+        node = root;
+        index = node->count - 1;
+      } else if (index > 0) {
+        --index;
+      } else if (!node->leaf) {
+        node = child(node, node->count); // Перед ключами узла заканчивается его последнее поддерево
+        index = node->count - 1;
+      } else {
+        while (node->parent != nullptr && node->position == 0) {
+          node = node->parent;
+        }
+        node = node->parent != nullptr ? child(node->parent, node->position - 1) : nullptr;
+        index = node != nullptr ? node->count - 1 : 0;
+      }
+    }
+  };
+
+  // Конструкторы и деструктор + методы для них
+  BTree() noexcept(std::is_nothrow_default_constructible_v<Alloc> && std::is_nothrow_default_constructible_v<Compare>)
+      : alloc_(), comp_(), root(nullptr) {}
+
+  explicit BTree(const allocator_type& alloc) : alloc_(alloc), root(nullptr) {}
+
+  explicit BTree(const Compare& comp, const allocator_type& alloc = allocator_type())
+      : alloc_(alloc), comp_(comp), root(nullptr) {}
+
+  // Построение из отсортированного диапазона без повторов: каждый элемент дописывается
+  // в самый правый лист без сравнений с остальными ключами
+  template<typename InputIt>
+  BTree(SortedUnique, InputIt first, InputIt last, const Compare& comp = Compare(),
+        const allocator_type& alloc = allocator_type())
+      : alloc_(alloc), comp_(comp), root(nullptr) {
+    try {
+      for (; first != last; ++first) {
+        append(*first);
+      }
+    } catch (...) {
+      clear();
+      throw;
+    }
+  }
+
+  template<typename InputIt>
+  BTree(SortedUnique, InputIt first, InputIt last, const allocator_type& alloc)
+      : BTree(SortedUnique(), first, last, Compare(), alloc) {}
+
+  BTree(const BTree& other)
+      : alloc_(ValueTraits::select_on_container_copy_construction(other.alloc_)), comp_(other.comp_), root(nullptr) {
+    if (other.root != nullptr) {
+      root = clone(other.root, nullptr);
+    }
+  }
+
+  BTree(BTree&& other) noexcept : alloc_(std::move(other.alloc_)), comp_(other.comp_), root(other.root) {
+    other.root = nullptr;
+  }
+
+  ~BTree() {
+    clear();
+  }
+
+  void swap(BTree& other) noexcept {
+    using std::swap;
+    swap(root, other.root);
+    swap(alloc_, other.alloc_);
+    swap(comp_, other.comp_);
+  }
+
+  BTree& operator=(const BTree& other) {
+    if (this != &other) {
+      BTree copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  BTree& operator=(BTree&& other) noexcept(
+      ValueTraits::propagate_on_container_move_assignment::value || ValueTraits::is_always_equal::value) {
+    if (this == &other) {
+      return *this;
+    }
+    clear();
+    comp_ = other.comp_;
+    if constexpr (ValueTraits::propagate_on_container_move_assignment::value) {
+      alloc_ = std::move(other.alloc_);
+    } else if (alloc_ != other.alloc_) {
+      // Узлы чужого аллокатора забрать нельзя, поэтому значения перемещаются поштучно
+      for (auto it = other.begin<InOrder>(); it != other.end<InOrder>(); ++it) {
+        append(std::move(other.mutableValue(it)));
+      }
+      other.clear();
+      return *this;
+    }
+    root = other.root;
+    other.root = nullptr;
+    return *this;
+  }
+
+  void clear() noexcept {
+    if (root != nullptr) {
+      clear(root);
+      root = nullptr;
+    }
+  }
+
+ private:
+  // Методы для работы с узлами
+  Node* allocateLeaf() {
+    LeafAllocator alloc(alloc_);
+    LeafNode* node = LeafTraits::allocate(alloc, 1);
+    LeafTraits::construct(alloc, node);
+    return node;
+  }
+
+  InternalNode* allocateInternal() {
+    InternalAllocator alloc(alloc_);
+    InternalNode* node = InternalTraits::allocate(alloc, 1);
+    InternalTraits::construct(alloc, node);
+    return node;
+  }
+
+  Node* allocateLike(const Node* node) {
+    if (node->leaf) {
+      return allocateLeaf();
+    }
+    return allocateInternal();
+  }
+
+  // Разрушает ключи узла и освобождает его память; потомки не затрагиваются
+  void deallocateNode(Node* node) noexcept {
+    for (size_type i = 0; i < node->count; ++i) {
+      ValueTraits::destroy(alloc_, &node->key(i));
+    }
+    if (node->leaf) {
+      LeafAllocator alloc(alloc_);
+      LeafTraits::destroy(alloc, static_cast<LeafNode*>(node));
+      LeafTraits::deallocate(alloc, static_cast<LeafNode*>(node), 1);
+    } else {
+      InternalAllocator alloc(alloc_);
+      InternalTraits::destroy(alloc, asInternal(node));
+      InternalTraits::deallocate(alloc, asInternal(node), 1);
+    }
+  }
+
+  // Высота B-дерева - O(log n) по основанию порядка узла, поэтому рекурсия неглубокая
+  void clear(Node* node) noexcept {
+    if (!node->leaf) {
+      for (size_type i = 0; i <= node->count; ++i) {
+        clear(asInternal(node)->children[i]);
+      }
+    }
+    deallocateNode(node);
+  }
+
+  Node* clone(const Node* from, InternalNode* parent) {
+    Node* to = allocateLike(from);
+    to->parent = parent;
+    to->position = from->position;
+    to->size = from->size;
+    size_type cloned = 0;
+    try {
+      for (; to->count < from->count; ++to->count) {
+        ValueTraits::construct(alloc_, &to->key(to->count), from->key(to->count));
+      }
+      if (!from->leaf) {
+        for (; cloned <= from->count; ++cloned) {
+          asInternal(to)->children[cloned] = clone(asInternal(from)->children[cloned], asInternal(to));
+        }
+      }
+    } catch (...) {
+      for (size_type i = 0; i < cloned; ++i) {
+        clear(asInternal(to)->children[i]);
+      }
+      deallocateNode(to);
+      throw;
+    }
+
+    return to;
+  }
+
+  static size_type subtreeSize(const Node* node) noexcept {
+    size_type size = node->count;
+    if (!node->leaf) {
+      for (size_type i = 0; i <= node->count; ++i) {
+        size += asInternal(node)->children[i]->size;
+      }
+    }
+    return size;
+  }
+
+  void moveKey(T* to, T* from) {
+    ValueTraits::construct(alloc_, to, std::move(*from));
+    ValueTraits::destroy(alloc_, from);
+  }
+
+  // Освобождает позицию i, сдвигая ключи вправо; позиция остается неинициализированной
+  void openSlot(Node* node, size_type i) {
+    for (size_type j = node->count; j > i; --j) {
+      moveKey(&node->key(j), &node->key(j - 1));
+    }
+    ++node->count;
+  }
+
+  // Закрывает неинициализированную позицию i, сдвигая ключи влево
+  void closeSlot(Node* node, size_type i) {
+    for (size_type j = i + 1; j < node->count; ++j) {
+      moveKey(&node->key(j - 1), &node->key(j));
+    }
+    --node->count;
+  }
+
+  static void setChild(InternalNode* parent, size_type i, Node* child) noexcept {
+    parent->children[i] = child;
+    child->parent = parent;
+    child->position = static_cast<std::uint16_t>(i);
+  }
+
+  // Поиск внутри узла. Для арифметических ключей узел из нескольких кэш-линий быстрее
+  // просмотреть целиком, суммируя результаты сравнений: в цикле нет ветвлений и компилятор
+  // его векторизует. Для остальных типов - двоичный поиск.
+  template<typename K>
+  size_type lowerIndex(const Node* node, const K& key) const {
+    const T* keys = node->keys();
+    size_type count = node->count;
+    if constexpr (std::is_arithmetic_v<T> && std::is_arithmetic_v<K>) {
+      size_type result = 0;
+      for (size_type i = 0; i < count; ++i) {
+        result += static_cast<size_type>(comp_(keys[i], key));
+      }
+      return result;
+    } else {
+      size_type first = 0;
+      while (count > 0) {
+        size_type half = count / 2;
+        if (comp_(keys[first + half], key)) {
+          first += half + 1;
+          count -= half + 1;
+        } else {
+          count = half;
+        }
+      }
+      return first;
+    }
+  }
+
+  template<typename K>
+  size_type upperIndex(const Node* node, const K& key) const {
+    const T* keys = node->keys();
+    size_type count = node->count;
+    if constexpr (std::is_arithmetic_v<T> && std::is_arithmetic_v<K>) {
+      size_type result = 0;
+      for (size_type i = 0; i < count; ++i) {
+        result += static_cast<size_type>(!comp_(key, keys[i]));
+      }
+      return result;
+    } else {
+      size_type first = 0;
+      while (count > 0) {
+        size_type half = count / 2;
+        if (!comp_(key, keys[first + half])) {
+          first += half + 1;
+          count -= half + 1;
+        } else {
+          count = half;
+        }
+      }
+      return first;
+    }
+  }
+
+  // Позиция первого ключа, не меньшего key; node == nullptr, если такого нет
+  template<typename K>
+  const_iterator<InOrder> lowerBoundPosition(const K& key) const {
+    const Node* node = root;
+    const_iterator<InOrder> result(nullptr, 0, root);
+    while (node != nullptr) {
+      size_type i = lowerIndex(node, key);
+      if (i < node->count) {
+        result.node = node;
+        result.index = i;
+      }
+      node = node->leaf ? nullptr : asInternal(node)->children[i];
+    }
+
+    return result;
+  }
+
+  template<typename K>
+  const_iterator<InOrder> upperBoundPosition(const K& key) const {
+    const Node* node = root;
+    const_iterator<InOrder> result(nullptr, 0, root);
+    while (node != nullptr) {
+      size_type i = upperIndex(node, key);
+      if (i < node->count) {
+        result.node = node;
+        result.index = i;
+      }
+      node = node->leaf ? nullptr : asInternal(node)->children[i];
+    }
+
+    return result;
+  }
+
+  template<typename K>
+  const_iterator<InOrder> findPosition(const K& key) const {
+    const Node* node = root;
+    while (node != nullptr) {
+      size_type i = lowerIndex(node, key);
+      if (i < node->count && !comp_(key, node->key(i))) {
+        return const_iterator<InOrder>(node, i, root); // Ни один из ключей не меньше другого
+      }
+      node = node->leaf ? nullptr : asInternal(node)->children[i];
+    }
+
+    return const_iterator<InOrder>(nullptr, 0, root);
+  }
+
+  // Элементы хранятся в узлах дерева, константность итератора - только для пользователя
+  static T& mutableValue(const_iterator<InOrder> it) noexcept {
+    return const_cast<Node*>(it.node)->key(it.index);
+  }
+
+  // Делит полный узел пополам, средний ключ уходит в родителя. Возвращает новый правый узел.
+  Node* split(Node* node) {
+    Node* right = allocateLike(node);
+    try {
+      if (node->parent == nullptr) {
+        InternalNode* new_root = allocateInternal();
+        new_root->size = node->size;
+        setChild(new_root, 0, node);
+        root = new_root;
+      } else if (node->parent->count == kMaxInternalKeys) {
+        split(node->parent); // После деления родителя node может оказаться в его правой половине
+      }
+    } catch (...) {
+      deallocateNode(right);
+      throw;
+    }
+
+    InternalNode* parent = node->parent;
+    const size_type mid = maxKeys(node) / 2;
+    for (size_type j = mid + 1; j < node->count; ++j) {
+      moveKey(&right->key(j - mid - 1), &node->key(j));
+    }
+    right->count = static_cast<std::uint16_t>(node->count - mid - 1);
+    if (!node->leaf) {
+      for (size_type j = mid + 1; j <= node->count; ++j) {
+        setChild(asInternal(right), j - mid - 1, asInternal(node)->children[j]);
+      }
+    }
+
+    size_type p = node->position;
+    openSlot(parent, p);
+    for (size_type j = parent->count; j > p + 1; --j) {
+      setChild(parent, j, parent->children[j - 1]);
+    }
+    moveKey(&parent->key(p), &node->key(mid));
+    setChild(parent, p + 1, right);
+    node->count = static_cast<std::uint16_t>(mid);
+    // Размеры предков не меняются: элементы лишь перераспределяются внутри их поддеревьев
+    node->size = subtreeSize(node);
+    right->size = subtreeSize(right);
+
+    return right;
+  }
+
+  // Вставляет значение в позицию i листа; полный лист сначала делится
+  template<typename V>
+  const_iterator<InOrder> insertIntoLeaf(Node* leaf, size_type i, V&& value) {
+    if (leaf->count == kMaxLeafKeys) {
+      Node* right = split(leaf);
+      if (i > leaf->count) {
+        i -= leaf->count + 1;
+        leaf = right;
+      }
+    }
+    openSlot(leaf, i);
+    try {
+      ValueTraits::construct(alloc_, &leaf->key(i), std::forward<V>(value));
+    } catch (...) {
+      closeSlot(leaf, i);
+      throw;
+    }
+    for (Node* node = leaf; node != nullptr; node = node->parent) {
+      ++node->size;
+    }
+
+    return const_iterator<InOrder>(leaf, i, root);
+  }
+
+  template<typename V>
+  std::pair<const_iterator<InOrder>, bool> insertValue(V&& value) {
+    if (root == nullptr) {
+      root = allocateLeaf();
+    }
+    Node* node = root;
+    while (true) {
+      size_type i = lowerIndex(node, value);
+      if (i < node->count && !comp_(value, node->key(i))) {
+        return std::make_pair(const_iterator<InOrder>(node, i, root), false); // Повторы не допускаются
+      }
+      if (node->leaf) {
+        try {
+          return std::make_pair(insertIntoLeaf(node, i, std::forward<V>(value)), true);
+        } catch (...) {
+          if (root->count == 0) { // Первая вставка в пустое дерево не удалась
+            deallocateNode(root);
+            root = nullptr;
+          }
+          throw;
+        }
+      }
+      node = asInternal(node)->children[i];
+    }
+  }
+
+  // Дописывает значение, большее всех элементов дерева
+  template<typename V>
+  const_iterator<InOrder> append(V&& value) {
+    if (root == nullptr) {
+      return insertValue(std::forward<V>(value)).first;
+    }
+    Node* leaf = root;
+    while (!leaf->leaf) {
+      leaf = asInternal(leaf)->children[leaf->count];
+    }
+    return insertIntoLeaf(leaf, leaf->count, std::forward<V>(value));
+  }
+
+  template<typename V>
+  const_iterator<InOrder> insertValue(const_iterator<InOrder> hint, V&& value) {
+    // Подсказка используется для частого случая - вставки в конец по возрастанию
+    if (hint == end<InOrder>() && root != nullptr && comp_(*rbegin<InOrder>(), value)) {
+      return append(std::forward<V>(value));
+    }
+    return insertValue(std::forward<V>(value)).first;
+  }
+
+  void eraseAt(Node* node, size_type i) {
+    ValueTraits::destroy(alloc_, &node->key(i));
+    if (!node->leaf) {
+      // Ключ внутреннего узла заменяется предшественником, который всегда лежит в листе
+      Node* leaf = asInternal(node)->children[i];
+      while (!leaf->leaf) {
+        leaf = asInternal(leaf)->children[leaf->count];
+      }
+      moveKey(&node->key(i), &leaf->key(leaf->count - 1));
+      node = leaf;
+      i = leaf->count - 1;
+    }
+    closeSlot(node, i);
+    for (Node* current = node; current != nullptr; current = current->parent) {
+      --current->size;
+    }
+    rebalance(node);
+  }
+
+  // Восстанавливает заполненность узлов после удаления: заем у соседа или слияние с ним
+  void rebalance(Node* node) {
+    while (node != root && node->count < minKeys(node)) {
+      InternalNode* parent = node->parent;
+      size_type p = node->position;
+      if (p > 0 && parent->children[p - 1]->count > minKeys(node)) {
+        rotateRight(parent, p - 1);
+        return;
+      }
+      if (p < parent->count && parent->children[p + 1]->count > minKeys(node)) {
+        rotateLeft(parent, p);
+        return;
+      }
+      mergeChildren(parent, p > 0 ? p - 1 : p);
+      node = parent;
+    }
+    if (root->count == 0) {
+      Node* old_root = root;
+      if (root->leaf) {
+        root = nullptr;
+      } else {
+        root = asInternal(root)->children[0];
+        root->parent = nullptr;
+        root->position = 0;
+      }
+      deallocateNode(old_root);
+    }
+  }
+
+  // Последний ключ левого ребенка уходит в родителя, а разделитель - в начало правого
+  void rotateRight(InternalNode* parent, size_type s) {
+    Node* left = parent->children[s];
+    Node* right = parent->children[s + 1];
+    openSlot(right, 0);
+    moveKey(&right->key(0), &parent->key(s));
+    moveKey(&parent->key(s), &left->key(left->count - 1));
+    closeSlot(left, left->count - 1);
+    size_type moved = 1;
+    if (!left->leaf) {
+      Node* child = asInternal(left)->children[left->count + 1];
+      for (size_type j = right->count; j > 0; --j) {
+        setChild(asInternal(right), j, asInternal(right)->children[j - 1]);
+      }
+      setChild(asInternal(right), 0, child);
+      moved += child->size;
+    }
+    left->size -= moved;
+    right->size += moved;
+  }
+
+  void rotateLeft(InternalNode* parent, size_type s) {
+    Node* left = parent->children[s];
+    Node* right = parent->children[s + 1];
+    openSlot(left, left->count);
+    moveKey(&left->key(left->count - 1), &parent->key(s));
+    moveKey(&parent->key(s), &right->key(0));
+    closeSlot(right, 0);
+    size_type moved = 1;
+    if (!right->leaf) {
+      Node* child = asInternal(right)->children[0];
+      for (size_type j = 0; j <= right->count; ++j) {
+        setChild(asInternal(right), j, asInternal(right)->children[j + 1]);
+      }
+      setChild(asInternal(left), left->count, child);
+      moved += child->size;
+    }
+    left->size += moved;
+    right->size -= moved;
+  }
+
+  // Сливает детей s и s + 1 вместе с разделяющим их ключом
+  void mergeChildren(InternalNode* parent, size_type s) {
+    Node* left = parent->children[s];
+    Node* right = parent->children[s + 1];
+    size_type base = left->count + 1;
+    moveKey(&left->key(left->count), &parent->key(s));
+    for (size_type j = 0; j < right->count; ++j) {
+      moveKey(&left->key(base + j), &right->key(j));
+    }
+    if (!left->leaf) {
+      for (size_type j = 0; j <= right->count; ++j) {
+        setChild(asInternal(left), base + j, asInternal(right)->children[j]);
+      }
+    }
+    left->count = static_cast<std::uint16_t>(base + right->count);
+    left->size += 1 + right->size;
+    right->count = 0;
+    deallocateNode(right);
+
+    closeSlot(parent, s);
+    for (size_type j = s + 1; j <= parent->count; ++j) {
+      setChild(parent, j, parent->children[j + 1]);
+    }
+  }
+
+ public:
+  // Вставка
+  std::pair<const_iterator<InOrder>, bool> insert(const value_type& value) {
+    return insertValue(value);
+  }
+
+  std::pair<const_iterator<InOrder>, bool> insert(value_type&& value) {
+    return insertValue(std::move(value));
+  }
+
+  template<typename... Args>
+  std::pair<const_iterator<InOrder>, bool> emplace(Args&&... args) {
+    return insertValue(value_type(std::forward<Args>(args)...));
+  }
+
+  const_iterator<InOrder> insert(const_iterator<InOrder> hint, const value_type& value) {
+    return insertValue(hint, value);
+  }
+
+  const_iterator<InOrder> insert(const_iterator<InOrder> hint, value_type&& value) {
+    return insertValue(hint, std::move(value));
+  }
+
+  template<typename... Args>
+  const_iterator<InOrder> emplace_hint(const_iterator<InOrder> hint, Args&&... args) {
+    return insertValue(hint, value_type(std::forward<Args>(args)...));
+  }
+
+  // Поиск
+  const_iterator<InOrder> find(const value_type& value) const {
+    return findPosition(value);
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> find(const K& key) const {
+    return findPosition(key);
+  }
+
+  bool exist(const value_type& value) const {
+    return findPosition(value).node != nullptr;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  bool exist(const K& key) const {
+    return findPosition(key).node != nullptr;
+  }
+
+  const_iterator<InOrder> findMin() {
+    return begin<InOrder>();
+  }
+
+  const_iterator<InOrder> findMax() {
+    return rbegin<InOrder>();
+  }
+
+  // Удаление
+  size_type erase(const value_type& value) {
+    return erasePosition(findPosition(value));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  size_type erase(const K& key) {
+    return erasePosition(findPosition(key));
+  }
+
+  size_type erasePosition(const_iterator<InOrder> position) {
+    if (position.node == nullptr) {
+      return 0;
+    }
+    eraseAt(const_cast<Node*>(position.node), position.index);
+    return 1;
+  }
+
+  // Переносит в дерево элементы source, которых в нем еще нет; совпадающие остаются в source
+  void merge(BTree& source) {
+    if (&source == this || source.root == nullptr) {
+      return;
+    }
+    BTree rest(source.comp_, source.alloc_);
+    // Значения копируются: insert и append могут бросить, и тогда source остается
+    // нетронутым, а в этом дереве остаются только уже вставленные копии
+    for (auto it = source.begin<InOrder>(); it != source.end<InOrder>(); ++it) {
+      if (contains(*it)) {
+        rest.append(*it);
+      } else {
+        insert(*it);
+      }
+    }
+    source.swap(rest);
+  }
+
+  size_type count(const value_type& value) const {
+    return exist(value) ? 1 : 0;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  size_type count(const K& key) const {
+    return exist(key) ? 1 : 0;
+  }
+
+  bool contains(const value_type& value) const {
+    return exist(value);
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  bool contains(const K& key) const {
+    return exist(key);
+  }
+
+  const_iterator<InOrder> lower_bound(const value_type& value) const {
+    return lowerBoundPosition(value);
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> lower_bound(const K& key) const {
+    return lowerBoundPosition(key);
+  }
+
+  const_iterator<InOrder> upper_bound(const value_type& value) const {
+    return upperBoundPosition(value);
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> upper_bound(const K& key) const {
+    return upperBoundPosition(key);
+  }
+
+  std::pair<const_iterator<InOrder>, const_iterator<InOrder>> equal_range(const value_type& value) const {
+
+    return std::make_pair(lower_bound(value), upper_bound(value));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  std::pair<const_iterator<InOrder>, const_iterator<InOrder>> equal_range(const K& key) const {
+
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  // Методы контейнера
+  template<typename Order>
+  const_iterator<Order> begin() const {
+    if (root == nullptr) {
+      return end<Order>();
+    }
+    if constexpr (std::is_same_v<Order, PreOrder>) {
+      return const_iterator<Order>(root, 0, root); // В PreOrder обход начинается с корня
+    } else {
+      // InOrder и PostOrder начинаются с первого ключа самого левого листа
+      return const_iterator<Order>(const_iterator<Order>::leftmostLeaf(root), 0, root);
+    }
+  }
+
+  template<typename Order>
+  const_iterator<Order> end() const {
+
+    return const_iterator<Order>(nullptr, 0, root);
+  }
+
+  template<typename Order>
+  const_iterator<Order> cbegin() const {
+
+    return begin<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> cend() const {
+
+    return end<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> rbegin() const {
+    if (root == nullptr) {
+      return rend<Order>();
+    }
+    if constexpr (std::is_same_v<Order, PostOrder>) {
+      return const_iterator<Order>(root, root->count - 1, root); // В PostOrder последним идет корень
+    } else {
+      // InOrder и PreOrder заканчиваются последним ключом самого правого листа
+      const Node* leaf = const_iterator<Order>::rightmostLeaf(root);
+      return const_iterator<Order>(leaf, leaf->count - 1, root);
+    }
+  }
+
+  template<typename Order>
+  const_iterator<Order> rend() const {
+
+    return const_iterator<Order>(nullptr, 0, root);
+  }
+
+  template<typename Order>
+  const_iterator<Order> crbegin() const {
+
+    return rbegin<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> crend() const {
+
+    return rend<Order>();
+  }
+
+  bool empty() const noexcept {
+    return root == nullptr;
+  }
+
+  size_type size() const noexcept {
+    return root != nullptr ? root->size : 0;
+  }
+
+  // Количество элементов, строго меньших value
+  size_type rank(const value_type& value) const {
+    size_type result = 0;
+    const Node* node = root;
+    while (node != nullptr) {
+      size_type i = lowerIndex(node, value);
+      result += i; // Ключи узла левее позиции i и поддеревья между ними меньше value
+      if (node->leaf) {
+        break;
+      }
+      for (size_type j = 0; j < i; ++j) {
+        result += asInternal(node)->children[j]->size;
+      }
+      node = asInternal(node)->children[i];
+    }
+
+    return result;
+  }
+
+  // k-й по возрастанию элемент (с нуля) или end, если k >= size()
+  const_iterator<InOrder> select(size_type k) const {
+    const Node* node = root;
+    while (node != nullptr) {
+      if (node->leaf) {
+        return k < node->count ? const_iterator<InOrder>(node, k, root) : end<InOrder>();
+      }
+      const Node* next = nullptr;
+      for (size_type i = 0; i <= node->count && next == nullptr; ++i) {
+        const Node* child = asInternal(node)->children[i];
+        if (k < child->size) {
+          next = child;
+        } else if (k == child->size && i < node->count) {
+          return const_iterator<InOrder>(node, i, root);
+        } else {
+          k -= child->size + 1;
+        }
+      }
+      node = next;
+    }
+
+    return end<InOrder>();
+  }
+
+  const_iterator<InOrder> nth(size_type k) const {
+
+    return select(k);
+  }
+
+  // Количество элементов в полуинтервале [lo, hi)
+  size_type count_range(const value_type& lo, const value_type& hi) const {
+    if (!comp_(lo, hi)) {
+      return 0;
+    }
+
+    return rank(hi) - rank(lo);
+  }
+
+  size_type max_size() const noexcept {
+
+    return ValueTraits::max_size(alloc_);
+  }
+
+  key_compare key_comp() const {
+
+    return comp_;
+  }
+
+  value_compare value_comp() const {
+
+    return comp_;
+  }
+
+  allocator_type get_allocator() const noexcept {
+
+    return alloc_;
+  }
+
+  // Неизменяемый снимок текущего содержимого с кэш-дружественным поиском, O(n)
+  FrozenTree<T, Compare, Alloc> freeze() const {
+
+    return FrozenTree<T, Compare, Alloc>(begin<InOrder>(), end<InOrder>(), size(), comp_, alloc_);
+  }
+
+  // Максимальное число ключей в листе
+  static constexpr size_type node_capacity() noexcept {
+    return kMaxLeafKeys;
+  }
+
+  // Максимальное число ключей во внутреннем узле; их меньше, чем в листе, из-за указателей на детей
+  static constexpr size_type internal_node_capacity() noexcept {
+    return kMaxInternalKeys;
+  }
+
+  // Размеры узлов в байтах; оба не больше NodeBytes, если в узел помещаются хотя бы три ключа
+  static constexpr size_type leaf_node_bytes() noexcept {
+    return sizeof(LeafNode);
+  }
+
+  static constexpr size_type internal_node_bytes() noexcept {
+    return sizeof(InternalNode);
+  }
+};
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Страничный кэш файла с вытеснением давно не использованных страниц (LRU).
+// Файл делится на страницы по kPageSize байт; в памяти держится не больше frames страниц.
+// Страница, к которой обращаются через PageRef, закреплена и не вытесняется, пока PageRef жив.
+// Измененные страницы записываются в файл при вытеснении и в flush, который также
+// сбрасывает файл на диск (fsync). Ошибки ввода-вывода - std::system_error.
+// Пул не потокобезопасен.
+class BufferPool {
+ public:
+  static constexpr std::size_t kPageSize = 4096;
+
+ private:
+  static constexpr std::uint32_t kNoFrame = ~std::uint32_t(0);
+
+  struct Frame {
+    std::uint64_t page = 0;
+    std::uint32_t pins = 0;
+    bool dirty = false;
+    bool used = false;
+    std::uint32_t prev = kNoFrame; // Соседи по списку LRU, в начале - самые свежие
+    std::uint32_t next = kNoFrame;
+  };
+
+ public:
+  // Закрепленная страница пула
+  class PageRef {
+   public:
+    PageRef() = default;
+
+    PageRef(const PageRef&) = delete;
+    PageRef& operator=(const PageRef&) = delete;
+
+    PageRef(PageRef&& other) noexcept : pool_(other.pool_), frame_(other.frame_) {
+      other.pool_ = nullptr;
+    }
+
+    PageRef& operator=(PageRef&& other) noexcept {
+      if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        frame_ = other.frame_;
+        other.pool_ = nullptr;
+      }
+      return *this;
+    }
+
+    ~PageRef() {
+      release();
+    }
+
+    std::uint64_t page() const noexcept {
+      return pool_->frames_[frame_].page;
+    }
+
+    const unsigned char* data() const noexcept {
+      return pool_->frameData(frame_);
+    }
+
+    // Доступ на запись помечает страницу измененной
+    unsigned char* mutable_data() noexcept {
+      pool_->frames_[frame_].dirty = true;
+      return pool_->frameData(frame_);
+    }
+
+   private:
+    friend class BufferPool;
+
+    PageRef(BufferPool* pool, std::uint32_t frame) noexcept : pool_(pool), frame_(frame) {}
+
+    void release() noexcept {
+      if (pool_ != nullptr) {
+        --pool_->frames_[frame_].pins;
+        pool_ = nullptr;
+      }
+    }
+
+    BufferPool* pool_ = nullptr;
+    std::uint32_t frame_ = 0;
+  };
+
+  // Открывает файл path (создает, если его нет) с бюджетом памяти frames страниц
+  BufferPool(const char* path, std::size_t frames) : frame_count_(frames) {
+    if (frames == 0 || frames >= kNoFrame / 2) {
+      throw std::invalid_argument("BufferPool: bad frame count");
+    }
+    fd_ = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      throw std::system_error(errno, std::generic_category(), "BufferPool: open");
+    }
+    struct stat info;
+    if (::fstat(fd_, &info) != 0) {
+      int error = errno;
+      ::close(fd_);
+      throw std::system_error(error, std::generic_category(), "BufferPool: fstat");
+    }
+    opened_bytes_ = static_cast<std::uint64_t>(info.st_size);
+    file_pages_ = opened_bytes_ / kPageSize;
+    table_size_ = 1;
+    while (table_size_ < 2 * frames) {
+      table_size_ *= 2;
+    }
+    try {
+      frames_.reset(new Frame[frames]);
+      data_.reset(new unsigned char[frames * kPageSize]);
+      table_.reset(new std::uint32_t[table_size_]);
+    } catch (...) {
+      ::close(fd_);
+      throw;
+    }
+    for (std::size_t i = 0; i < table_size_; ++i) {
+      table_[i] = kNoFrame;
+    }
+  }
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // Несохраненные изменения теряются: долговечность обеспечивает только flush
+  ~BufferPool() {
+    ::close(fd_);
+  }
+
+  // Количество страниц в файле с учетом созданных, но еще не записанных
+  std::uint64_t page_count() const noexcept {
+    return file_pages_;
+  }
+
+  // Длина файла в байтах при открытии; неполная последняя страница в page_count не входит
+  std::uint64_t opened_bytes() const noexcept {
+    return opened_bytes_;
+  }
+
+  std::size_t frame_count() const noexcept {
+    return frame_count_;
+  }
+
+  // Страницы, прочитанные из файла и записанные в файл; для оценки работы кэша
+  std::uint64_t reads() const noexcept {
+    return reads_;
+  }
+
+  std::uint64_t writes() const noexcept {
+    return writes_;
+  }
+
+  // Закрепляет существующую страницу, при необходимости читая ее из файла
+  PageRef fetch(std::uint64_t page) {
+    std::uint32_t frame = lookup(page);
+    if (frame == kNoFrame) {
+      frame = takeFrame();
+      try {
+        readPage(page, frameData(frame));
+      } catch (...) {
+        frames_[frame].next = free_frames_; // Кадр возвращается в запас и не теряется
+        free_frames_ = frame;
+        throw;
+      }
+      bind(frame, page);
+    } else {
+      unlinkLru(frame);
+      pushLru(frame);
+    }
+    ++frames_[frame].pins;
+    return PageRef(this, frame);
+  }
+
+  // Закрепляет новую страницу, заполненную нулями, без чтения из файла. Страница page
+  // не должна быть в пуле; если она за концом файла, файл считается удлиненным до нее.
+  PageRef create(std::uint64_t page) {
+    std::uint32_t frame = lookup(page);
+    if (frame == kNoFrame) {
+      frame = takeFrame();
+      bind(frame, page);
+    } else {
+      unlinkLru(frame);
+      pushLru(frame);
+    }
+    std::memset(frameData(frame), 0, kPageSize);
+    frames_[frame].dirty = true;
+    if (page >= file_pages_) {
+      file_pages_ = page + 1;
+    }
+    ++frames_[frame].pins;
+    return PageRef(this, frame);
+  }
+
+  // Записывает все измененные страницы и дожидается их попадания на диск
+  void flush() {
+    for (std::uint32_t frame = 0; frame < frame_count_; ++frame) {
+      if (frames_[frame].used && frames_[frame].dirty) {
+        writeBack(frame);
+      }
+    }
+    if (::fsync(fd_) != 0) {
+      throw std::system_error(errno, std::generic_category(), "BufferPool: fsync");
+    }
+  }
+
+ private:
+  unsigned char* frameData(std::uint32_t frame) const noexcept {
+    return data_.get() + std::size_t(frame) * kPageSize;
+  }
+
+  std::size_t slotOf(std::uint64_t page) const noexcept {
+    // Перемешивание Фибоначчи: соседние номера страниц расходятся по таблице
+    return static_cast<std::size_t>((page * 0x9E3779B97F4A7C15ull) >> 32) & (table_size_ - 1);
+  }
+
+  std::uint32_t lookup(std::uint64_t page) const noexcept {
+    for (std::size_t slot = slotOf(page);; slot = (slot + 1) & (table_size_ - 1)) {
+      std::uint32_t frame = table_[slot];
+      if (frame == kNoFrame || frames_[frame].page == page) {
+        return frame;
+      }
+    }
+  }
+
+  void bind(std::uint32_t frame, std::uint64_t page) noexcept {
+    frames_[frame].page = page;
+    frames_[frame].used = true;
+    frames_[frame].dirty = false;
+    std::size_t slot = slotOf(page);
+    while (table_[slot] != kNoFrame) {
+      slot = (slot + 1) & (table_size_ - 1);
+    }
+    table_[slot] = frame;
+    pushLru(frame);
+  }
+
+  // Удаление из таблицы с линейным пробированием: последующие записи цепочки сдвигаются
+  // на освободившееся место, если оно лежит между их исходной ячейкой и текущей
+  void unbind(std::uint32_t frame) noexcept {
+    std::size_t mask = table_size_ - 1;
+    std::size_t hole = slotOf(frames_[frame].page);
+    while (table_[hole] != frame) {
+      hole = (hole + 1) & mask;
+    }
+    for (std::size_t slot = (hole + 1) & mask; table_[slot] != kNoFrame; slot = (slot + 1) & mask) {
+      std::size_t home = slotOf(frames_[table_[slot]].page);
+      if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+        table_[hole] = table_[slot];
+        hole = slot;
+      }
+    }
+    table_[hole] = kNoFrame;
+    unlinkLru(frame);
+    frames_[frame].used = false;
+  }
+
+  void pushLru(std::uint32_t frame) noexcept {
+    frames_[frame].prev = kNoFrame;
+    frames_[frame].next = lru_head_;
+    if (lru_head_ != kNoFrame) {
+      frames_[lru_head_].prev = frame;
+    } else {
+      lru_tail_ = frame;
+    }
+    lru_head_ = frame;
+  }
+
+  void unlinkLru(std::uint32_t frame) noexcept {
+    Frame& f = frames_[frame];
+    (f.prev != kNoFrame ? frames_[f.prev].next : lru_head_) = f.next;
+    (f.next != kNoFrame ? frames_[f.next].prev : lru_tail_) = f.prev;
+    f.prev = f.next = kNoFrame;
+  }
+
+  // Свободный кадр или вытесненный с конца LRU незакрепленный
+  std::uint32_t takeFrame() {
+    if (free_frames_ != kNoFrame) {
+      std::uint32_t frame = free_frames_;
+      free_frames_ = frames_[frame].next;
+      frames_[frame].next = kNoFrame;
+      return frame;
+    }
+    if (unused_ < frame_count_) {
+      return static_cast<std::uint32_t>(unused_++);
+    }
+    for (std::uint32_t frame = lru_tail_; frame != kNoFrame; frame = frames_[frame].prev) {
+      if (frames_[frame].pins == 0) {
+        if (frames_[frame].dirty) {
+          writeBack(frame);
+        }
+        unbind(frame);
+        return frame;
+      }
+    }
+    throw std::runtime_error("BufferPool: all frames are pinned");
+  }
+
+  void readPage(std::uint64_t page, unsigned char* buffer) {
+    std::size_t done = 0;
+    while (done < kPageSize) {
+      ssize_t bytes = ::pread(fd_, buffer + done, kPageSize - done, static_cast<off_t>(page * kPageSize + done));
+      if (bytes < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytes < 0) {
+        throw std::system_error(errno, std::generic_category(), "BufferPool: pread");
+      }
+      if (bytes == 0) {
+        std::memset(buffer + done, 0, kPageSize - done); // Страница за концом файла читается нулями
+        break;
+      }
+      done += static_cast<std::size_t>(bytes);
+    }
+    ++reads_;
+  }
+
+  void writeBack(std::uint32_t frame) {
+    const unsigned char* buffer = frameData(frame);
+    std::uint64_t page = frames_[frame].page;
+    std::size_t done = 0;
+    while (done < kPageSize) {
+      ssize_t bytes = ::pwrite(fd_, buffer + done, kPageSize - done, static_cast<off_t>(page * kPageSize + done));
+      if (bytes < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytes < 0) {
+        throw std::system_error(errno, std::generic_category(), "BufferPool: pwrite");
+      }
+      done += static_cast<std::size_t>(bytes);
+    }
+    frames_[frame].dirty = false;
+    ++writes_;
+  }
+
+  int fd_ = -1;
+  const std::size_t frame_count_;
+  std::size_t unused_ = 0; // Кадры с этим индексом и дальше еще ни разу не использовались
+  std::size_t table_size_ = 0;
+  std::unique_ptr<Frame[]> frames_;
+  std::unique_ptr<unsigned char[]> data_;
+  std::unique_ptr<std::uint32_t[]> table_; // Номер страницы -> кадр, открытая адресация
+  std::uint32_t free_frames_ = kNoFrame; // Стек кадров, освободившихся после ошибки чтения
+  std::uint32_t lru_head_ = kNoFrame;
+  std::uint32_t lru_tail_ = kNoFrame;
+  std::uint64_t opened_bytes_ = 0;
+  std::uint64_t file_pages_ = 0;
+  std::uint64_t reads_ = 0;
+  std::uint64_t writes_ = 0;
+};
@@ -0,0 +1,933 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "bst.h"
+
+// Красно-черное множество с компактным хранением: узлы лежат в одном непрерывном массиве
+// и ссылаются друг на друга 32-битными индексами. Цвет хранится в старшем бите индекса
+// родителя, поэтому служебная часть узла - 16 байт (три ссылки и размер поддерева) вместо
+// 48 у BinarySearchTree на 64-битной платформе. Ячейка 0 - сторожевой черный nil размера 0.
+// Освободившиеся ячейки уходят в список свободных и переиспользуются.
+// Итераторы хранят адрес дерева и индекс, поэтому остаются действительными при росте массива;
+// недействительным становится итератор на удаленный элемент, а в отличие от std::set - и все
+// итераторы дерева после его перемещения или обмена (swap), так как они ссылаются на объект
+// дерева, а не на ячейки. Перемещенное дерево пусто и пригодно для работы.
+// Не больше 2^31 - 2 элементов.
+template<typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class CompactTree {
+ public:
+  using value_type = T;
+  using allocator_type = Alloc;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using pointer = typename std::allocator_traits<allocator_type>::pointer;
+  using const_pointer = typename std::allocator_traits<allocator_type>::const_pointer;
+  using key_type = T;
+  using key_compare = Compare;
+  using value_compare = Compare;
+
+ private:
+  using Index = std::uint32_t;
+
+  static constexpr Index kNil = 0;
+  static constexpr Index kRedBit = Index(1) << 31;
+  static constexpr Index kIndexMask = kRedBit - 1;
+
+  // Значение существует только у занятых ячеек (size != 0); у свободных left - следующая свободная
+  struct Slot {
+    union {
+      value_type value;
+    };
+    Index left = kNil;
+    Index right = kNil;
+    Index parent_color = kNil; // Индекс родителя, старший бит - красный цвет
+    Index size = 0;            // Размер поддерева; 0 у nil и свободных ячеек
+
+    Slot() noexcept {}
+    ~Slot() {}
+  };
+
+  using SlotAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+  using SlotTraits = std::allocator_traits<SlotAllocator>;
+  using ValueTraits = std::allocator_traits<Alloc>;
+
+ public:
+  template<typename Order>
+  class const_iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = const T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator() = default;
+
+    const_iterator& operator++() {
+      increment(Order());
+      return *this;
+    }
+
+    const_iterator& operator--() {
+      decrement(Order());
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator result = *this;
+      --*this;
+      return result;
+    }
+
+    reference operator*() const {
+      return tree_->slots_[index_].value;
+    }
+
+    pointer operator->() const {
+      return &tree_->slots_[index_].value;
+    }
+
+    // Концы разных деревьев различаются: сравнивается и дерево, и индекс
+    bool operator==(const const_iterator& other) const {
+      return tree_ == other.tree_ && index_ == other.index_;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class CompactTree;
+
+    const_iterator(const CompactTree* tree, Index index) : tree_(tree), index_(index) {}
+
+    void increment(InOrder) {
+      if (index_ == kNil) {
+        return;
+      }
+      if (tree_->right(index_) != kNil) {
+        index_ = tree_->leftmost(tree_->right(index_));
+        return;
+      }
+      Index parent = tree_->parent(index_);
+      while (parent != kNil && index_ == tree_->right(parent)) {
+        index_ = parent;
+        parent = tree_->parent(parent);
+      }
+      index_ = parent;
+    }
+
+    void decrement(InOrder) {
+      if (index_ == kNil) {
+        index_ = tree_->rightmost(tree_->root_);
+        return;
+      }
+      if (tree_->left(index_) != kNil) {
+        index_ = tree_->rightmost(tree_->left(index_));
+        return;
+      }
+      Index parent = tree_->parent(index_);
+      while (parent != kNil && index_ == tree_->left(parent)) {
+        index_ = parent;
+        parent = tree_->parent(parent);
+      }
+      index_ = parent;
+    }
+
+    void increment(PreOrder) {
+      if (index_ == kNil) {
+        return;
+      }
+      if (tree_->left(index_) != kNil) {
+        index_ = tree_->left(index_);
+        return;
+      }
+      if (tree_->right(index_) != kNil) {
+        index_ = tree_->right(index_);
+        return;
+      }
+      // Ближайший предок, в левом поддереве которого мы были и у которого есть правое
+      Index parent = tree_->parent(index_);
+      while (parent != kNil && (index_ == tree_->right(parent) || tree_->right(parent) == kNil)) {
+        index_ = parent;
+        parent = tree_->parent(parent);
+      }
+      index_ = parent != kNil ? tree_->right(parent) : kNil;
+    }
+
+    void decrement(PreOrder) {
+      if (index_ == kNil) {
+        index_ = tree_->lastPreOrder(tree_->root_);
+        return;
+      }
+      Index parent = tree_->parent(index_);
+      if (parent != kNil && index_ == tree_->right(parent) && tree_->left(parent) != kNil) {
+        index_ = tree_->lastPreOrder(tree_->left(parent));
+      } else {
+        index_ = parent;
+      }
+    }
+
+    void increment(PostOrder) {
+      if (index_ == kNil) {
+        return;
+      }
+      Index parent = tree_->parent(index_);
+      if (parent != kNil && index_ == tree_->left(parent) && tree_->right(parent) != kNil) {
+        index_ = tree_->firstPostOrder(tree_->right(parent));
+      } else {
+        index_ = parent;
+      }
+    }
+
+    void decrement(PostOrder) {
+      if (index_ == kNil) {
+        index_ = tree_->root_;
+        return;
+      }
+      if (tree_->right(index_) != kNil) {
+        index_ = tree_->right(index_);
+        return;
+      }
+      if (tree_->left(index_) != kNil) {
+        index_ = tree_->left(index_);
+        return;
+      }
+      Index parent = tree_->parent(index_);
+      while (parent != kNil && (index_ == tree_->left(parent) || tree_->left(parent) == kNil)) {
+        index_ = parent;
+        parent = tree_->parent(parent);
+      }
+      index_ = parent != kNil ? tree_->left(parent) : kNil;
+    }
+
+    const CompactTree* tree_ = nullptr;
+    Index index_ = kNil;
+  };
+
+  // Конструкторы и деструктор
+  CompactTree() : CompactTree(Compare()) {}
+
+  explicit CompactTree(const allocator_type& alloc) : CompactTree(Compare(), alloc) {}
+
+  explicit CompactTree(const Compare& comp, const allocator_type& alloc = allocator_type())
+      : alloc_(alloc), comp_(comp) {
+    grow(1); // Только nil
+  }
+
+  // Копия повторяет массив ячеек как есть, индексы совпадают с оригиналом
+  CompactTree(const CompactTree& other)
+      : alloc_(ValueTraits::select_on_container_copy_construction(other.alloc_)), comp_(other.comp_) {
+    grow(std::max<Index>(other.capacity_, 1));
+    try {
+      for (Index i = 1; i < other.capacity_; ++i) {
+        if (other.slots_[i].size != 0) {
+          ValueTraits::construct(alloc_, std::addressof(slots_[i].value), other.slots_[i].value);
+        }
+        slots_[i].size = other.slots_[i].size;
+        slots_[i].left = other.slots_[i].left;
+        slots_[i].right = other.slots_[i].right;
+        slots_[i].parent_color = other.slots_[i].parent_color;
+      }
+    } catch (...) {
+      destroyAll();
+      throw;
+    }
+    free_ = other.free_;
+    root_ = other.root_;
+  }
+
+  CompactTree(CompactTree&& other) noexcept
+      : alloc_(std::move(other.alloc_)), comp_(other.comp_), slots_(other.slots_), capacity_(other.capacity_),
+        free_(other.free_), root_(other.root_) {
+    other.slots_ = nullptr;
+    other.capacity_ = 0;
+    other.free_ = kNil;
+    other.root_ = kNil;
+  }
+
+  CompactTree& operator=(CompactTree other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~CompactTree() {
+    destroyAll();
+  }
+
+  void swap(CompactTree& other) noexcept {
+    using std::swap;
+    swap(alloc_, other.alloc_);
+    swap(comp_, other.comp_);
+    swap(slots_, other.slots_);
+    swap(capacity_, other.capacity_);
+    swap(free_, other.free_);
+    swap(root_, other.root_);
+  }
+
+  // Заранее выделяет место под count элементов одним блоком
+  void reserve(size_type count) {
+    if (count + 1 > capacity_) {
+      grow(count + 1);
+    }
+  }
+
+  void clear() noexcept {
+    if (slots_ == nullptr) {
+      return;
+    }
+    for (Index i = 1; i < capacity_; ++i) {
+      if (slots_[i].size != 0) {
+        ValueTraits::destroy(alloc_, std::addressof(slots_[i].value));
+      }
+    }
+    // Все ячейки, кроме nil, снова свободны
+    free_ = kNil;
+    for (Index i = capacity_; i-- > 1;) {
+      slots_[i].size = 0;
+      slots_[i].left = free_;
+      free_ = i;
+    }
+    root_ = kNil;
+  }
+
+  // Вставка
+  std::pair<const_iterator<InOrder>, bool> insert(const value_type& value) {
+    return insertValue(value);
+  }
+
+  std::pair<const_iterator<InOrder>, bool> insert(value_type&& value) {
+    return insertValue(std::move(value));
+  }
+
+  template<typename... Args>
+  std::pair<const_iterator<InOrder>, bool> emplace(Args&&... args) {
+    return insertValue(value_type(std::forward<Args>(args)...));
+  }
+
+  // Удаление
+  size_type erase(const value_type& value) {
+    Index node = findIndex(value);
+    if (node == kNil) {
+      return 0;
+    }
+    eraseIndex(node);
+    return 1;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  size_type erase(const K& key) {
+    Index node = findIndex(key);
+    if (node == kNil) {
+      return 0;
+    }
+    eraseIndex(node);
+    return 1;
+  }
+
+  const_iterator<InOrder> erase(const_iterator<InOrder> position) {
+    const_iterator<InOrder> next = position;
+    ++next;
+    eraseIndex(position.index_);
+    return next; // Индекс следующего элемента при удалении не меняется
+  }
+
+  // Поиск
+  const_iterator<InOrder> find(const value_type& value) const {
+    return const_iterator<InOrder>(this, findIndex(value));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> find(const K& key) const {
+    return const_iterator<InOrder>(this, findIndex(key));
+  }
+
+  bool contains(const value_type& value) const {
+    return findIndex(value) != kNil;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  bool contains(const K& key) const {
+    return findIndex(key) != kNil;
+  }
+
+  size_type count(const value_type& value) const {
+    return contains(value) ? 1 : 0;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  size_type count(const K& key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  const_iterator<InOrder> lower_bound(const value_type& value) const {
+    return const_iterator<InOrder>(this, lowerBoundIndex(value));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> lower_bound(const K& key) const {
+    return const_iterator<InOrder>(this, lowerBoundIndex(key));
+  }
+
+  const_iterator<InOrder> upper_bound(const value_type& value) const {
+    return const_iterator<InOrder>(this, upperBoundIndex(value));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> upper_bound(const K& key) const {
+    return const_iterator<InOrder>(this, upperBoundIndex(key));
+  }
+
+  std::pair<const_iterator<InOrder>, const_iterator<InOrder>> equal_range(const value_type& value) const {
+
+    return std::make_pair(lower_bound(value), upper_bound(value));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  std::pair<const_iterator<InOrder>, const_iterator<InOrder>> equal_range(const K& key) const {
+
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  // Методы контейнера
+  template<typename Order>
+  const_iterator<Order> begin() const {
+    if constexpr (std::is_same_v<Order, InOrder>) {
+      return const_iterator<Order>(this, leftmost(root_));
+    } else if constexpr (std::is_same_v<Order, PreOrder>) {
+      return const_iterator<Order>(this, root_);
+    } else {
+      return const_iterator<Order>(this, firstPostOrder(root_));
+    }
+  }
+
+  template<typename Order>
+  const_iterator<Order> end() const {
+
+    return const_iterator<Order>(this, kNil);
+  }
+
+  template<typename Order>
+  const_iterator<Order> cbegin() const {
+
+    return begin<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> cend() const {
+
+    return end<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> rbegin() const {
+    const_iterator<Order> it = end<Order>();
+    --it;
+
+    return it;
+  }
+
+  template<typename Order>
+  const_iterator<Order> rend() const {
+
+    return end<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> crbegin() const {
+
+    return rbegin<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> crend() const {
+
+    return rend<Order>();
+  }
+
+  bool empty() const noexcept {
+    return root_ == kNil;
+  }
+
+  size_type size() const noexcept {
+    return root_ != kNil ? slots_[root_].size : 0;
+  }
+
+  // Количество элементов, строго меньших value
+  size_type rank(const value_type& value) const {
+    size_type result = 0;
+    Index node = root_;
+    while (node != kNil) {
+      if (comp_(slots_[node].value, value)) {
+        result += slots_[left(node)].size + 1;
+        node = right(node);
+      } else {
+        node = left(node);
+      }
+    }
+
+    return result;
+  }
+
+  // k-й по возрастанию элемент (с нуля) или end, если k >= size()
+  const_iterator<InOrder> select(size_type k) const {
+    Index node = root_;
+    while (node != kNil) {
+      size_type left_size = slots_[left(node)].size;
+      if (k < left_size) {
+        node = left(node);
+      } else if (k == left_size) {
+        break;
+      } else {
+        k -= left_size + 1;
+        node = right(node);
+      }
+    }
+
+    return const_iterator<InOrder>(this, node);
+  }
+
+  size_type max_size() const noexcept {
+
+    return std::min<size_type>(kIndexMask - 1, SlotTraits::max_size(SlotAllocator(alloc_)) - 1);
+  }
+
+  // Байт на элемент при полном заполнении массива
+  static constexpr size_type node_bytes() noexcept {
+
+    return sizeof(Slot);
+  }
+
+  key_compare key_comp() const {
+
+    return comp_;
+  }
+
+  value_compare value_comp() const {
+
+    return comp_;
+  }
+
+  allocator_type get_allocator() const noexcept {
+
+    return alloc_;
+  }
+
+ private:
+  Index left(Index node) const noexcept {
+    return slots_[node].left;
+  }
+
+  Index right(Index node) const noexcept {
+    return slots_[node].right;
+  }
+
+  Index parent(Index node) const noexcept {
+    return slots_[node].parent_color & kIndexMask;
+  }
+
+  void setParent(Index node, Index parent) noexcept {
+    slots_[node].parent_color = (slots_[node].parent_color & kRedBit) | parent;
+  }
+
+  bool isRed(Index node) const noexcept {
+    return (slots_[node].parent_color & kRedBit) != 0;
+  }
+
+  void setRed(Index node, bool red) noexcept {
+    slots_[node].parent_color = red ? slots_[node].parent_color | kRedBit : slots_[node].parent_color & kIndexMask;
+  }
+
+  void pull(Index node) noexcept {
+    slots_[node].size = slots_[left(node)].size + slots_[right(node)].size + 1;
+  }
+
+  Index leftmost(Index node) const noexcept {
+    while (node != kNil && left(node) != kNil) {
+      node = left(node);
+    }
+    return node;
+  }
+
+  Index rightmost(Index node) const noexcept {
+    while (node != kNil && right(node) != kNil) {
+      node = right(node);
+    }
+    return node;
+  }
+
+  // Первый узел поддерева в PostOrder: влево, если можно, иначе вправо
+  Index firstPostOrder(Index node) const noexcept {
+    while (node != kNil && (left(node) != kNil || right(node) != kNil)) {
+      node = left(node) != kNil ? left(node) : right(node);
+    }
+    return node;
+  }
+
+  // Последний узел поддерева в PreOrder: вправо, если можно, иначе влево
+  Index lastPreOrder(Index node) const noexcept {
+    while (node != kNil && (left(node) != kNil || right(node) != kNil)) {
+      node = right(node) != kNil ? right(node) : left(node);
+    }
+    return node;
+  }
+
+  // Переносит ячейки в новый массив вместимостью не меньше required; новые ячейки свободны
+  void grow(size_type required) {
+    if (required > size_type(kIndexMask)) {
+      throw std::length_error("CompactTree: too many elements for 31-bit indices");
+    }
+    size_type capacity = std::max<size_type>(required, std::min<size_type>(kIndexMask, capacity_ * 2));
+    SlotAllocator slot_allocator(alloc_);
+    Slot* slots = SlotTraits::allocate(slot_allocator, capacity);
+    for (size_type i = 0; i < capacity; ++i) {
+      SlotTraits::construct(slot_allocator, slots + i);
+    }
+    size_type moved = 1;
+    try {
+      for (; moved < capacity_; ++moved) {
+        if (slots_[moved].size != 0) {
+          ValueTraits::construct(alloc_, std::addressof(slots[moved].value),
+                                 std::move_if_noexcept(slots_[moved].value));
+        }
+      }
+    } catch (...) {
+      for (size_type i = 1; i < moved; ++i) {
+        if (slots_[i].size != 0) {
+          ValueTraits::destroy(alloc_, std::addressof(slots[i].value));
+        }
+      }
+      SlotTraits::deallocate(slot_allocator, slots, capacity);
+      throw;
+    }
+    for (size_type i = 0; i < capacity_; ++i) {
+      slots[i].left = slots_[i].left;
+      slots[i].right = slots_[i].right;
+      slots[i].parent_color = slots_[i].parent_color;
+      slots[i].size = slots_[i].size;
+      if (i != 0 && slots_[i].size != 0) {
+        ValueTraits::destroy(alloc_, std::addressof(slots_[i].value));
+      }
+    }
+    if (slots_ != nullptr) {
+      SlotTraits::deallocate(slot_allocator, slots_, capacity_);
+    }
+    // Новые ячейки добавляются в начало списка свободных по возрастанию индекса
+    for (size_type i = capacity; i-- > capacity_;) {
+      if (i != 0) {
+        slots[i].left = free_;
+        free_ = static_cast<Index>(i);
+      }
+    }
+    slots_ = slots;
+    capacity_ = static_cast<Index>(capacity);
+  }
+
+  void destroyAll() noexcept {
+    if (slots_ == nullptr) {
+      return;
+    }
+    for (Index i = 1; i < capacity_; ++i) {
+      if (slots_[i].size != 0) {
+        ValueTraits::destroy(alloc_, std::addressof(slots_[i].value));
+      }
+    }
+    SlotAllocator slot_allocator(alloc_);
+    SlotTraits::deallocate(slot_allocator, slots_, capacity_);
+    slots_ = nullptr;
+  }
+
+  template<typename V>
+  Index allocateSlot(V&& value) {
+    if (free_ == kNil) {
+      grow(std::max<size_type>(size_type(capacity_) + 1, 2));
+    }
+    Index node = free_;
+    ValueTraits::construct(alloc_, std::addressof(slots_[node].value), std::forward<V>(value));
+    free_ = slots_[node].left;
+    slots_[node].left = slots_[node].right = kNil;
+    slots_[node].parent_color = kRedBit | kNil; // Новый узел красный
+    slots_[node].size = 1;
+    return node;
+  }
+
+  void freeSlot(Index node) noexcept {
+    ValueTraits::destroy(alloc_, std::addressof(slots_[node].value));
+    slots_[node].size = 0;
+    slots_[node].left = free_;
+    free_ = node;
+  }
+
+  template<typename K>
+  Index findIndex(const K& key) const {
+    Index node = root_;
+    while (node != kNil) {
+      if (comp_(key, slots_[node].value)) {
+        node = left(node);
+      } else if (comp_(slots_[node].value, key)) {
+        node = right(node);
+      } else {
+        return node;
+      }
+    }
+    return kNil;
+  }
+
+  template<typename K>
+  Index lowerBoundIndex(const K& key) const {
+    Index node = root_;
+    Index result = kNil;
+    while (node != kNil) {
+      if (comp_(slots_[node].value, key)) {
+        node = right(node);
+      } else {
+        result = node;
+        node = left(node);
+      }
+    }
+    return result;
+  }
+
+  template<typename K>
+  Index upperBoundIndex(const K& key) const {
+    Index node = root_;
+    Index result = kNil;
+    while (node != kNil) {
+      if (comp_(key, slots_[node].value)) {
+        result = node;
+        node = left(node);
+      } else {
+        node = right(node);
+      }
+    }
+    return result;
+  }
+
+  template<typename V>
+  std::pair<const_iterator<InOrder>, bool> insertValue(V&& value) {
+    Index parent = kNil;
+    Index node = root_;
+    bool to_left = false;
+    while (node != kNil) {
+      parent = node;
+      if (comp_(value, slots_[node].value)) {
+        to_left = true;
+        node = left(node);
+      } else if (comp_(slots_[node].value, value)) {
+        to_left = false;
+        node = right(node);
+      } else {
+        return std::make_pair(const_iterator<InOrder>(this, node), false); // Повторы не допускаются
+      }
+    }
+    // Массив может вырасти, поэтому ссылки на ячейки до этого места не сохраняются
+    node = allocateSlot(std::forward<V>(value));
+    setParent(node, parent);
+    if (parent == kNil) {
+      root_ = node;
+    } else if (to_left) {
+      slots_[parent].left = node;
+    } else {
+      slots_[parent].right = node;
+    }
+    for (Index n = parent; n != kNil; n = this->parent(n)) {
+      ++slots_[n].size;
+    }
+    insertFixup(node);
+    return std::make_pair(const_iterator<InOrder>(this, node), true);
+  }
+
+  // Повороты и исправления - как в RedBlackBalance, но по индексам и с nil-ячейкой
+  void rotateLeft(Index x) noexcept {
+    Index y = right(x);
+    slots_[x].right = left(y);
+    if (left(y) != kNil) {
+      setParent(left(y), x);
+    }
+    replaceChild(x, y);
+    slots_[y].left = x;
+    setParent(x, y);
+    slots_[y].size = slots_[x].size;
+    pull(x);
+  }
+
+  void rotateRight(Index x) noexcept {
+    Index y = left(x);
+    slots_[x].left = right(y);
+    if (right(y) != kNil) {
+      setParent(right(y), x);
+    }
+    replaceChild(x, y);
+    slots_[y].right = x;
+    setParent(x, y);
+    slots_[y].size = slots_[x].size;
+    pull(x);
+  }
+
+  // Ставит поддерево v на место u у родителя u; у nil тоже запоминается родитель
+  void replaceChild(Index u, Index v) noexcept {
+    Index p = parent(u);
+    if (p == kNil) {
+      root_ = v;
+    } else if (u == left(p)) {
+      slots_[p].left = v;
+    } else {
+      slots_[p].right = v;
+    }
+    setParent(v, p);
+  }
+
+  void insertFixup(Index node) noexcept {
+    while (node != root_ && isRed(parent(node))) {
+      Index p = parent(node);
+      Index g = parent(p);
+      bool parent_is_left = p == left(g);
+      Index uncle = parent_is_left ? right(g) : left(g);
+      if (isRed(uncle)) {
+        setRed(p, false);
+        setRed(uncle, false);
+        setRed(g, true);
+        node = g;
+        continue;
+      }
+      if (parent_is_left) {
+        if (node == right(p)) {
+          node = p;
+          rotateLeft(node);
+          p = parent(node);
+        }
+        setRed(p, false);
+        setRed(g, true);
+        rotateRight(g);
+      } else {
+        if (node == left(p)) {
+          node = p;
+          rotateRight(node);
+          p = parent(node);
+        }
+        setRed(p, false);
+        setRed(g, true);
+        rotateLeft(g);
+      }
+    }
+    setRed(root_, false);
+  }
+
+  void eraseIndex(Index z) noexcept {
+    Index y = z;
+    bool removed_red = isRed(y);
+    Index x;
+    if (left(z) == kNil) {
+      x = right(z);
+      replaceChild(z, x);
+    } else if (right(z) == kNil) {
+      x = left(z);
+      replaceChild(z, x);
+    } else {
+      y = leftmost(right(z));
+      removed_red = isRed(y);
+      x = right(y);
+      if (parent(y) == z) {
+        setParent(x, y);
+      } else {
+        replaceChild(y, x);
+        slots_[y].right = right(z);
+        setParent(right(y), y);
+      }
+      replaceChild(z, y);
+      slots_[y].left = left(z);
+      setParent(left(y), y);
+      setRed(y, isRed(z));
+    }
+    // Размеры пересчитываются от места изменения до корня, повороты далее поддерживают их сами
+    for (Index n = parent(x); n != kNil; n = parent(n)) {
+      pull(n);
+    }
+    if (!removed_red) {
+      eraseFixup(x);
+    }
+    setParent(kNil, kNil);
+    freeSlot(z);
+  }
+
+  void eraseFixup(Index x) noexcept {
+    while (x != root_ && !isRed(x)) {
+      Index p = parent(x);
+      if (x == left(p)) {
+        Index sibling = right(p);
+        if (isRed(sibling)) {
+          setRed(sibling, false);
+          setRed(p, true);
+          rotateLeft(p);
+          sibling = right(p);
+        }
+        if (!isRed(left(sibling)) && !isRed(right(sibling))) {
+          setRed(sibling, true);
+          x = p;
+        } else {
+          if (!isRed(right(sibling))) {
+            setRed(left(sibling), false);
+            setRed(sibling, true);
+            rotateRight(sibling);
+            sibling = right(p);
+          }
+          setRed(sibling, isRed(p));
+          setRed(p, false);
+          setRed(right(sibling), false);
+          rotateLeft(p);
+          x = root_;
+        }
+      } else {
+        Index sibling = left(p);
+        if (isRed(sibling)) {
+          setRed(sibling, false);
+          setRed(p, true);
+          rotateRight(p);
+          sibling = left(p);
+        }
+        if (!isRed(left(sibling)) && !isRed(right(sibling))) {
+          setRed(sibling, true);
+          x = p;
+        } else {
+          if (!isRed(left(sibling))) {
+            setRed(right(sibling), false);
+            setRed(sibling, true);
+            rotateLeft(sibling);
+            sibling = left(p);
+          }
+          setRed(sibling, isRed(p));
+          setRed(p, false);
+          setRed(left(sibling), false);
+          rotateRight(p);
+          x = root_;
+        }
+      }
+    }
+    setRed(x, false);
+  }
+
+  Alloc alloc_;
+  Compare comp_;
+  Slot* slots_ = nullptr;
+  Index capacity_ = 0;
+  Index free_ = kNil;  // Голова списка свободных ячеек
+  Index root_ = kNil;
+};
@@ -0,0 +1,526 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "epoch.h"
+
+// Множество с чтением без блокировок при одном писателе.
+// Узлы после публикации не изменяются: писатель копирует путь от корня до места изменения
+// (AVL-балансировка), собирает новую версию дерева и публикует ее одной атомарной записью
+// корня. Читатель берет корень один раз и видит согласованную версию целиком.
+// Замененные узлы освобождаются через EpochDomain, когда их уже не может читать ни один поток.
+// Писатели упорядочиваются мьютексом и читателей не блокируют.
+template<typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class ConcurrentTree {
+ public:
+  using value_type = T;
+  using allocator_type = Alloc;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using const_reference = const value_type&;
+  using key_type = T;
+  using key_compare = Compare;
+  using value_compare = Compare;
+
+ private:
+  struct Node {
+    value_type value;
+    const Node* left;
+    const Node* right;
+    int height;
+    size_type size;
+
+    template<typename V>
+    Node(V&& value, const Node* left, const Node* right)
+        : value(std::forward<V>(value)), left(left), right(right),
+          height(1 + std::max(height_of(left), height_of(right))),
+          size(1 + size_of(left) + size_of(right)) {}
+
+    static int height_of(const Node* node) noexcept {
+      return node != nullptr ? node->height : 0;
+    }
+
+    static size_type size_of(const Node* node) noexcept {
+      return node != nullptr ? node->size : 0;
+    }
+  };
+
+  using NodeAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+  using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+  // Высота AVL-дерева не больше 1.44 * log2(n + 2), для 64-битного size_type - меньше 96
+  static constexpr size_type kMaxHeight = 96;
+  // Одно изменение заменяет не больше трех узлов на уровень: путь и узлы поворотов
+  static constexpr size_type kMaxGarbage = 4 * kMaxHeight;
+
+ public:
+  // Итератор InOrder по зафиксированной версии дерева. Родительских ссылок у неизменяемых
+  // узлов нет, поэтому путь от корня хранится в самом итераторе.
+  class const_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = const T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator() = default;
+
+    const_iterator& operator++() {
+      const Node* node = stack_[--depth_]->right;
+      pushLeft(node);
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    reference operator*() const {
+      return stack_[depth_ - 1]->value;
+    }
+
+    pointer operator->() const {
+      return &stack_[depth_ - 1]->value;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return top() == other.top();
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return top() != other.top();
+    }
+
+   private:
+    friend class ConcurrentTree;
+
+    const Node* top() const noexcept {
+      return depth_ != 0 ? stack_[depth_ - 1] : nullptr;
+    }
+
+    // В стеке - узлы, у которых еще не пройдены сам узел и правое поддерево
+    void pushLeft(const Node* node) noexcept {
+      for (; node != nullptr; node = node->left) {
+        stack_[depth_++] = node;
+      }
+    }
+
+    const Node* stack_[kMaxHeight];
+    size_type depth_ = 0;
+  };
+
+  // Согласованная версия дерева для чтения. Пока объект жив, его узлы не освобождаются.
+  class snapshot_type {
+   public:
+    snapshot_type(snapshot_type&&) = default;
+
+    const_iterator begin() const {
+      const_iterator it;
+      it.pushLeft(root_);
+      return it;
+    }
+
+    const_iterator end() const {
+      return const_iterator();
+    }
+
+    template<typename K>
+    const_iterator lower_bound(const K& key) const {
+      const_iterator it;
+      const Node* node = root_;
+      while (node != nullptr) {
+        if (comp_(node->value, key)) {
+          node = node->right;
+        } else {
+          it.stack_[it.depth_++] = node; // Узел и его правое поддерево идут после ключа
+          node = node->left;
+        }
+      }
+      return it;
+    }
+
+    template<typename K>
+    const_iterator upper_bound(const K& key) const {
+      const_iterator it;
+      const Node* node = root_;
+      while (node != nullptr) {
+        if (comp_(key, node->value)) {
+          it.stack_[it.depth_++] = node;
+          node = node->left;
+        } else {
+          node = node->right;
+        }
+      }
+      return it;
+    }
+
+    template<typename K>
+    const_iterator find(const K& key) const {
+      const_iterator it = lower_bound(key);
+      if (it != end() && comp_(key, *it)) {
+        return end();
+      }
+      return it;
+    }
+
+    template<typename K>
+    bool contains(const K& key) const {
+      return find(key) != end();
+    }
+
+    size_type size() const noexcept {
+      return Node::size_of(root_);
+    }
+
+    bool empty() const noexcept {
+      return root_ == nullptr;
+    }
+
+   private:
+    friend class ConcurrentTree;
+
+    // Закрепление в эпохе предшествует чтению корня
+    explicit snapshot_type(const ConcurrentTree& tree)
+        : guard_(tree.domain_), root_(tree.root_.load(std::memory_order_acquire)), comp_(tree.comp_) {}
+
+    EpochDomain::Guard guard_;
+    const Node* root_;
+    Compare comp_;
+  };
+
+  ConcurrentTree() = default;
+
+  explicit ConcurrentTree(const Compare& comp, const allocator_type& alloc = allocator_type())
+      : node_allocator_(alloc), comp_(comp) {}
+
+  ConcurrentTree(const ConcurrentTree&) = delete;
+  ConcurrentTree& operator=(const ConcurrentTree&) = delete;
+
+  // К моменту разрушения не должно быть ни читателей, ни писателей
+  ~ConcurrentTree() {
+    clear(root_.load(std::memory_order_relaxed));
+    domain_.drain();
+  }
+
+  // Чтение без блокировок
+  snapshot_type snapshot() const {
+    return snapshot_type(*this);
+  }
+
+  template<typename K>
+  bool contains(const K& key) const {
+    EpochDomain::Guard guard(domain_);
+    return findNode(root_.load(std::memory_order_acquire), key) != nullptr;
+  }
+
+  template<typename K>
+  std::optional<value_type> find(const K& key) const {
+    EpochDomain::Guard guard(domain_);
+    const Node* node = findNode(root_.load(std::memory_order_acquire), key);
+    return node != nullptr ? std::optional<value_type>(node->value) : std::nullopt;
+  }
+
+  template<typename K>
+  std::optional<value_type> lower_bound(const K& key) const {
+    EpochDomain::Guard guard(domain_);
+    const Node* node = root_.load(std::memory_order_acquire);
+    const Node* result = nullptr;
+    while (node != nullptr) {
+      if (comp_(node->value, key)) {
+        node = node->right;
+      } else {
+        result = node;
+        node = node->left;
+      }
+    }
+    return result != nullptr ? std::optional<value_type>(result->value) : std::nullopt;
+  }
+
+  size_type size() const {
+    EpochDomain::Guard guard(domain_);
+    return Node::size_of(root_.load(std::memory_order_acquire));
+  }
+
+  bool empty() const {
+    return root_.load(std::memory_order_acquire) == nullptr;
+  }
+
+  // Изменения: писатели ждут друг друга, но не читателей
+  bool insert(const value_type& value) {
+    return insertValue(value);
+  }
+
+  bool insert(value_type&& value) {
+    return insertValue(std::move(value));
+  }
+
+  template<typename K>
+  size_type erase(const K& key) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    bool erased = false;
+    const Node* root = root_.load(std::memory_order_relaxed);
+    const Node* new_root = eraseNode(root, key, erased);
+    if (erased) {
+      publish(new_root);
+    }
+    return erased ? 1 : 0;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    const Node* root = root_.load(std::memory_order_relaxed);
+    // Узлы отдаются домену только после того, как стали недоступны новым читателям
+    EpochDomain::Reservation reservation(domain_, Node::size_of(root));
+    root_.store(nullptr, std::memory_order_release);
+    retireSubtree(root, reservation);
+  }
+
+  key_compare key_comp() const {
+    return comp_;
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return node_allocator_;
+  }
+
+ private:
+  template<typename K>
+  const Node* findNode(const Node* node, const K& key) const {
+    while (node != nullptr) {
+      if (comp_(key, node->value)) {
+        node = node->left;
+      } else if (comp_(node->value, key)) {
+        node = node->right;
+      } else {
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+  template<typename V>
+  bool insertValue(V&& value) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    bool inserted = false;
+    const Node* new_root = insertNode(root_.load(std::memory_order_relaxed), value, inserted);
+    if (inserted) {
+      publish(new_root);
+    }
+    return inserted;
+  }
+
+  // Методы писателя; вызываются под writer_mutex_
+  template<typename... Args>
+  const Node* makeNode(Args&&... args) {
+    Node* node = NodeTraits::allocate(node_allocator_, 1);
+    try {
+      NodeTraits::construct(node_allocator_, node, std::forward<Args>(args)...);
+    } catch (...) {
+      NodeTraits::deallocate(node_allocator_, node, 1);
+      throw;
+    }
+    fresh_[fresh_count_++] = node;
+    return node;
+  }
+
+  void deallocateNode(const Node* node) noexcept {
+    Node* mutable_node = const_cast<Node*>(node);
+    NodeTraits::destroy(node_allocator_, mutable_node);
+    NodeTraits::deallocate(node_allocator_, mutable_node, 1);
+  }
+
+  static void deleteNode(void* tree, void* node) {
+    static_cast<ConcurrentTree*>(tree)->deallocateNode(static_cast<const Node*>(node));
+  }
+
+  // Узел старой версии, который не войдет в новую
+  void replace(const Node* node) noexcept {
+    garbage_[garbage_count_++] = node;
+  }
+
+  // Новая версия становится видна читателям; замененные узлы уходят на отложенное освобождение.
+  // Если изменение прервано исключением, созданные для него узлы удаляются сразу. Записи для
+  // освобождения резервируются до публикации, поэтому после нее исключений уже нет.
+  void publish(const Node* new_root) {
+    std::optional<EpochDomain::Reservation> reservation;
+    try {
+      reservation.emplace(domain_, garbage_count_);
+    } catch (...) {
+      abandon();
+      throw;
+    }
+    root_.store(new_root, std::memory_order_release);
+    fresh_count_ = 0;
+    for (size_type i = 0; i < garbage_count_; ++i) {
+      reservation->retire(const_cast<Node*>(garbage_[i]), &ConcurrentTree::deleteNode, this);
+    }
+    garbage_count_ = 0;
+  }
+
+  void abandon() noexcept {
+    for (size_type i = 0; i < fresh_count_; ++i) {
+      deallocateNode(fresh_[i]);
+    }
+    fresh_count_ = 0;
+    garbage_count_ = 0;
+  }
+
+  // Копия узла с новыми потомками и восстановлением AVL-баланса
+  const Node* balance(const value_type& value, const Node* left, const Node* right) {
+    int diff = Node::height_of(left) - Node::height_of(right);
+    if (diff > 1) {
+      if (Node::height_of(left->left) >= Node::height_of(left->right)) {
+        replace(left);
+        return makeNode(left->value, left->left, makeNode(value, left->right, right));
+      }
+      const Node* pivot = left->right;
+      replace(left);
+      replace(pivot);
+      return makeNode(pivot->value, makeNode(left->value, left->left, pivot->left),
+                      makeNode(value, pivot->right, right));
+    }
+    if (diff < -1) {
+      if (Node::height_of(right->right) >= Node::height_of(right->left)) {
+        replace(right);
+        return makeNode(right->value, makeNode(value, left, right->left), right->right);
+      }
+      const Node* pivot = right->left;
+      replace(right);
+      replace(pivot);
+      return makeNode(pivot->value, makeNode(value, left, pivot->left),
+                      makeNode(right->value, pivot->right, right->right));
+    }
+    return makeNode(value, left, right);
+  }
+
+  template<typename V>
+  const Node* insertNode(const Node* root, V& value, bool& inserted) {
+    try {
+      return insertRecursive(root, value, inserted);
+    } catch (...) {
+      abandon();
+      throw;
+    }
+  }
+
+  template<typename V>
+  const Node* insertRecursive(const Node* node, V& value, bool& inserted) {
+    if (node == nullptr) {
+      inserted = true;
+      return makeNode(std::forward<V>(value), nullptr, nullptr);
+    }
+    if (comp_(value, node->value)) {
+      const Node* left = insertRecursive(node->left, value, inserted);
+      if (!inserted) {
+        return node;
+      }
+      replace(node);
+      return balance(node->value, left, node->right);
+    }
+    if (comp_(node->value, value)) {
+      const Node* right = insertRecursive(node->right, value, inserted);
+      if (!inserted) {
+        return node;
+      }
+      replace(node);
+      return balance(node->value, node->left, right);
+    }
+    return node; // Повторы не допускаются
+  }
+
+  template<typename K>
+  const Node* eraseNode(const Node* root, const K& key, bool& erased) {
+    try {
+      return eraseRecursive(root, key, erased);
+    } catch (...) {
+      abandon();
+      throw;
+    }
+  }
+
+  template<typename K>
+  const Node* eraseRecursive(const Node* node, const K& key, bool& erased) {
+    if (node == nullptr) {
+      return nullptr;
+    }
+    if (comp_(key, node->value)) {
+      const Node* left = eraseRecursive(node->left, key, erased);
+      if (!erased) {
+        return node;
+      }
+      replace(node);
+      return balance(node->value, left, node->right);
+    }
+    if (comp_(node->value, key)) {
+      const Node* right = eraseRecursive(node->right, key, erased);
+      if (!erased) {
+        return node;
+      }
+      replace(node);
+      return balance(node->value, node->left, right);
+    }
+    erased = true;
+    replace(node);
+    if (node->left == nullptr) {
+      return node->right;
+    }
+    if (node->right == nullptr) {
+      return node->left;
+    }
+    // Место узла занимает копия минимума правого поддерева
+    const Node* min = nullptr;
+    const Node* right = eraseMin(node->right, min);
+    return balance(min->value, node->left, right);
+  }
+
+  const Node* eraseMin(const Node* node, const Node*& min) {
+    replace(node);
+    if (node->left == nullptr) {
+      min = node;
+      return node->right;
+    }
+    const Node* left = eraseMin(node->left, min);
+    return balance(node->value, left, node->right);
+  }
+
+  // Все узлы поддерева уходят на отложенное освобождение
+  void retireSubtree(const Node* node, EpochDomain::Reservation& reservation) noexcept {
+    while (node != nullptr) {
+      retireSubtree(node->left, reservation);
+      const Node* right = node->right;
+      reservation.retire(const_cast<Node*>(node), &ConcurrentTree::deleteNode, this);
+      node = right;
+    }
+  }
+
+  void clear(const Node* node) noexcept {
+    while (node != nullptr) {
+      clear(node->left);
+      const Node* right = node->right;
+      deallocateNode(node);
+      node = right;
+    }
+  }
+
+  NodeAllocator node_allocator_;
+  Compare comp_;
+  std::atomic<const Node*> root_{nullptr};
+  mutable EpochDomain domain_;
+  std::mutex writer_mutex_;
+  // Узлы текущего изменения: замененные старые и созданные новые
+  const Node* garbage_[kMaxGarbage];
+  size_type garbage_count_ = 0;
+  const Node* fresh_[kMaxGarbage];
+  size_type fresh_count_ = 0;
+};
@@ -0,0 +1,710 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "binary_io.h"
+#include "buffer_pool.h"
+
+// Множество во внешней памяти: B+-дерево со страницами по BufferPool::kPageSize байт в файле.
+// Страницы читаются и пишутся через BufferPool, поэтому в памяти находится не больше
+// buffer_pages страниц, сколько бы элементов ни было в файле. Значения лежат только в листьях,
+// листья связаны в двусвязный список для обхода по возрастанию; внутренние страницы хранят
+// разделители и номера дочерних страниц. Освобожденные при слиянии страницы переиспользуются.
+// Страница 0 - заголовок BinaryFormat, корень и список свободных страниц.
+// Изменения становятся долговечными после flush(); деструктор тоже пытается их сохранить.
+// Ошибка ввода-вывода (std::system_error) посреди изменения оставляет дерево несогласованным.
+// T должен быть тривиально копируемым. Итераторы недействительны после любого изменения.
+template<typename T, typename Compare = std::less<T>>
+class DiskTree {
+  static_assert(std::is_trivially_copyable_v<T>, "DiskTree stores values as raw bytes");
+  static_assert(sizeof(T) <= 256, "DiskTree needs at least a few values per page");
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using const_reference = const value_type&;
+  using key_type = T;
+  using key_compare = Compare;
+  using value_compare = Compare;
+
+  // Меньше страниц не хватает на одновременно закрепленные при слиянии узлы
+  static constexpr size_type kMinBufferPages = 8;
+
+ private:
+  using PageId = std::uint64_t;
+  using PageRef = BufferPool::PageRef;
+
+  static constexpr char kFormatMagic[5] = "BSTD";
+  static constexpr size_type kPageSize = BufferPool::kPageSize;
+  static constexpr PageId kNoPage = 0; // Страница 0 - заголовок, поэтому 0 не бывает ссылкой на узел
+  static constexpr std::uint32_t kLeaf = 1;
+  static constexpr std::uint32_t kInternal = 2;
+  static constexpr std::uint32_t kFree = 3;
+
+  // Страница заголовка: BinaryFormat, затем размер страницы, корень и голова списка свободных
+  static constexpr size_type kPageSizeOffset = BinaryFormat::kHeaderBytes;
+  static constexpr size_type kRootOffset = 32;
+  static constexpr size_type kFreeHeadOffset = 40;
+
+  // Любой узел начинается с типа и числа ключей. Лист: ссылки на соседние листы, затем ключи.
+  // Внутренний узел: count + 1 дочерних страниц, затем count разделителей; в поддереве
+  // children[i] ключи не меньше keys[i - 1] и меньше keys[i]. Свободная страница хранит
+  // ссылку на следующую свободную на месте ссылки на предыдущий лист.
+  static constexpr size_type kCountOffset = 4;
+  static constexpr size_type kPrevOffset = 8;
+  static constexpr size_type kNextOffset = 16;
+  static constexpr size_type kLeafKeysOffset = 24;
+  static constexpr size_type kChildrenOffset = 8;
+
+  static constexpr size_type kMaxLeafKeys = (kPageSize - kLeafKeysOffset) / sizeof(T);
+  static constexpr size_type kMinLeafKeys = kMaxLeafKeys / 2; // Для всех листьев, кроме корня
+  static constexpr size_type kMaxInternalKeys =
+      (kPageSize - kChildrenOffset - sizeof(PageId)) / (sizeof(T) + sizeof(PageId));
+  static constexpr size_type kMinInternalKeys = kMaxInternalKeys / 2;
+  static constexpr size_type kInternalKeysOffset = kChildrenOffset + (kMaxInternalKeys + 1) * sizeof(PageId);
+  // При ветвлении не меньше 8 этого хватает на 2^64 элементов
+  static constexpr size_type kMaxDepth = 24;
+
+ public:
+  // Итератор по возрастанию. Хранит копию текущего значения, страница не закрепляется;
+  // ссылка указывает внутрь итератора, поэтому std::reverse_iterator с ним не работает.
+  class const_iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = const T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator() = default;
+
+    const_iterator& operator++() {
+      tree_->increment(*this);
+      return *this;
+    }
+
+    const_iterator& operator--() {
+      tree_->decrement(*this);
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator result = *this;
+      --*this;
+      return result;
+    }
+
+    reference operator*() const {
+      return value_;
+    }
+
+    pointer operator->() const {
+      return &value_;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return leaf_ == other.leaf_ && slot_ == other.slot_;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class DiskTree;
+
+    const_iterator(const DiskTree* tree, PageId leaf, std::uint32_t slot) : tree_(tree), leaf_(leaf), slot_(slot) {}
+
+    const DiskTree* tree_ = nullptr;
+    PageId leaf_ = kNoPage; // kNoPage - end
+    std::uint32_t slot_ = 0;
+    T value_{};
+  };
+
+  // Открывает дерево в файле path или создает новое, если файла нет или он пуст.
+  // Непустой файл без заголовка дерева, в том числе короче страницы, не перезаписывается:
+  // бросается FormatError. buffer_pages - бюджет памяти в страницах, не меньше kMinBufferPages.
+  DiskTree(const char* path, size_type buffer_pages, const Compare& comp = Compare())
+      : pool_(path, checkBudget(buffer_pages)), comp_(comp) {
+    if (pool_.opened_bytes() == 0) {
+      pool_.create(0);
+      root_ = newPage(kLeaf).page();
+      writeMeta();
+    } else {
+      readMeta();
+    }
+  }
+
+  DiskTree(const DiskTree&) = delete;
+  DiskTree& operator=(const DiskTree&) = delete;
+
+  ~DiskTree() {
+    try {
+      flush();
+    } catch (...) {
+      // Об ошибке записи сообщает только явный flush
+    }
+  }
+
+  // Записывает все изменения в файл и дожидается их попадания на диск
+  void flush() {
+    writeMeta();
+    pool_.flush();
+  }
+
+  bool insert(const value_type& value) {
+    PageId path[kMaxDepth];
+    size_type slots[kMaxDepth];
+    size_type depth = 0;
+    PageRef leaf = descend(value, path, slots, depth);
+    size_type count = countOf(leaf.data());
+    size_type i = lowerIndex(leaf.data(), kLeafKeysOffset, count, value);
+    if (i < count && !comp_(value, keyAt(leaf.data(), kLeafKeysOffset, i))) {
+      return false; // Повторы не допускаются
+    }
+    if (count < kMaxLeafKeys) {
+      insertKey(leaf.mutable_data(), kLeafKeysOffset, i, value);
+      ++size_;
+      return true;
+    }
+    PageRef right = splitLeaf(leaf);
+    size_type left_count = countOf(leaf.data());
+    if (i <= left_count) {
+      insertKey(leaf.mutable_data(), kLeafKeysOffset, i, value);
+    } else {
+      insertKey(right.mutable_data(), kLeafKeysOffset, i - left_count, value);
+    }
+    T separator = keyAt(right.data(), kLeafKeysOffset, 0);
+    PageId right_id = right.page();
+    leaf = PageRef();
+    right = PageRef();
+    insertIntoParents(path, slots, depth, separator, right_id);
+    ++size_;
+    return true;
+  }
+
+  template<typename K>
+  size_type erase(const K& key) {
+    PageId path[kMaxDepth];
+    size_type slots[kMaxDepth];
+    size_type depth = 0;
+    PageRef leaf = descend(key, path, slots, depth);
+    size_type count = countOf(leaf.data());
+    size_type i = lowerIndex(leaf.data(), kLeafKeysOffset, count, key);
+    if (i == count || comp_(key, keyAt(leaf.data(), kLeafKeysOffset, i))) {
+      return 0;
+    }
+    // Разделители в родителях не трогаем: удаленный ключ продолжает верно делить поддеревья
+    eraseKey(leaf.mutable_data(), kLeafKeysOffset, i);
+    --size_;
+    leaf = PageRef();
+    if (depth != 0 && count - 1 < kMinLeafKeys) {
+      rebalance(path, slots, depth);
+    }
+    return 1;
+  }
+
+  template<typename K>
+  const_iterator find(const K& key) const {
+    const_iterator it = lower_bound(key);
+    if (it != end() && comp_(key, *it)) {
+      return end();
+    }
+    return it;
+  }
+
+  template<typename K>
+  bool contains(const K& key) const {
+    return find(key) != end();
+  }
+
+  template<typename K>
+  size_type count(const K& key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  template<typename K>
+  const_iterator lower_bound(const K& key) const {
+    PageId path[kMaxDepth];
+    size_type slots[kMaxDepth];
+    size_type depth = 0;
+    PageRef leaf = descend(key, path, slots, depth);
+    return positionAt(leaf, lowerIndex(leaf.data(), kLeafKeysOffset, countOf(leaf.data()), key));
+  }
+
+  template<typename K>
+  const_iterator upper_bound(const K& key) const {
+    PageId path[kMaxDepth];
+    size_type slots[kMaxDepth];
+    size_type depth = 0;
+    PageRef leaf = descend(key, path, slots, depth);
+    return positionAt(leaf, upperIndex(leaf.data(), kLeafKeysOffset, countOf(leaf.data()), key));
+  }
+
+  template<typename K>
+  std::pair<const_iterator, const_iterator> equal_range(const K& key) const {
+
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  const_iterator begin() const {
+    PageRef page = pool_.fetch(root_);
+    while (kindOf(page.data()) == kInternal) {
+      page = pool_.fetch(childAt(page.data(), 0));
+    }
+
+    return positionAt(page, 0);
+  }
+
+  const_iterator end() const {
+
+    return const_iterator(this, kNoPage, 0);
+  }
+
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  size_type size() const noexcept {
+    return static_cast<size_type>(size_);
+  }
+
+  key_compare key_comp() const {
+
+    return comp_;
+  }
+
+  value_compare value_comp() const {
+
+    return comp_;
+  }
+
+  // Состояние буфера: прочитано и записано страниц с момента открытия
+  const BufferPool& buffer_pool() const noexcept {
+    return pool_;
+  }
+
+ private:
+  static size_type checkBudget(size_type buffer_pages) {
+    if (buffer_pages < kMinBufferPages) {
+      throw std::invalid_argument("DiskTree: buffer budget is too small");
+    }
+    return buffer_pages;
+  }
+
+  // Чтение и запись полей страницы; значения копируются, так как страница не выровнена под T
+  template<typename U>
+  static U load(const unsigned char* page, size_type offset) noexcept {
+    U value;
+    std::memcpy(&value, page + offset, sizeof(U));
+    return value;
+  }
+
+  template<typename U>
+  static void store(unsigned char* page, size_type offset, const U& value) noexcept {
+    std::memcpy(page + offset, &value, sizeof(U));
+  }
+
+  static std::uint32_t kindOf(const unsigned char* page) noexcept {
+    return load<std::uint32_t>(page, 0);
+  }
+
+  static size_type countOf(const unsigned char* page) noexcept {
+    return load<std::uint32_t>(page, kCountOffset);
+  }
+
+  static void setCount(unsigned char* page, size_type count) noexcept {
+    store(page, kCountOffset, static_cast<std::uint32_t>(count));
+  }
+
+  static T keyAt(const unsigned char* page, size_type keys_offset, size_type i) noexcept {
+    return load<T>(page, keys_offset + i * sizeof(T));
+  }
+
+  static PageId childAt(const unsigned char* page, size_type i) noexcept {
+    return load<PageId>(page, kChildrenOffset + i * sizeof(PageId));
+  }
+
+  static void setChild(unsigned char* page, size_type i, PageId child) noexcept {
+    store(page, kChildrenOffset + i * sizeof(PageId), child);
+  }
+
+  // Сдвигает count элементов размера size с позиции from на позицию to внутри массива
+  static void shift(unsigned char* page, size_type offset, size_type size, size_type from, size_type to,
+                    size_type count) noexcept {
+    std::memmove(page + offset + to * size, page + offset + from * size, count * size);
+  }
+
+  static void insertKey(unsigned char* page, size_type keys_offset, size_type i, const T& key) noexcept {
+    size_type count = countOf(page);
+    shift(page, keys_offset, sizeof(T), i, i + 1, count - i);
+    store(page, keys_offset + i * sizeof(T), key);
+    setCount(page, count + 1);
+  }
+
+  static void eraseKey(unsigned char* page, size_type keys_offset, size_type i) noexcept {
+    size_type count = countOf(page);
+    shift(page, keys_offset, sizeof(T), i + 1, i, count - i - 1);
+    setCount(page, count - 1);
+  }
+
+  // Вставляет во внутренний узел разделитель key на позицию i и страницу child справа от него
+  static void insertSeparator(unsigned char* page, size_type i, const T& key, PageId child) noexcept {
+    size_type count = countOf(page);
+    shift(page, kChildrenOffset, sizeof(PageId), i + 1, i + 2, count - i);
+    setChild(page, i + 1, child);
+    insertKey(page, kInternalKeysOffset, i, key);
+  }
+
+  // Удаляет из внутреннего узла разделитель i и страницу справа от него
+  static void eraseSeparator(unsigned char* page, size_type i) noexcept {
+    size_type count = countOf(page);
+    shift(page, kChildrenOffset, sizeof(PageId), i + 2, i + 1, count - i - 1);
+    eraseKey(page, kInternalKeysOffset, i);
+  }
+
+  // Первый ключ, не меньший key
+  template<typename K>
+  size_type lowerIndex(const unsigned char* page, size_type keys_offset, size_type count, const K& key) const {
+    size_type lo = 0;
+    while (count > 0) {
+      size_type half = count / 2;
+      if (comp_(keyAt(page, keys_offset, lo + half), key)) {
+        lo += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return lo;
+  }
+
+  // Первый ключ, больший key
+  template<typename K>
+  size_type upperIndex(const unsigned char* page, size_type keys_offset, size_type count, const K& key) const {
+    size_type lo = 0;
+    while (count > 0) {
+      size_type half = count / 2;
+      if (!comp_(key, keyAt(page, keys_offset, lo + half))) {
+        lo += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return lo;
+  }
+
+  // Спуск к листу, который должен содержать key; path и slots - пройденные внутренние
+  // страницы и номера выбранных в них детей
+  template<typename K>
+  PageRef descend(const K& key, PageId* path, size_type* slots, size_type& depth) const {
+    PageRef page = pool_.fetch(root_);
+    while (kindOf(page.data()) == kInternal) {
+      if (depth == kMaxDepth) {
+        throw FormatError("DiskTree: tree is too deep");
+      }
+      size_type i = upperIndex(page.data(), kInternalKeysOffset, countOf(page.data()), key);
+      path[depth] = page.page();
+      slots[depth] = i;
+      ++depth;
+      page = pool_.fetch(childAt(page.data(), i));
+    }
+    return page;
+  }
+
+  // Позиция slot в листе page; за последним ключом - начало следующего листа
+  const_iterator positionAt(const PageRef& leaf, size_type slot) const {
+    if (slot < countOf(leaf.data())) {
+      const_iterator it(this, leaf.page(), static_cast<std::uint32_t>(slot));
+      it.value_ = keyAt(leaf.data(), kLeafKeysOffset, slot);
+      return it;
+    }
+    PageId next = load<PageId>(leaf.data(), kNextOffset);
+    if (next == kNoPage) {
+      return end();
+    }
+    return positionAt(pool_.fetch(next), 0);
+  }
+
+  void increment(const_iterator& it) const {
+    if (it.leaf_ == kNoPage) {
+      return;
+    }
+    it = positionAt(pool_.fetch(it.leaf_), it.slot_ + 1);
+  }
+
+  void decrement(const_iterator& it) const {
+    PageRef leaf;
+    size_type slot;
+    if (it.leaf_ == kNoPage) {
+      leaf = pool_.fetch(root_);
+      while (kindOf(leaf.data()) == kInternal) {
+        leaf = pool_.fetch(childAt(leaf.data(), countOf(leaf.data())));
+      }
+      slot = countOf(leaf.data());
+    } else {
+      leaf = pool_.fetch(it.leaf_);
+      slot = it.slot_;
+    }
+    if (slot == 0) {
+      PageId prev = load<PageId>(leaf.data(), kPrevOffset);
+      if (prev == kNoPage) {
+        it = end(); // Шаг назад от begin или от end пустого дерева
+        return;
+      }
+      leaf = pool_.fetch(prev);
+      slot = countOf(leaf.data());
+    }
+    it = positionAt(leaf, slot - 1);
+  }
+
+  // Новая страница заданного типа: из списка свободных или в конце файла
+  PageRef newPage(std::uint32_t kind) {
+    PageId id = free_head_;
+    if (id != kNoPage) {
+      free_head_ = load<PageId>(pool_.fetch(id).data(), kPrevOffset);
+    } else {
+      id = pool_.page_count();
+    }
+    PageRef page = pool_.create(id);
+    store(page.mutable_data(), 0, kind);
+    return page;
+  }
+
+  // Страница не должна быть закреплена
+  void freePage(PageId id) {
+    PageRef page = pool_.create(id);
+    store(page.mutable_data(), 0, kFree);
+    store(page.mutable_data(), kPrevOffset, free_head_);
+    free_head_ = id;
+  }
+
+  // Переносит верхнюю половину полного листа в новый лист справа от него
+  PageRef splitLeaf(PageRef& leaf) {
+    PageRef right = newPage(kLeaf);
+    unsigned char* left_data = leaf.mutable_data();
+    unsigned char* right_data = right.mutable_data();
+    size_type count = countOf(left_data);
+    size_type keep = count / 2;
+    std::memcpy(right_data + kLeafKeysOffset, left_data + kLeafKeysOffset + keep * sizeof(T),
+                (count - keep) * sizeof(T));
+    setCount(right_data, count - keep);
+    setCount(left_data, keep);
+    PageId next = load<PageId>(left_data, kNextOffset);
+    store(right_data, kPrevOffset, leaf.page());
+    store(right_data, kNextOffset, next);
+    store(left_data, kNextOffset, right.page());
+    if (next != kNoPage) {
+      store(pool_.fetch(next).mutable_data(), kPrevOffset, right.page());
+    }
+    return right;
+  }
+
+  // Добавляет в родителей разделитель и новую страницу right_id, разделяя переполненные узлы
+  // снизу вверх; если разделился корень, над ним создается новый
+  void insertIntoParents(const PageId* path, const size_type* slots, size_type depth, T separator, PageId right_id) {
+    while (depth > 0) {
+      --depth;
+      PageRef parent = pool_.fetch(path[depth]);
+      size_type i = slots[depth];
+      size_type count = countOf(parent.data());
+      if (count < kMaxInternalKeys) {
+        insertSeparator(parent.mutable_data(), i, separator, right_id);
+        return;
+      }
+      // Средний разделитель уходит вверх, правая половина - в новый узел
+      PageRef sibling = newPage(kInternal);
+      unsigned char* left_data = parent.mutable_data();
+      unsigned char* right_data = sibling.mutable_data();
+      size_type mid = count / 2;
+      T up = keyAt(left_data, kInternalKeysOffset, mid);
+      std::memcpy(right_data + kInternalKeysOffset, left_data + kInternalKeysOffset + (mid + 1) * sizeof(T),
+                  (count - mid - 1) * sizeof(T));
+      std::memcpy(right_data + kChildrenOffset, left_data + kChildrenOffset + (mid + 1) * sizeof(PageId),
+                  (count - mid) * sizeof(PageId));
+      setCount(right_data, count - mid - 1);
+      setCount(left_data, mid);
+      if (i <= mid) {
+        insertSeparator(left_data, i, separator, right_id);
+      } else {
+        insertSeparator(right_data, i - mid - 1, separator, right_id);
+      }
+      separator = up;
+      right_id = sibling.page();
+    }
+    PageRef root = newPage(kInternal);
+    unsigned char* data = root.mutable_data();
+    setChild(data, 0, root_);
+    setChild(data, 1, right_id);
+    store(data, kInternalKeysOffset, separator);
+    setCount(data, 1);
+    root_ = root.page();
+  }
+
+  // Восстанавливает заполненность узла path[depth - 1].children[slots[depth - 1]], поднимаясь
+  // выше, пока слияние оставляет родителя недозаполненным
+  void rebalance(const PageId* path, const size_type* slots, size_type depth) {
+    while (depth > 0) {
+      --depth;
+      PageRef parent = pool_.fetch(path[depth]);
+      size_type s = slots[depth];
+      PageRef node = pool_.fetch(childAt(parent.data(), s));
+      bool leaf = kindOf(node.data()) == kLeaf;
+      size_type min_keys = leaf ? kMinLeafKeys : kMinInternalKeys;
+      PageRef left;
+      PageRef right;
+      if (s > 0) {
+        left = pool_.fetch(childAt(parent.data(), s - 1));
+        if (countOf(left.data()) > min_keys) {
+          rotateRight(parent, s - 1, left, node);
+          return;
+        }
+      }
+      if (s < countOf(parent.data())) {
+        right = pool_.fetch(childAt(parent.data(), s + 1));
+        if (countOf(right.data()) > min_keys) {
+          rotateLeft(parent, s, node, right);
+          return;
+        }
+      }
+      if (s > 0) {
+        mergeChildren(parent, s - 1, left, node);
+      } else {
+        mergeChildren(parent, s, node, right);
+      }
+      size_type parent_count = countOf(parent.data());
+      if (depth == 0) {
+        if (parent_count == 0) {
+          // Корень без разделителей заменяется единственным потомком
+          root_ = childAt(parent.data(), 0);
+          parent = PageRef();
+          freePage(path[0]);
+        }
+        return;
+      }
+      if (parent_count >= kMinInternalKeys) {
+        return;
+      }
+    }
+  }
+
+  // Переносит последний ключ left в начало node через разделитель k родителя
+  void rotateRight(PageRef& parent, size_type k, PageRef& left, PageRef& node) {
+    unsigned char* left_data = left.mutable_data();
+    unsigned char* node_data = node.mutable_data();
+    size_type left_count = countOf(left_data);
+    if (kindOf(node_data) == kLeaf) {
+      T moved = keyAt(left_data, kLeafKeysOffset, left_count - 1);
+      eraseKey(left_data, kLeafKeysOffset, left_count - 1);
+      insertKey(node_data, kLeafKeysOffset, 0, moved);
+      store(parent.mutable_data(), kInternalKeysOffset + k * sizeof(T), moved);
+      return;
+    }
+    unsigned char* parent_data = parent.mutable_data();
+    shift(node_data, kChildrenOffset, sizeof(PageId), 0, 1, countOf(node_data) + 1);
+    setChild(node_data, 0, childAt(left_data, left_count));
+    insertKey(node_data, kInternalKeysOffset, 0, keyAt(parent_data, kInternalKeysOffset, k));
+    store(parent_data, kInternalKeysOffset + k * sizeof(T), keyAt(left_data, kInternalKeysOffset, left_count - 1));
+    setCount(left_data, left_count - 1);
+  }
+
+  // Переносит первый ключ right в конец node через разделитель k родителя
+  void rotateLeft(PageRef& parent, size_type k, PageRef& node, PageRef& right) {
+    unsigned char* node_data = node.mutable_data();
+    unsigned char* right_data = right.mutable_data();
+    size_type node_count = countOf(node_data);
+    if (kindOf(node_data) == kLeaf) {
+      insertKey(node_data, kLeafKeysOffset, node_count, keyAt(right_data, kLeafKeysOffset, 0));
+      eraseKey(right_data, kLeafKeysOffset, 0);
+      store(parent.mutable_data(), kInternalKeysOffset + k * sizeof(T), keyAt(right_data, kLeafKeysOffset, 0));
+      return;
+    }
+    unsigned char* parent_data = parent.mutable_data();
+    setChild(node_data, node_count + 1, childAt(right_data, 0));
+    insertKey(node_data, kInternalKeysOffset, node_count, keyAt(parent_data, kInternalKeysOffset, k));
+    store(parent_data, kInternalKeysOffset + k * sizeof(T), keyAt(right_data, kInternalKeysOffset, 0));
+    shift(right_data, kChildrenOffset, sizeof(PageId), 1, 0, countOf(right_data));
+    eraseKey(right_data, kInternalKeysOffset, 0);
+  }
+
+  // Сливает right в left и удаляет из родителя разделитель k вместе со страницей right
+  void mergeChildren(PageRef& parent, size_type k, PageRef& left, PageRef& right) {
+    unsigned char* left_data = left.mutable_data();
+    const unsigned char* right_data = right.data();
+    size_type left_count = countOf(left_data);
+    size_type right_count = countOf(right_data);
+    if (kindOf(left_data) == kLeaf) {
+      std::memcpy(left_data + kLeafKeysOffset + left_count * sizeof(T), right_data + kLeafKeysOffset,
+                  right_count * sizeof(T));
+      setCount(left_data, left_count + right_count);
+      PageId next = load<PageId>(right_data, kNextOffset);
+      store(left_data, kNextOffset, next);
+      if (next != kNoPage) {
+        store(pool_.fetch(next).mutable_data(), kPrevOffset, left.page());
+      }
+    } else {
+      store(left_data, kInternalKeysOffset + left_count * sizeof(T), keyAt(parent.data(), kInternalKeysOffset, k));
+      std::memcpy(left_data + kInternalKeysOffset + (left_count + 1) * sizeof(T), right_data + kInternalKeysOffset,
+                  right_count * sizeof(T));
+      std::memcpy(left_data + kChildrenOffset + (left_count + 1) * sizeof(PageId), right_data + kChildrenOffset,
+                  (right_count + 1) * sizeof(PageId));
+      setCount(left_data, left_count + right_count + 1);
+    }
+    PageId right_id = right.page();
+    right = PageRef();
+    eraseSeparator(parent.mutable_data(), k);
+    freePage(right_id);
+  }
+
+  void writeMeta() {
+    PageRef meta = pool_.fetch(0);
+    unsigned char* data = meta.mutable_data();
+    BinaryFormat::writeHeader(data, kFormatMagic, BinaryFormat::headerFor<T>(size_));
+    store(data, kPageSizeOffset, static_cast<std::uint32_t>(kPageSize));
+    store(data, kRootOffset, root_);
+    store(data, kFreeHeadOffset, free_head_);
+  }
+
+  void readMeta() {
+    if (pool_.page_count() == 0) {
+      throw FormatError("DiskTree: file is shorter than one page");
+    }
+    PageRef meta = pool_.fetch(0);
+    const unsigned char* data = meta.data();
+    BinaryFormat::Header header = BinaryFormat::readHeader(data, kPageSize, kFormatMagic);
+    if (!BinaryFormat::matches<T>(header) || load<std::uint32_t>(data, kPageSizeOffset) != kPageSize) {
+      throw FormatError("DiskTree: stored values or page size differ");
+    }
+    size_ = header.count;
+    root_ = load<PageId>(data, kRootOffset);
+    free_head_ = load<PageId>(data, kFreeHeadOffset);
+    if (root_ == kNoPage || root_ >= pool_.page_count() || free_head_ >= pool_.page_count()) {
+      throw FormatError("DiskTree: bad page reference in header");
+    }
+    std::uint32_t kind = kindOf(pool_.fetch(root_).data());
+    if (kind != kLeaf && kind != kInternal) {
+      throw FormatError("DiskTree: bad root page");
+    }
+  }
+
+  mutable BufferPool pool_;
+  Compare comp_;
+  PageId root_ = kNoPage;
+  PageId free_head_ = kNoPage; // Голова списка свободных страниц
+  std::uint64_t size_ = 0;
+};
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Эпохальное освобождение памяти для структур с читателями без блокировок.
+// Читатель на время доступа закрепляется (Guard) в текущей глобальной эпохе. Объект, исключенный
+// из структуры, передается в retire() и освобождается только после того, как глобальная эпоха
+// продвинется на два шага: к этому моменту все читатели, которые могли его видеть, завершились.
+// Эпоха продвигается, когда все закрепленные читатели уже находятся в текущей эпохе.
+class EpochDomain {
+  struct Record;
+
+ public:
+  using Deleter = void (*)(void* context, void* object);
+
+  // Закрепление читателя; пока Guard жив, объекты, видимые через структуру, не освобождаются
+  class Guard {
+   public:
+    explicit Guard(EpochDomain& domain) : record_(domain.acquire()) {
+      record_->epoch.store(domain.epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+      // Объявление эпохи должно стать видимым до любого чтения указателей структуры
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    Guard(Guard&& other) noexcept : record_(other.record_) {
+      other.record_ = nullptr;
+    }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+    Guard& operator=(Guard&&) = delete;
+
+    ~Guard() {
+      if (record_ != nullptr) {
+        record_->epoch.store(0, std::memory_order_release);
+        record_->in_use.store(false, std::memory_order_release);
+      }
+    }
+
+   private:
+    Record* record_;
+  };
+
+  // Заранее выделенные записи для отложенного освобождения. Пока Reservation жив, ее retire()
+  // не выделяет память и не бросает исключений: структура резервирует записи до публикации
+  // изменения, и после публикации исключенные объекты гарантированно попадают в домен.
+  class Reservation {
+   public:
+    Reservation(EpochDomain& domain, std::size_t count) : domain_(domain), left_(count) {
+      domain.reserve(count);
+    }
+
+    Reservation(const Reservation&) = delete;
+    Reservation& operator=(const Reservation&) = delete;
+
+    // Неиспользованные записи остаются в запасе домена
+    ~Reservation() {
+      if (left_ != 0) {
+        domain_.unreserve(left_);
+      }
+    }
+
+    // Не больше count вызовов
+    void retire(void* object, Deleter deleter, void* context) noexcept {
+      --left_;
+      domain_.retireReserved(object, deleter, context);
+    }
+
+   private:
+    EpochDomain& domain_;
+    std::size_t left_;
+  };
+
+  EpochDomain() noexcept : id_(next_id().fetch_add(1, std::memory_order_relaxed)) {}
+
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  // К моменту разрушения читателей уже быть не должно
+  ~EpochDomain() {
+    drain();
+    while (spare_ != nullptr) {
+      Retired* next = spare_->next;
+      delete spare_;
+      spare_ = next;
+    }
+    Record* record = records_.load(std::memory_order_acquire);
+    while (record != nullptr) {
+      Record* next = record->next;
+      delete record;
+      record = next;
+    }
+  }
+
+  // Откладывает освобождение объекта, уже недоступного новым читателям.
+  // deleter(context, object) вызывается из retire() или drain() того же потока-писателя.
+  // Если запись выделить не удалось, бросает std::bad_alloc, и объект остается за вызывающим;
+  // чтобы не попасть в такое положение после публикации изменения, есть Reservation.
+  void retire(void* object, Deleter deleter, void* context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Запасные записи сверх зарезервированных свободны
+    Retired* record = spare_count_ > reserved_ ? takeSpare() : new Retired;
+    enqueue(record, object, deleter, context);
+  }
+
+  // Пытается продвинуть эпоху и освободить то, что уже безопасно
+  void collect() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tryAdvance();
+  }
+
+  // Освобождает все отложенные объекты. Вызывать, только когда читателей нет.
+  void drain() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Retired*& list : limbo_) {
+      free(list);
+    }
+    pending_ = 0;
+  }
+
+  std::size_t pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+  }
+
+ private:
+  static constexpr std::size_t kCollectThreshold = 64;
+
+  // Запись участника; записи только добавляются в список и живут до разрушения домена
+  struct alignas(64) Record {
+    std::atomic<std::uint64_t> epoch{0}; // 0 - читатель не закреплен
+    std::atomic<bool> in_use{false};
+    Record* next = nullptr;
+  };
+
+  struct Retired {
+    void* object;
+    Deleter deleter;
+    void* context;
+    Retired* next;
+  };
+
+  static std::atomic<std::uint64_t>& next_id() noexcept {
+    static std::atomic<std::uint64_t> id{1};
+    return id;
+  }
+
+  static bool tryClaim(Record* record) noexcept {
+    return !record->in_use.load(std::memory_order_relaxed)
+        && !record->in_use.exchange(true, std::memory_order_acquire);
+  }
+
+  // Запись для нового Guard. Поток в первую очередь пробует запись, которой пользовался
+  // в прошлый раз, поэтому в установившемся режиме список не просматривается.
+  // Идентификатор домена уникален, так что запись из подсказки принадлежит живому домену.
+  Record* acquire() {
+    struct Hint {
+      std::uint64_t domain = 0;
+      Record* record = nullptr;
+    };
+    thread_local Hint hint;
+    if (hint.domain == id_ && tryClaim(hint.record)) {
+      return hint.record;
+    }
+    Record* head = records_.load(std::memory_order_acquire);
+    for (Record* record = head; record != nullptr; record = record->next) {
+      if (tryClaim(record)) {
+        hint = Hint{id_, record};
+        return record;
+      }
+    }
+    Record* record = new Record;
+    record->in_use.store(true, std::memory_order_relaxed);
+    record->next = head;
+    while (!records_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                           std::memory_order_acquire)) {
+    }
+    hint = Hint{id_, record};
+    return record;
+  }
+
+  void reserve(std::size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reserved_ += count;
+    try {
+      while (spare_count_ < reserved_) {
+        spare_ = new Retired{nullptr, nullptr, nullptr, spare_};
+        ++spare_count_;
+      }
+    } catch (...) {
+      reserved_ -= count;
+      throw;
+    }
+  }
+
+  void unreserve(std::size_t count) noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reserved_ -= count;
+  }
+
+  // Запас не меньше reserved_, поэтому запись для зарезервированного объекта всегда есть
+  void retireReserved(void* object, Deleter deleter, void* context) noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --reserved_;
+    enqueue(takeSpare(), object, deleter, context);
+  }
+
+  // Методы ниже вызываются под mutex_
+  Retired* takeSpare() noexcept {
+    Retired* record = spare_;
+    spare_ = record->next;
+    --spare_count_;
+    return record;
+  }
+
+  void enqueue(Retired* record, void* object, Deleter deleter, void* context) noexcept {
+    // Объект исключен из структуры до чтения эпохи, поэтому новые читатели его уже не увидят
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+    *record = Retired{object, deleter, context, limbo_[epoch % 3]};
+    limbo_[epoch % 3] = record;
+    if (++pending_ >= kCollectThreshold) {
+      tryAdvance();
+    }
+  }
+
+  void tryAdvance() noexcept {
+    std::uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+    for (Record* record = records_.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+      std::uint64_t pinned = record->epoch.load(std::memory_order_acquire);
+      if (pinned != 0 && pinned != epoch) {
+        return; // Кто-то еще читает в прошлой эпохе
+      }
+    }
+    epoch_.store(epoch + 1, std::memory_order_seq_cst);
+    // Все читатели теперь не старше epoch, значит объекты из epoch - 1 никто не видит
+    free(limbo_[(epoch + 2) % 3]);
+  }
+
+  // Освободившиеся записи остаются в запасе для следующих retire, но не сверх kCollectThreshold
+  void free(Retired*& list) noexcept {
+    while (list != nullptr) {
+      Retired* next = list->next;
+      list->deleter(list->context, list->object);
+      if (spare_count_ < reserved_ + kCollectThreshold) {
+        list->next = spare_;
+        spare_ = list;
+        ++spare_count_;
+      } else {
+        delete list;
+      }
+      list = next;
+      --pending_;
+    }
+  }
+
+  const std::uint64_t id_;
+  std::atomic<std::uint64_t> epoch_{1};
+  std::atomic<Record*> records_{nullptr};
+  mutable std::mutex mutex_;
+  Retired* limbo_[3] = {nullptr, nullptr, nullptr}; // Отложенные объекты по эпохе удаления mod 3
+  std::size_t pending_ = 0;
+  Retired* spare_ = nullptr; // Запас записей, из него берут retire
+  std::size_t spare_count_ = 0;
+  std::size_t reserved_ = 0; // Сколько записей запаса обещано живым Reservation
+};
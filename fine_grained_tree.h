@@ -0,0 +1,335 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "epoch.h"
+
+// Множество для одновременной записи из многих потоков.
+// Внешнее (листовое) дерево поиска: значения лежат только в листьях, внутренние узлы хранят
+// копии ключей для маршрутизации. Поиск идет без блокировок. Изменение захватывает только
+// затрагиваемые узлы - родителя при вставке, деда и родителя при удалении - и перед записью
+// проверяет, что они все еще связаны так, как видел поиск; иначе операция повторяется.
+// Потоки, меняющие разные части дерева, друг друга не ждут. Удаленные узлы освобождаются
+// через EpochDomain.
+// Дерево не балансируется: на случайных ключах глубина O(log n), на упорядоченных - O(n).
+// Аллокатор вызывается из разных потоков и должен быть потокобезопасным.
+template<typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class FineGrainedTree {
+ public:
+  using value_type = T;
+  using allocator_type = Alloc;
+  using size_type = std::size_t;
+  using key_type = T;
+  using key_compare = Compare;
+  using value_compare = Compare;
+
+ private:
+  class SpinLock {
+   public:
+    void lock() noexcept {
+      while (locked_.exchange(true, std::memory_order_acquire)) {
+        while (locked_.load(std::memory_order_relaxed)) {
+          std::this_thread::yield();
+        }
+      }
+    }
+
+    void unlock() noexcept {
+      locked_.store(false, std::memory_order_release);
+    }
+
+   private:
+    std::atomic<bool> locked_{false};
+  };
+
+  // Сторожевой ключ: 1 и 2 больше любого значения, 1 < 2
+  struct Sentinel {
+    unsigned char infinity;
+  };
+
+  struct Node {
+    union {
+      value_type value; // Существует только у узлов с infinity == 0
+    };
+    std::atomic<Node*> left{nullptr};
+    std::atomic<Node*> right{nullptr};
+    SpinLock lock;
+    bool removed = false; // Узел исключен из дерева; меняется и читается под lock
+    bool leaf;
+    unsigned char infinity; // 0 - обычный ключ; 1 и 2 - сторожевые ключи, большие любого значения
+
+    Node(bool leaf, Sentinel sentinel) noexcept : leaf(leaf), infinity(sentinel.infinity) {}
+
+    template<typename V>
+    Node(bool leaf, V&& value) : value(std::forward<V>(value)), leaf(leaf), infinity(0) {}
+
+    ~Node() {
+      if (infinity == 0) {
+        value.~value_type();
+      }
+    }
+
+    std::atomic<Node*>& child(bool to_left) noexcept {
+      return to_left ? left : right;
+    }
+  };
+
+  using NodeAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+  using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+ public:
+  // Корень со сторожевым ключом 2, слева - лист 1, справа - лист 2. Все значения меньше
+  // сторожевых, поэтому у любого настоящего листа есть и родитель, и дед.
+  FineGrainedTree() : FineGrainedTree(Compare()) {}
+
+  explicit FineGrainedTree(const Compare& comp, const allocator_type& alloc = allocator_type())
+      : node_allocator_(alloc), comp_(comp) {
+    root_ = allocateNode(false, Sentinel{2});
+    root_->left.store(allocateNode(true, Sentinel{1}), std::memory_order_relaxed);
+    root_->right.store(allocateNode(true, Sentinel{2}), std::memory_order_relaxed);
+  }
+
+  FineGrainedTree(const FineGrainedTree&) = delete;
+  FineGrainedTree& operator=(const FineGrainedTree&) = delete;
+
+  // К моменту разрушения других потоков, работающих с деревом, быть не должно
+  ~FineGrainedTree() {
+    domain_.drain();
+    // Разрушение без рекурсии: левые потомки поворачиваются направо, пока их не останется
+    Node* node = root_;
+    while (node != nullptr) {
+      Node* left = node->left.load(std::memory_order_relaxed);
+      if (left != nullptr) {
+        node->left.store(left->right.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        left->right.store(node, std::memory_order_relaxed);
+        node = left;
+      } else {
+        Node* right = node->right.load(std::memory_order_relaxed);
+        deallocateNode(node);
+        node = right;
+      }
+    }
+  }
+
+  template<typename K>
+  bool contains(const K& key) const {
+    EpochDomain::Guard guard(domain_);
+    return isKey(search(key).leaf, key);
+  }
+
+  bool insert(const value_type& value) {
+    return insertValue(value);
+  }
+
+  bool insert(value_type&& value) {
+    return insertValue(std::move(value));
+  }
+
+  template<typename K>
+  size_type erase(const K& key) {
+    while (true) {
+      EpochDomain::Guard guard(domain_);
+      Position position = search(key);
+      if (!isKey(position.leaf, key)) {
+        return 0;
+      }
+      // Записи для освобождения резервируются до того, как узлы исключаются из дерева
+      EpochDomain::Reservation reservation(domain_, 2);
+      Node* gparent = position.gparent;
+      Node* parent = position.parent;
+      // Блокировки берутся от предка к потомку; предок не может стать потомком своего потомка,
+      // поэтому порядок у всех потоков согласован и взаимных блокировок нет
+      gparent->lock.lock();
+      parent->lock.lock();
+      bool valid = !gparent->removed && gparent->child(position.parent_left).load(std::memory_order_relaxed) == parent
+          && !parent->removed && parent->child(position.leaf_left).load(std::memory_order_relaxed) == position.leaf;
+      if (valid) {
+        Node* sibling = parent->child(!position.leaf_left).load(std::memory_order_relaxed);
+        gparent->child(position.parent_left).store(sibling, std::memory_order_release);
+        parent->removed = true;
+      }
+      parent->lock.unlock();
+      gparent->lock.unlock();
+      if (valid) {
+        reservation.retire(parent, &FineGrainedTree::deleteNode, this);
+        reservation.retire(position.leaf, &FineGrainedTree::deleteNode, this);
+        return 1;
+      }
+    }
+  }
+
+  // Обход значений по возрастанию. При одновременных изменениях обход видит каждое значение,
+  // присутствовавшее все время обхода, и ни одного, отсутствовавшего все это время.
+  // Следующий элемент ищется от корня, поэтому обход занимает O(n * глубина).
+  template<typename F>
+  void for_each(F f) const {
+    EpochDomain::Guard guard(domain_);
+    const Node* leaf = leftmostLeaf(root_->left.load(std::memory_order_acquire));
+    while (leaf->infinity == 0) {
+      f(leaf->value);
+      leaf = successor(leaf);
+    }
+  }
+
+  size_type size() const {
+    size_type count = 0;
+    for_each([&count](const value_type&) { ++count; });
+    return count;
+  }
+
+  bool empty() const {
+    EpochDomain::Guard guard(domain_);
+    return root_->left.load(std::memory_order_acquire)->infinity != 0;
+  }
+
+  key_compare key_comp() const {
+    return comp_;
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return node_allocator_;
+  }
+
+ private:
+  struct Position {
+    Node* gparent;
+    Node* parent;
+    Node* leaf;
+    bool parent_left; // parent - левый потомок gparent
+    bool leaf_left;   // leaf - левый потомок parent
+  };
+
+  template<typename... Args>
+  Node* allocateNode(Args&&... args) {
+    Node* node = NodeTraits::allocate(node_allocator_, 1);
+    try {
+      NodeTraits::construct(node_allocator_, node, std::forward<Args>(args)...);
+    } catch (...) {
+      NodeTraits::deallocate(node_allocator_, node, 1);
+      throw;
+    }
+    return node;
+  }
+
+  void deallocateNode(Node* node) noexcept {
+    NodeTraits::destroy(node_allocator_, node);
+    NodeTraits::deallocate(node_allocator_, node, 1);
+  }
+
+  static void deleteNode(void* tree, void* node) {
+    static_cast<FineGrainedTree*>(tree)->deallocateNode(static_cast<Node*>(node));
+  }
+
+  // Маршрутный узел с копией ключа узла source
+  Node* allocateRouting(const Node* source) {
+    if (source->infinity != 0) {
+      return allocateNode(false, Sentinel{source->infinity});
+    }
+    return allocateNode(false, source->value);
+  }
+
+  // key < ключ узла
+  template<typename K>
+  bool goesLeft(const K& key, const Node* node) const {
+    return node->infinity != 0 || comp_(key, node->value);
+  }
+
+  template<typename K>
+  bool isKey(const Node* leaf, const K& key) const {
+    return leaf->infinity == 0 && !comp_(key, leaf->value) && !comp_(leaf->value, key);
+  }
+
+  template<typename K>
+  Position search(const K& key) const {
+    Position position{nullptr, root_, root_->left.load(std::memory_order_acquire), true, true};
+    while (!position.leaf->leaf) {
+      position.gparent = position.parent;
+      position.parent_left = position.leaf_left;
+      position.parent = position.leaf;
+      position.leaf_left = goesLeft(key, position.parent);
+      position.leaf = position.parent->child(position.leaf_left).load(std::memory_order_acquire);
+    }
+    return position;
+  }
+
+  static const Node* leftmostLeaf(const Node* node) {
+    while (!node->leaf) {
+      node = node->left.load(std::memory_order_acquire);
+    }
+    return node;
+  }
+
+  // Наименьший лист с ключом больше ключа leaf
+  const Node* successor(const Node* leaf) const {
+    const value_type& key = leaf->value;
+    const Node* node = root_->left.load(std::memory_order_acquire);
+    const Node* next = root_->right.load(std::memory_order_acquire);
+    while (!node->leaf) {
+      if (goesLeft(key, node)) {
+        next = node->right.load(std::memory_order_acquire); // Правое поддерево последнего поворота налево
+        node = node->left.load(std::memory_order_acquire);
+      } else {
+        node = node->right.load(std::memory_order_acquire);
+      }
+    }
+    if (node->infinity != 0 || comp_(key, node->value)) {
+      return node; // Сам leaf уже удален, а на его месте - следующий лист
+    }
+    return leftmostLeaf(next);
+  }
+
+  template<typename V>
+  bool insertValue(V&& value) {
+    Node* new_leaf = nullptr;
+    while (true) {
+      EpochDomain::Guard guard(domain_);
+      // После первой попытки значение уже перемещено в new_leaf
+      const value_type& key = new_leaf != nullptr ? new_leaf->value : value;
+      Position position = search(key);
+      if (isKey(position.leaf, key)) {
+        if (new_leaf != nullptr) {
+          deallocateNode(new_leaf);
+        }
+        return false; // Повторы не допускаются
+      }
+      if (new_leaf == nullptr) {
+        new_leaf = allocateNode(true, std::forward<V>(value));
+      }
+      // Новый маршрутный узел получает ключ большего из двух листьев
+      bool new_left = goesLeft(new_leaf->value, position.leaf);
+      Node* routing;
+      try {
+        routing = allocateRouting(new_left ? position.leaf : new_leaf);
+      } catch (...) {
+        deallocateNode(new_leaf);
+        throw;
+      }
+      routing->left.store(new_left ? new_leaf : position.leaf, std::memory_order_relaxed);
+      routing->right.store(new_left ? position.leaf : new_leaf, std::memory_order_relaxed);
+
+      Node* parent = position.parent;
+      parent->lock.lock();
+      bool valid = !parent->removed
+          && parent->child(position.leaf_left).load(std::memory_order_relaxed) == position.leaf;
+      if (valid) {
+        parent->child(position.leaf_left).store(routing, std::memory_order_release);
+      }
+      parent->lock.unlock();
+      if (valid) {
+        return true;
+      }
+      deallocateNode(routing); // Узел не был опубликован
+    }
+  }
+
+  NodeAllocator node_allocator_;
+  Compare comp_;
+  Node* root_;
+  mutable EpochDomain domain_;
+};
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+// Неизменяемый снимок множества для быстрого чтения. Ключи хранятся в массиве в порядке
+// Эйтцингера (неявное дерево: потомки узла k - 2k и 2k + 1), поэтому спуск идет по смежной
+// памяти, а верхние уровни всегда лежат в кэше. Спуск без ветвлений: на каждом уровне индекс
+// вычисляется арифметически из результата сравнения, а узлы на несколько уровней ниже
+// заранее подгружаются программной предвыборкой.
+// Отдельно хранится отсортированная копия значений для итерации с произвольным доступом.
+template<typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class FrozenTree {
+ public:
+  using value_type = T;
+  using key_type = T;
+  using key_compare = Compare;
+  using allocator_type = Alloc;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using const_reference = const value_type&;
+  using const_iterator = const value_type*; // Итератор произвольного доступа в порядке InOrder
+
+ private:
+  using ValueTraits = std::allocator_traits<Alloc>;
+  using RankAllocator = typename ValueTraits::template rebind_alloc<size_type>;
+  using RankTraits = std::allocator_traits<RankAllocator>;
+
+ public:
+  FrozenTree() = default;
+
+  // Строит снимок из отсортированного диапазона без повторов длины count
+  template<typename InputIt>
+  FrozenTree(InputIt first, InputIt last, size_type count, const Compare& comp = Compare(),
+             const allocator_type& alloc = allocator_type())
+      : alloc_(alloc), comp_(comp) {
+    build(first, last, count);
+  }
+
+  FrozenTree(const FrozenTree& other)
+      : alloc_(ValueTraits::select_on_container_copy_construction(other.alloc_)), comp_(other.comp_) {
+    build(other.begin(), other.end(), other.size());
+  }
+
+  FrozenTree(FrozenTree&& other) noexcept
+      : alloc_(std::move(other.alloc_)), comp_(other.comp_), size_(other.size_), capacity_(other.capacity_),
+        values_(other.values_), keys_(other.keys_), ranks_(other.ranks_) {
+    other.size_ = other.capacity_ = 0;
+    other.values_ = other.keys_ = nullptr;
+    other.ranks_ = nullptr;
+  }
+
+  FrozenTree& operator=(FrozenTree other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~FrozenTree() {
+    destroy();
+  }
+
+  void swap(FrozenTree& other) noexcept {
+    using std::swap;
+    swap(alloc_, other.alloc_);
+    swap(comp_, other.comp_);
+    swap(size_, other.size_);
+    swap(capacity_, other.capacity_);
+    swap(values_, other.values_);
+    swap(keys_, other.keys_);
+    swap(ranks_, other.ranks_);
+  }
+
+  // Поиск: K - value_type или тип, сравнимый с ним через Compare
+  template<typename K>
+  const_iterator lower_bound(const K& key) const {
+    return at_index(descend(key, [this](const value_type& node, const K& k) { return comp_(node, k); }));
+  }
+
+  template<typename K>
+  const_iterator upper_bound(const K& key) const {
+    return at_index(descend(key, [this](const value_type& node, const K& k) { return !comp_(k, node); }));
+  }
+
+  template<typename K>
+  const_iterator find(const K& key) const {
+    size_type k = descend(key, [this](const value_type& node, const K& key) { return comp_(node, key); });
+    if (k != 0 && !comp_(key, keys_[k])) {
+      return at_index(k);
+    }
+    return end();
+  }
+
+  template<typename K>
+  bool contains(const K& key) const {
+    size_type k = descend(key, [this](const value_type& node, const K& key) { return comp_(node, key); });
+    return k != 0 && !comp_(key, keys_[k]);
+  }
+
+  template<typename K>
+  size_type count(const K& key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  template<typename K>
+  std::pair<const_iterator, const_iterator> equal_range(const K& key) const {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  // k-й по возрастанию элемент (с нуля)
+  const_reference operator[](size_type k) const {
+    return values_[k];
+  }
+
+  const_iterator begin() const noexcept {
+    return values_;
+  }
+
+  const_iterator end() const noexcept {
+    return values_ + size_;
+  }
+
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  size_type size() const noexcept {
+    return size_;
+  }
+
+  key_compare key_comp() const {
+    return comp_;
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return alloc_;
+  }
+
+ private:
+  // Спуск по неявному дереву: go_right(узел, ключ) решает, уходить ли вправо.
+  // Возвращает индекс узла в массиве Эйтцингера или 0, если подходящего нет.
+  template<typename K, typename GoRight>
+  size_type descend(const K& key, GoRight go_right) const {
+    // Узлы на 4 уровня ниже текущего занимают 16 подряд идущих ячеек, для небольших ключей -
+    // одну-две кэш-линии, поэтому их можно запросить заранее одной предвыборкой
+    constexpr size_type kLookahead = 16;
+    size_type k = 1;
+    while (k <= size_) {
+      prefetch(k * kLookahead);
+      k = 2 * k + static_cast<size_type>(go_right(keys_[k], key));
+    }
+    // Последний поворот налево указывает на ответ: отбрасываем завершающие повороты направо
+    return k >> (trailing_ones(k) + 1);
+  }
+
+  void prefetch(size_type index) const noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    // Адрес считается через целое число, чтобы не выходить указателем за границы массива
+    __builtin_prefetch(reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(keys_)
+                                                     + index * sizeof(value_type)));
+#else
+    (void) index;
+#endif
+  }
+
+  static unsigned trailing_ones(size_type k) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(~static_cast<unsigned long long>(k)));
+#else
+    unsigned count = 0;
+    for (; k & 1; k >>= 1) {
+      ++count;
+    }
+    return count;
+#endif
+  }
+
+  const_iterator at_index(size_type k) const noexcept {
+    return k == 0 ? end() : values_ + ranks_[k];
+  }
+
+  // Все три массива выделяются до создания первого значения, а ранги заполняются до
+  // раскладки ключей, поэтому при исключении очистка видит только готовое состояние
+  template<typename InputIt>
+  void build(InputIt first, InputIt last, size_type count) {
+    if (count == 0) {
+      return;
+    }
+    RankAllocator rank_alloc(alloc_);
+    size_type placed = 0;
+    try {
+      values_ = ValueTraits::allocate(alloc_, count);
+      capacity_ = count;
+      keys_ = ValueTraits::allocate(alloc_, count + 1); // Ячейка 0 не используется
+      ranks_ = RankTraits::allocate(rank_alloc, count + 1);
+      for (; first != last && size_ < count; ++first, ++size_) {
+        ValueTraits::construct(alloc_, values_ + size_, *first);
+      }
+      size_type next = 0;
+      assign_ranks(1, next);
+      for (; placed < size_; ++placed) {
+        ValueTraits::construct(alloc_, keys_ + placed + 1, values_[ranks_[placed + 1]]);
+      }
+    } catch (...) {
+      destroy(placed);
+      throw;
+    }
+  }
+
+  // Нумерует узлы неявного дерева обходом в порядке InOrder: ranks_[k] - позиция ключа в values_
+  void assign_ranks(size_type k, size_type& next) noexcept {
+    if (k > size_) {
+      return;
+    }
+    assign_ranks(2 * k, next);
+    ranks_[k] = next++;
+    assign_ranks(2 * k + 1, next);
+  }
+
+  void destroy() noexcept {
+    destroy(size_);
+  }
+
+  // placed - сколько ключей уже создано в keys_, они занимают ячейки с 1 по placed
+  void destroy(size_type placed) noexcept {
+    if (keys_ != nullptr) {
+      for (size_type k = 1; k <= placed; ++k) {
+        ValueTraits::destroy(alloc_, keys_ + k);
+      }
+      ValueTraits::deallocate(alloc_, keys_, capacity_ + 1);
+    }
+    if (ranks_ != nullptr) {
+      RankAllocator rank_alloc(alloc_);
+      RankTraits::deallocate(rank_alloc, ranks_, capacity_ + 1);
+    }
+    if (values_ != nullptr) {
+      for (size_type i = 0; i < size_; ++i) {
+        ValueTraits::destroy(alloc_, values_ + i);
+      }
+      ValueTraits::deallocate(alloc_, values_, capacity_);
+    }
+    size_ = capacity_ = 0;
+    values_ = keys_ = nullptr;
+    ranks_ = nullptr;
+  }
+
+  allocator_type alloc_;
+  Compare comp_;
+  size_type size_ = 0;
+  size_type capacity_ = 0;       // Длина выделенных массивов, больше size_ при коротком диапазоне
+  value_type* values_ = nullptr; // Значения по возрастанию
+  value_type* keys_ = nullptr;   // Те же значения в порядке Эйтцингера, индексы с 1
+  size_type* ranks_ = nullptr;   // Позиция ключа keys_[k] в values_
+};
@@ -0,0 +1,465 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "binary_io.h"
+#include "bst.h"
+
+// Дерево с журналом упреждающей записи. Tree - BinarySearchTree с любой балансировкой.
+// Каждое изменение (insert, erase) сразу применяется к дереву в памяти и дописывается в журнал
+// <path>.log компактной записью: операция, значение в формате BinarySerializer и контрольная
+// сумма. Записи копятся в памяти и уходят на диск группой - одной записью в файл и одним
+// fdatasync в commit, который вызывается сам после group_size изменений. Изменения после
+// последнего commit при сбое теряются, остальные восстанавливаются. Если commit не удался,
+// частично записанная группа отрезается от журнала, и повторный commit пишет ее заново.
+// checkpoint() сохраняет снимок дерева в <path>.snapshot (через временный файл и rename,
+// поэтому старый снимок остается целым до появления нового) и очищает журнал.
+// При открытии загружается последний снимок, а хвост журнала до первой поврежденной записи
+// применяется к нему одним построением за O(n + k log k) через assign_sorted, без вставок по одному.
+template<typename Tree>
+class LoggedTree {
+ public:
+  using value_type = typename Tree::value_type;
+  using size_type = typename Tree::size_type;
+  using tree_type = Tree;
+
+  static constexpr size_type kDefaultGroupSize = 64;
+
+ private:
+  using Serializer = BinarySerializer<value_type>;
+
+  static constexpr char kLogMagic[5] = "BSTL";
+  static constexpr unsigned char kInsert = 1;
+  static constexpr unsigned char kErase = 2;
+  // Запись журнала: операция, длина значения, значение, контрольная сумма первых трех полей
+  static constexpr std::size_t kRecordHeaderBytes = 1 + sizeof(std::uint32_t);
+
+  // Операция из журнала при восстановлении
+  struct Entry {
+    value_type value;
+    bool erase;
+  };
+
+  using EntryAllocator =
+      typename std::allocator_traits<typename Tree::allocator_type>::template rebind_alloc<Entry>;
+  using EntryTraits = std::allocator_traits<EntryAllocator>;
+  using ValueAllocator =
+      typename std::allocator_traits<typename Tree::allocator_type>::template rebind_alloc<value_type>;
+  using ValueTraits = std::allocator_traits<ValueAllocator>;
+
+ public:
+  // Открывает или создает дерево с файлами <path>.snapshot и <path>.log и восстанавливает
+  // состояние на момент последнего commit. tree задает компаратор и аллокатор, его содержимое
+  // заменяется восстановленным.
+  explicit LoggedTree(const std::string& path, size_type group_size = kDefaultGroupSize, Tree tree = Tree())
+      : tree_(std::move(tree)), snapshot_path_(path + ".snapshot"), log_path_(path + ".log"),
+        group_size_(group_size) {
+    recover();
+  }
+
+  LoggedTree(const LoggedTree&) = delete;
+  LoggedTree& operator=(const LoggedTree&) = delete;
+
+  ~LoggedTree() {
+    try {
+      commit();
+    } catch (...) {
+      // Об ошибке записи сообщает только явный commit
+    }
+    if (log_fd_ >= 0) {
+      ::close(log_fd_);
+    }
+  }
+
+  bool insert(const value_type& value) {
+    bool inserted = tree_.insert(value).second;
+    if (inserted) {
+      append(kInsert, value);
+    }
+    return inserted;
+  }
+
+  size_type erase(const value_type& value) {
+    size_type erased = tree_.erase(value);
+    if (erased != 0) {
+      append(kErase, value);
+    }
+    return erased;
+  }
+
+  // Записывает накопленные изменения в журнал и дожидается их попадания на диск.
+  // При ошибке изменения остаются в очереди, а журнал укорачивается до последнего успешного
+  // commit: иначе повтор дописал бы группу после оборванных байтов, и восстановление
+  // остановилось бы на них.
+  void commit() {
+    if (pending_.empty()) {
+      return;
+    }
+    if (committed_bytes_ == 0) {
+      resetLog(); // Прошлая очистка журнала не успела записать заголовок
+    } else if (torn_) {
+      truncateLog();
+    }
+    try {
+      writeAll(log_fd_, pending_.data(), pending_.size());
+      if (::fdatasync(log_fd_) != 0) {
+        throw std::system_error(errno, std::generic_category(), "LoggedTree: fdatasync");
+      }
+    } catch (...) {
+      torn_ = true;
+      try {
+        truncateLog();
+      } catch (...) {
+        // Журнал останется оборванным до следующего commit, который повторит усечение
+      }
+      throw;
+    }
+    committed_bytes_ += pending_.size();
+    pending_.clear();
+    pending_records_ = 0;
+  }
+
+  // Сохраняет снимок дерева и начинает журнал заново
+  void checkpoint() {
+    commit();
+    std::uint64_t generation = generation_ + 1;
+    std::string temp_path = snapshot_path_ + ".tmp";
+    {
+      std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+      if (!out) {
+        throw std::system_error(errno, std::generic_category(), "LoggedTree: cannot create snapshot");
+      }
+      BinaryFormat::writeNumber(out, generation);
+      tree_.save(out);
+      out.close();
+      if (!out) {
+        throw std::ios_base::failure("LoggedTree: snapshot write failed");
+      }
+    }
+    syncPath(temp_path.c_str(), O_RDONLY);
+    if (std::rename(temp_path.c_str(), snapshot_path_.c_str()) != 0) {
+      throw std::system_error(errno, std::generic_category(), "LoggedTree: rename");
+    }
+    syncPath(directoryOf(snapshot_path_).c_str(), O_RDONLY | O_DIRECTORY);
+    // Снимок уже новый: журнал прежнего поколения при сбое дальше будет отброшен
+    generation_ = generation;
+    resetLog();
+  }
+
+  const Tree& tree() const noexcept {
+    return tree_;
+  }
+
+  bool contains(const value_type& value) const {
+    return tree_.contains(value);
+  }
+
+  size_type size() const noexcept {
+    return tree_.size();
+  }
+
+  bool empty() const noexcept {
+    return tree_.empty();
+  }
+
+  // Изменения, еще не записанные на диск
+  size_type pending() const noexcept {
+    return pending_records_;
+  }
+
+ private:
+  // FNV-1a: достаточно, чтобы отличить оборванную или недописанную запись
+  static std::uint32_t checksum(const unsigned char* data, std::size_t bytes) noexcept {
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < bytes; ++i) {
+      hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+  }
+
+  void append(unsigned char op, const value_type& value) {
+    std::size_t start = pending_.size();
+    pending_.push_back(static_cast<char>(op));
+    pending_.append(sizeof(std::uint32_t), '\0');
+    if constexpr (Serializer::kRaw) {
+      pending_.append(reinterpret_cast<const char*>(std::addressof(value)), sizeof(value_type));
+    } else {
+      std::ostringstream out;
+      Serializer::write(out, value);
+      pending_ += out.str();
+    }
+    auto* record = reinterpret_cast<unsigned char*>(&pending_[start]);
+    std::uint32_t length = static_cast<std::uint32_t>(pending_.size() - start - kRecordHeaderBytes);
+    BinaryFormat::storeNumber(record + 1, length);
+    std::uint32_t sum = checksum(record, pending_.size() - start);
+    pending_.append(reinterpret_cast<const char*>(&sum), sizeof(sum));
+    if (++pending_records_ >= group_size_) {
+      commit();
+    }
+  }
+
+  static void writeAll(int fd, const char* data, std::size_t bytes) {
+    while (bytes != 0) {
+      ssize_t written = ::write(fd, data, bytes);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written < 0) {
+        throw std::system_error(errno, std::generic_category(), "LoggedTree: write");
+      }
+      data += written;
+      bytes -= static_cast<std::size_t>(written);
+    }
+  }
+
+  // Отрезает от журнала все, что дописано после последнего успешного commit
+  void truncateLog() {
+    if (::ftruncate(log_fd_, static_cast<off_t>(committed_bytes_)) != 0) {
+      throw std::system_error(errno, std::generic_category(), "LoggedTree: ftruncate");
+    }
+    torn_ = false;
+  }
+
+  static void syncPath(const char* path, int flags) {
+    int fd = ::open(path, flags | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "LoggedTree: open");
+    }
+    int result = ::fsync(fd);
+    int error = errno;
+    ::close(fd);
+    if (result != 0) {
+      throw std::system_error(error, std::generic_category(), "LoggedTree: fsync");
+    }
+  }
+
+  static std::string directoryOf(const std::string& path) {
+    std::size_t slash = path.rfind('/');
+    if (slash == std::string::npos) {
+      return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+  }
+
+  // Журнал с одним заголовком текущего поколения; пока заголовок не записан, committed_bytes_ == 0
+  void resetLog() {
+    if (log_fd_ < 0) {
+      log_fd_ = ::open(log_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+      if (log_fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "LoggedTree: open log");
+      }
+      // Файл мог быть только что создан: без записи каталога подтвержденные записи теряются вместе с ним
+      try {
+        syncPath(directoryOf(log_path_).c_str(), O_RDONLY | O_DIRECTORY);
+      } catch (...) {
+        ::close(log_fd_);
+        log_fd_ = -1; // Следующая попытка откроет журнал и синхронизирует каталог заново
+        throw;
+      }
+    }
+    committed_bytes_ = 0;
+    truncateLog();
+    unsigned char header[BinaryFormat::kHeaderBytes];
+    BinaryFormat::writeHeader(header, kLogMagic, BinaryFormat::headerFor<value_type>(generation_));
+    writeAll(log_fd_, reinterpret_cast<const char*>(header), sizeof(header));
+    if (::fdatasync(log_fd_) != 0) {
+      throw std::system_error(errno, std::generic_category(), "LoggedTree: fdatasync");
+    }
+    committed_bytes_ = sizeof(header);
+  }
+
+  void recover() {
+    generation_ = 0;
+    std::ifstream snapshot(snapshot_path_, std::ios::binary);
+    if (snapshot) {
+      generation_ = BinaryFormat::readNumber<std::uint64_t>(snapshot);
+      tree_.load(snapshot);
+    } else {
+      tree_.clear();
+    }
+
+    std::ifstream log(log_path_, std::ios::binary);
+    std::uint64_t valid_bytes = 0;
+    if (log) {
+      unsigned char header_bytes[BinaryFormat::kHeaderBytes];
+      if (log.read(reinterpret_cast<char*>(header_bytes), sizeof(header_bytes))) {
+        BinaryFormat::Header header = BinaryFormat::readHeader(header_bytes, sizeof(header_bytes), kLogMagic);
+        if (!BinaryFormat::matches<value_type>(header) || header.count > generation_) {
+          throw FormatError("LoggedTree: log does not belong to the snapshot");
+        }
+        // Журнал прежнего поколения уже вошел в снимок
+        if (header.count == generation_) {
+          valid_bytes = replay(log);
+        }
+      }
+      // Заголовок оборван: сбой пришелся на очистку журнала, записей в нем нет
+    }
+    log.close();
+    if (valid_bytes == 0) {
+      resetLog();
+      return;
+    }
+    // Поврежденный хвост - недописанная группа - отрезается
+    log_fd_ = ::open(log_path_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (log_fd_ < 0) {
+      throw std::system_error(errno, std::generic_category(), "LoggedTree: open log");
+    }
+    committed_bytes_ = valid_bytes;
+    truncateLog();
+  }
+
+  // Читает одну запись; false, если запись оборвана или повреждена
+  static bool readRecord(std::istream& in, std::string& record) {
+    char header[kRecordHeaderBytes];
+    if (!in.read(header, sizeof(header))) {
+      return false;
+    }
+    std::uint32_t length = BinaryFormat::loadNumber<std::uint32_t>(reinterpret_cast<unsigned char*>(header) + 1);
+    if (header[0] != kInsert && header[0] != kErase) {
+      return false;
+    }
+    if constexpr (Serializer::kRaw) {
+      if (length != sizeof(value_type)) {
+        return false;
+      }
+    }
+    record.assign(header, sizeof(header));
+    // Длина может быть повреждена, поэтому читаем частями и останавливаемся на конце файла
+    constexpr std::uint32_t kChunk = 4096;
+    char buffer[kChunk];
+    for (std::uint32_t left = length; left != 0;) {
+      std::uint32_t part = std::min(left, kChunk);
+      if (!in.read(buffer, part)) {
+        return false;
+      }
+      record.append(buffer, part);
+      left -= part;
+    }
+    std::uint32_t stored;
+    if (!in.read(reinterpret_cast<char*>(&stored), sizeof(stored))) {
+      return false;
+    }
+    return stored == checksum(reinterpret_cast<const unsigned char*>(record.data()), record.size());
+  }
+
+  static value_type decode(const std::string& record) {
+    if constexpr (Serializer::kRaw) {
+      return BinaryFormat::loadNumber<value_type>(
+          reinterpret_cast<const unsigned char*>(record.data()) + kRecordHeaderBytes);
+    } else {
+      std::istringstream in(record.substr(kRecordHeaderBytes));
+      return Serializer::read(in);
+    }
+  }
+
+  // Применяет записи журнала после заголовка к загруженному снимку; возвращает длину
+  // неповрежденной части журнала
+  std::uint64_t replay(std::istream& log) {
+    std::uint64_t valid_bytes = BinaryFormat::kHeaderBytes;
+    size_type count = 0;
+    std::string record;
+    // Первый проход: сколько записей целы
+    while (readRecord(log, record)) {
+      valid_bytes += record.size() + sizeof(std::uint32_t);
+      ++count;
+    }
+    if (count == 0) {
+      return valid_bytes;
+    }
+    log.clear();
+    log.seekg(BinaryFormat::kHeaderBytes);
+
+    EntryAllocator entry_allocator(tree_.get_allocator());
+    ValueAllocator value_allocator(tree_.get_allocator());
+    Entry* entries = EntryTraits::allocate(entry_allocator, count);
+    size_type total = tree_.size() + count;
+    value_type* merged = nullptr;
+    size_type constructed = 0;
+    size_type produced = 0;
+    auto release = [&]() noexcept {
+      for (size_type i = 0; i < constructed; ++i) {
+        EntryTraits::destroy(entry_allocator, entries + i);
+      }
+      EntryTraits::deallocate(entry_allocator, entries, count);
+      if (merged != nullptr) {
+        for (size_type i = 0; i < produced; ++i) {
+          ValueTraits::destroy(value_allocator, merged + i);
+        }
+        ValueTraits::deallocate(value_allocator, merged, total);
+      }
+    };
+    try {
+      for (; constructed < count; ++constructed) {
+        readRecord(log, record);
+        EntryTraits::construct(entry_allocator, entries + constructed,
+                               Entry{decode(record), record[0] == kErase});
+      }
+      // Для каждого значения важна только последняя операция: устойчивая сортировка
+      // сохраняет порядок журнала среди равных, последняя из них - итог
+      auto comp = tree_.value_comp();
+      std::stable_sort(entries, entries + count,
+                       [&comp](const Entry& lhs, const Entry& rhs) { return comp(lhs.value, rhs.value); });
+      size_type last = 0;
+      for (size_type i = 0; i < count; ++i) {
+        if (i + 1 < count && !comp(entries[i].value, entries[i + 1].value)) {
+          continue;
+        }
+        if (last != i) {
+          entries[last] = std::move(entries[i]);
+        }
+        ++last;
+      }
+
+      // Слияние снимка с итоговыми операциями в отсортированный массив без повторов
+      merged = ValueTraits::allocate(value_allocator, total);
+      auto it = tree_.template begin<InOrder>();
+      auto end = tree_.template end<InOrder>();
+      for (size_type i = 0; i < last || it != end;) {
+        if (i == last || (it != end && comp(*it, entries[i].value))) {
+          ValueTraits::construct(value_allocator, merged + produced++, *it);
+          ++it;
+          continue;
+        }
+        if (it != end && !comp(entries[i].value, *it)) {
+          ++it; // Значение из снимка заменяется результатом операции
+        }
+        if (!entries[i].erase) {
+          ValueTraits::construct(value_allocator, merged + produced++, std::move(entries[i].value));
+        }
+        ++i;
+      }
+      tree_.assign_sorted(std::make_move_iterator(merged), std::make_move_iterator(merged + produced));
+    } catch (...) {
+      release();
+      throw;
+    }
+    release();
+    return valid_bytes;
+  }
+
+  Tree tree_;
+  std::string snapshot_path_;
+  std::string log_path_;
+  size_type group_size_;
+  std::uint64_t generation_ = 0; // Номер последнего снимка; журнал несет тот же номер
+  int log_fd_ = -1;
+  std::string pending_; // Записи, еще не отданные в файл
+  size_type pending_records_ = 0;
+  std::uint64_t committed_bytes_ = 0; // Длина журнала после последнего успешного commit
+  bool torn_ = false; // За committed_bytes_ в журнале могут быть байты неудачной записи
+};
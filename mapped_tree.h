@@ -0,0 +1,500 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <ostream>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binary_io.h"
+#include "bst.h"
+
+// Неизменяемое множество, читаемое прямо из отображенного в память файла (POSIX mmap).
+// Файл записывает MappedTree::write: заголовок BinaryFormat, индекс корня и узлы
+// сбалансированного дерева поиска (той же формы, что и у assign_sorted) в порядке возрастания.
+// Узел - значение и индексы левого, правого потомков и родителя вместо указателей, поэтому
+// файл не зависит от адреса отображения. Открытие проверяет только заголовок и размер файла и
+// занимает O(1) независимо от числа элементов; страницы подгружаются по мере обращения и
+// отображаются только для чтения, поэтому процессы, открывшие один файл, делят кэш страниц.
+// Содержимое узлов не проверяется: файл должен быть записан write.
+// T должен быть тривиально копируемым.
+template<typename T, typename Compare = std::less<T>>
+class MappedTree {
+  static_assert(std::is_trivially_copyable_v<T>, "MappedTree stores values as raw bytes");
+  static_assert(alignof(T) <= 64, "MappedTree aligns nodes to at most 64 bytes");
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using const_reference = const value_type&;
+  using key_type = T;
+  using key_compare = Compare;
+  using value_compare = Compare;
+
+ private:
+  using Index = std::uint64_t;
+
+  static constexpr char kFormatMagic[5] = "BSTM";
+  static constexpr Index kNone = ~Index(0);
+  // Раскладка файла: заголовок, индекс корня, выравнивание до kDataOffset, затем узлы с шагом
+  // kStride: значение с нулевого смещения и три индекса с kLinksOffset
+  static constexpr size_type kDataOffset = 64;
+  static constexpr size_type kAlign = alignof(T) > alignof(Index) ? alignof(T) : alignof(Index);
+  static constexpr size_type kLinksOffset = (sizeof(T) + alignof(Index) - 1) / alignof(Index) * alignof(Index);
+  static constexpr size_type kStride = (kLinksOffset + 3 * sizeof(Index) + kAlign - 1) / kAlign * kAlign;
+
+  // Узлы в отображении; итераторы хранят его копию и не зависят от объекта дерева
+  struct View {
+    const unsigned char* nodes = nullptr;
+    Index root = kNone;
+    Index count = 0;
+
+    const T& value(Index node) const noexcept {
+      return *std::launder(reinterpret_cast<const T*>(nodes + node * kStride));
+    }
+
+    const Index* links(Index node) const noexcept {
+      return std::launder(reinterpret_cast<const Index*>(nodes + node * kStride + kLinksOffset));
+    }
+
+    Index left(Index node) const noexcept {
+      return links(node)[0];
+    }
+
+    Index right(Index node) const noexcept {
+      return links(node)[1];
+    }
+
+    Index parent(Index node) const noexcept {
+      return links(node)[2];
+    }
+
+    Index firstPostOrder(Index node) const noexcept {
+      while (node != kNone && (left(node) != kNone || right(node) != kNone)) {
+        node = left(node) != kNone ? left(node) : right(node);
+      }
+      return node;
+    }
+
+    Index lastPreOrder(Index node) const noexcept {
+      while (node != kNone && (left(node) != kNone || right(node) != kNone)) {
+        node = right(node) != kNone ? right(node) : left(node);
+      }
+      return node;
+    }
+  };
+
+ public:
+  // Узлы лежат по возрастанию, поэтому InOrder - просто сдвиг индекса;
+  // PreOrder и PostOrder идут по индексам потомков и родителя
+  template<typename Order>
+  class const_iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = const T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator() = default;
+
+    const_iterator& operator++() {
+      increment(Order());
+      return *this;
+    }
+
+    const_iterator& operator--() {
+      decrement(Order());
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator result = *this;
+      --*this;
+      return result;
+    }
+
+    reference operator*() const {
+      return view_.value(index_);
+    }
+
+    pointer operator->() const {
+      return &view_.value(index_);
+    }
+
+    // Индексы сравнимы только внутри одного отображения
+    bool operator==(const const_iterator& other) const {
+      return view_.nodes == other.view_.nodes && index_ == other.index_;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class MappedTree;
+
+    const_iterator(const View& view, Index index) : view_(view), index_(index) {}
+
+    void increment(InOrder) {
+      index_ = index_ + 1 < view_.count ? index_ + 1 : kNone;
+    }
+
+    void decrement(InOrder) {
+      index_ = index_ != kNone ? index_ - 1 : view_.count - 1;
+      if (index_ >= view_.count) {
+        index_ = kNone; // Шаг назад от begin или от end пустого дерева
+      }
+    }
+
+    void increment(PreOrder) {
+      if (index_ == kNone) {
+        return;
+      }
+      if (view_.left(index_) != kNone) {
+        index_ = view_.left(index_);
+        return;
+      }
+      if (view_.right(index_) != kNone) {
+        index_ = view_.right(index_);
+        return;
+      }
+      Index parent = view_.parent(index_);
+      while (parent != kNone && (index_ == view_.right(parent) || view_.right(parent) == kNone)) {
+        index_ = parent;
+        parent = view_.parent(parent);
+      }
+      index_ = parent != kNone ? view_.right(parent) : kNone;
+    }
+
+    void decrement(PreOrder) {
+      if (index_ == kNone) {
+        index_ = view_.lastPreOrder(view_.root);
+        return;
+      }
+      Index parent = view_.parent(index_);
+      if (parent != kNone && index_ == view_.right(parent) && view_.left(parent) != kNone) {
+        index_ = view_.lastPreOrder(view_.left(parent));
+      } else {
+        index_ = parent;
+      }
+    }
+
+    void increment(PostOrder) {
+      if (index_ == kNone) {
+        return;
+      }
+      Index parent = view_.parent(index_);
+      if (parent != kNone && index_ == view_.left(parent) && view_.right(parent) != kNone) {
+        index_ = view_.firstPostOrder(view_.right(parent));
+      } else {
+        index_ = parent;
+      }
+    }
+
+    void decrement(PostOrder) {
+      if (index_ == kNone) {
+        index_ = view_.root;
+        return;
+      }
+      if (view_.right(index_) != kNone) {
+        index_ = view_.right(index_);
+        return;
+      }
+      if (view_.left(index_) != kNone) {
+        index_ = view_.left(index_);
+        return;
+      }
+      Index parent = view_.parent(index_);
+      while (parent != kNone && (index_ == view_.left(parent) || view_.left(parent) == kNone)) {
+        index_ = parent;
+        parent = view_.parent(parent);
+      }
+      index_ = parent != kNone ? view_.left(parent) : kNone;
+    }
+
+    View view_;
+    Index index_ = kNone;
+  };
+
+  MappedTree() = default;
+
+  // Отображает файл, записанный write. Ошибки открытия - std::system_error,
+  // неверный заголовок или размер файла - FormatError.
+  explicit MappedTree(const char* path, const Compare& comp = Compare()) : comp_(comp) {
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "MappedTree: open");
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+      int error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), "MappedTree: fstat");
+    }
+    mapped_bytes_ = static_cast<size_type>(info.st_size);
+    void* data = mapped_bytes_ != 0 ? ::mmap(nullptr, mapped_bytes_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    int error = errno;
+    ::close(fd); // Отображение держит файл само
+    if (data == MAP_FAILED) {
+      mapped_bytes_ = 0;
+      if (info.st_size == 0) {
+        throw FormatError("MappedTree: empty file");
+      }
+      throw std::system_error(error, std::generic_category(), "MappedTree: mmap");
+    }
+    data_ = static_cast<const unsigned char*>(data);
+    try {
+      attach();
+    } catch (...) {
+      unmap();
+      throw;
+    }
+  }
+
+  MappedTree(const MappedTree&) = delete;
+
+  MappedTree(MappedTree&& other) noexcept
+      : comp_(other.comp_), data_(other.data_), mapped_bytes_(other.mapped_bytes_), view_(other.view_) {
+    other.data_ = nullptr;
+    other.mapped_bytes_ = 0;
+    other.view_ = View();
+  }
+
+  MappedTree& operator=(MappedTree other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~MappedTree() {
+    unmap();
+  }
+
+  void swap(MappedTree& other) noexcept {
+    using std::swap;
+    swap(comp_, other.comp_);
+    swap(data_, other.data_);
+    swap(mapped_bytes_, other.mapped_bytes_);
+    swap(view_, other.view_);
+  }
+
+  // Записывает отсортированный диапазон без повторов из count элементов в формате для
+  // отображения. Узлы пишутся по возрастанию, индексы потомков вычисляются по форме дерева.
+  template<typename InputIt>
+  static void write(std::ostream& out, InputIt first, size_type count) {
+    BinaryFormat::writeHeader(out, kFormatMagic, BinaryFormat::headerFor<T>(count));
+    Index root = count != 0 ? count / 2 : kNone;
+    unsigned char padding[kDataOffset - BinaryFormat::kHeaderBytes] = {};
+    std::memcpy(padding, &root, sizeof(root));
+    BinaryFormat::writeBytes(out, padding, sizeof(padding));
+    writeSubtree(out, first, 0, count, kNone);
+  }
+
+  // Поиск: K - value_type или тип, сравнимый с ним через Compare
+  template<typename K>
+  const_iterator<InOrder> find(const K& key) const {
+    Index node = lowerBoundIndex(key);
+    if (node != kNone && comp_(key, view_.value(node))) {
+      node = kNone;
+    }
+    return const_iterator<InOrder>(view_, node);
+  }
+
+  template<typename K>
+  bool contains(const K& key) const {
+    return find(key) != end<InOrder>();
+  }
+
+  template<typename K>
+  size_type count(const K& key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  template<typename K>
+  const_iterator<InOrder> lower_bound(const K& key) const {
+    return const_iterator<InOrder>(view_, lowerBoundIndex(key));
+  }
+
+  template<typename K>
+  const_iterator<InOrder> upper_bound(const K& key) const {
+    Index node = view_.root;
+    Index result = kNone;
+    while (node != kNone) {
+      if (comp_(key, view_.value(node))) {
+        result = node;
+        node = view_.left(node);
+      } else {
+        node = view_.right(node);
+      }
+    }
+    return const_iterator<InOrder>(view_, result);
+  }
+
+  template<typename K>
+  std::pair<const_iterator<InOrder>, const_iterator<InOrder>> equal_range(const K& key) const {
+
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  // Количество элементов, строго меньших value
+  template<typename K>
+  size_type rank(const K& key) const {
+    Index node = lowerBoundIndex(key);
+
+    return node != kNone ? static_cast<size_type>(node) : size();
+  }
+
+  // k-й по возрастанию элемент (с нуля) или end, если k >= size()
+  const_iterator<InOrder> select(size_type k) const {
+
+    return const_iterator<InOrder>(view_, k < size() ? Index(k) : kNone);
+  }
+
+  template<typename Order>
+  const_iterator<Order> begin() const {
+    if constexpr (std::is_same_v<Order, InOrder>) {
+      return const_iterator<Order>(view_, view_.count != 0 ? 0 : kNone);
+    } else if constexpr (std::is_same_v<Order, PreOrder>) {
+      return const_iterator<Order>(view_, view_.root);
+    } else {
+      return const_iterator<Order>(view_, view_.firstPostOrder(view_.root));
+    }
+  }
+
+  template<typename Order>
+  const_iterator<Order> end() const {
+
+    return const_iterator<Order>(view_, kNone);
+  }
+
+  template<typename Order>
+  const_iterator<Order> cbegin() const {
+
+    return begin<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> cend() const {
+
+    return end<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> rbegin() const {
+    const_iterator<Order> it = end<Order>();
+    --it;
+
+    return it;
+  }
+
+  template<typename Order>
+  const_iterator<Order> rend() const {
+
+    return end<Order>();
+  }
+
+  bool empty() const noexcept {
+    return view_.count == 0;
+  }
+
+  size_type size() const noexcept {
+    return static_cast<size_type>(view_.count);
+  }
+
+  key_compare key_comp() const {
+
+    return comp_;
+  }
+
+  value_compare value_comp() const {
+
+    return comp_;
+  }
+
+ private:
+  // Пишет поддерево из count узлов с индексами [first_index, first_index + count) в порядке
+  // возрастания; корень поддерева - средний, как в buildFromList. Глубина рекурсии O(log n).
+  template<typename InputIt>
+  static void writeSubtree(std::ostream& out, InputIt& it, Index first_index, Index count, Index parent) {
+    if (count == 0) {
+      return;
+    }
+    Index left_count = count / 2;
+    Index right_count = count - left_count - 1;
+    Index node = first_index + left_count;
+    writeSubtree(out, it, first_index, left_count, node);
+    unsigned char record[kStride] = {};
+    Index links[3] = {left_count != 0 ? first_index + left_count / 2 : kNone,
+                      right_count != 0 ? node + 1 + right_count / 2 : kNone, parent};
+    const T& value = *it;
+    std::memcpy(record, std::addressof(value), sizeof(T));
+    std::memcpy(record + kLinksOffset, links, sizeof(links));
+    BinaryFormat::writeBytes(out, record, kStride);
+    ++it;
+    writeSubtree(out, it, node + 1, right_count, node);
+  }
+
+  template<typename K>
+  Index lowerBoundIndex(const K& key) const {
+    Index node = view_.root;
+    Index result = kNone;
+    while (node != kNone) {
+      if (comp_(view_.value(node), key)) {
+        node = view_.right(node);
+      } else {
+        result = node;
+        node = view_.left(node);
+      }
+    }
+    return result;
+  }
+
+  void attach() {
+    BinaryFormat::Header header = BinaryFormat::readHeader(data_, mapped_bytes_, kFormatMagic);
+    if (!BinaryFormat::matches<T>(header)) {
+      throw FormatError("MappedTree: stored values have a different type");
+    }
+    if (mapped_bytes_ < kDataOffset || header.count > (mapped_bytes_ - kDataOffset) / kStride
+        || mapped_bytes_ != kDataOffset + header.count * kStride) {
+      throw FormatError("MappedTree: file size does not match the element count");
+    }
+    Index root = BinaryFormat::loadNumber<Index>(data_ + BinaryFormat::kHeaderBytes);
+    if (header.count != 0 ? root >= header.count : root != kNone) {
+      throw FormatError("MappedTree: bad root index");
+    }
+    view_.nodes = data_ + kDataOffset;
+    view_.root = root;
+    view_.count = header.count;
+  }
+
+  void unmap() noexcept {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<unsigned char*>(data_), mapped_bytes_);
+      data_ = nullptr;
+      mapped_bytes_ = 0;
+    }
+  }
+
+  Compare comp_;
+  const unsigned char* data_ = nullptr;
+  size_type mapped_bytes_ = 0;
+  View view_;
+};
@@ -1,5 +1,34 @@
 #include <gtest/gtest.h>
 #include "bst.h"
+#include "btree.h"
+#include "compact_tree.h"
+#include "concurrent_tree.h"
+#include "disk_tree.h"
+#include "fine_grained_tree.h"
+#include "log_tree.h"
+#include "mapped_tree.h"
+#include "persistent_tree.h"
+#include "pool_allocator.h"
+
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/resource.h>
 
 
 // Тесты для метода begin
@@ -237,14 +266,14 @@ TEST(BinarySearchTreeTest, Extract_NonExistingElement) {
   bst.insert(20);
   auto it = bst.find(15);
   auto extracted = bst.extract(it);
-  EXPECT_EQ(extracted.get_node(), nullptr);
+  EXPECT_TRUE(extracted.empty());
 }
 
 TEST(BinarySearchTreeTest, Extract_FromEmptyTree) {
   BinarySearchTree<int> bst;
   auto it = bst.find(10);
   auto extracted = bst.extract(it);
-  EXPECT_EQ(extracted.get_node(), nullptr);
+  EXPECT_TRUE(extracted.empty());
 }
 
 TEST(BinarySearchTreeTest, Extract_SingleElement) {
@@ -252,7 +281,8 @@ TEST(BinarySearchTreeTest, Extract_SingleElement) {
   bst.insert(10);
   auto it = bst.find(10);
   auto extracted = bst.extract(it);
-  EXPECT_EQ(extracted.get_node(), nullptr);
+  EXPECT_FALSE(extracted.empty());
+  EXPECT_EQ(extracted.value(), 10);
   EXPECT_TRUE(bst.empty());
 }
 
@@ -459,4 +489,2645 @@ TEST(BinarySearchTreeTest, GetAllocator) {
   EXPECT_EQ(*ptr, 42);
   allocator.destroy(ptr);
   allocator.deallocate(ptr, 1);
-}
\ No newline at end of file
+}
+
+// Вспомогательные функции для проверки структуры сбалансированных деревьев
+template<typename Node>
+int SubtreeHeight(const Node* node) {
+  if (node == nullptr) {
+    return 0;
+  }
+  return 1 + std::max(SubtreeHeight(node->left), SubtreeHeight(node->right));
+}
+
+template<typename Node>
+bool ParentLinksValid(const Node* node) {
+  if (node == nullptr) {
+    return true;
+  }
+  if (node->left != nullptr && node->left->parent != node) {
+    return false;
+  }
+  if (node->right != nullptr && node->right->parent != node) {
+    return false;
+  }
+  return ParentLinksValid(node->left) && ParentLinksValid(node->right);
+}
+
+// Возвращает черную высоту поддерева или -1, если нарушены свойства красно-черного дерева
+template<typename Node>
+int RedBlackHeight(const Node* node) {
+  if (node == nullptr) {
+    return 1;
+  }
+  if (node->red && ((node->left && node->left->red) || (node->right && node->right->red))) {
+    return -1;
+  }
+  int left = RedBlackHeight(node->left);
+  int right = RedBlackHeight(node->right);
+  if (left < 0 || right < 0 || left != right) {
+    return -1;
+  }
+  return left + (node->red ? 0 : 1);
+}
+
+template<typename Node>
+bool AvlValid(const Node* node) {
+  if (node == nullptr) {
+    return true;
+  }
+  int left = SubtreeHeight(node->left);
+  int right = SubtreeHeight(node->right);
+  return node->height == 1 + std::max(left, right) && std::abs(left - right) <= 1
+      && AvlValid(node->left) && AvlValid(node->right);
+}
+
+template<typename Node>
+void CollectPreOrder(const Node* node, std::vector<int>& out) {
+  if (node != nullptr) {
+    out.push_back(node->value);
+    CollectPreOrder(node->left, out);
+    CollectPreOrder(node->right, out);
+  }
+}
+
+template<typename Node>
+void CollectPostOrder(const Node* node, std::vector<int>& out) {
+  if (node != nullptr) {
+    CollectPostOrder(node->left, out);
+    CollectPostOrder(node->right, out);
+    out.push_back(node->value);
+  }
+}
+
+template<typename Order, typename Tree>
+void ExpectReverseTraversal(const Tree& tree) {
+  std::vector<int> forward(tree.template begin<Order>(), tree.template end<Order>());
+  std::vector<int> backward;
+  auto it = tree.template end<Order>();
+  while (it != tree.template begin<Order>()) {
+    --it;
+    backward.push_back(*it);
+  }
+  std::reverse(backward.begin(), backward.end());
+  EXPECT_EQ(forward, backward);
+  EXPECT_EQ(forward.size(), tree.size());
+}
+
+using RedBlackTree = BinarySearchTree<int, std::less<int>, std::allocator<int>, RedBlackBalance>;
+using AvlTree = BinarySearchTree<int, std::less<int>, std::allocator<int>, AvlBalance>;
+
+// Тесты для политик балансировки
+TEST(BinarySearchTreeTest, RedBlack_SortedInsertStaysBalanced) {
+  RedBlackTree bst;
+  const int n = 10000;
+  for (int i = 0; i < n; ++i) {
+    bst.insert(i);
+  }
+  auto root = bst.begin<PreOrder>().get_node();
+  EXPECT_GT(RedBlackHeight(root), 0);
+  EXPECT_LE(SubtreeHeight(root), 2 * std::log2(n + 1));
+  EXPECT_TRUE(ParentLinksValid(root));
+  int expected = 0;
+  for (auto it = bst.begin<InOrder>(); it != bst.end<InOrder>(); ++it) {
+    EXPECT_EQ(*it, expected++);
+  }
+  EXPECT_EQ(expected, n);
+}
+
+TEST(BinarySearchTreeTest, Avl_SortedInsertStaysBalanced) {
+  AvlTree bst;
+  const int n = 10000;
+  for (int i = n; i > 0; --i) {
+    bst.insert(i);
+  }
+  auto root = bst.begin<PreOrder>().get_node();
+  EXPECT_TRUE(AvlValid(root));
+  EXPECT_LE(SubtreeHeight(root), 1.45 * std::log2(n + 2));
+  EXPECT_TRUE(ParentLinksValid(root));
+}
+
+TEST(BinarySearchTreeTest, RedBlack_RandomInsertErase) {
+  RedBlackTree bst;
+  std::set<int> reference;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(0, 500);
+  for (int i = 0; i < 5000; ++i) {
+    int value = dist(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(bst.erase(value), reference.erase(value));
+    } else if (reference.insert(value).second) {
+      bst.insert(value);
+    }
+  }
+  auto root = bst.begin<PreOrder>().get_node();
+  EXPECT_GT(RedBlackHeight(root), 0);
+  EXPECT_TRUE(ParentLinksValid(root));
+  std::vector<int> elements(bst.begin<InOrder>(), bst.end<InOrder>());
+  EXPECT_EQ(elements, std::vector<int>(reference.begin(), reference.end()));
+}
+
+TEST(BinarySearchTreeTest, Avl_RandomInsertErase) {
+  AvlTree bst;
+  std::set<int> reference;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> dist(0, 500);
+  for (int i = 0; i < 5000; ++i) {
+    int value = dist(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(bst.erase(value), reference.erase(value));
+    } else if (reference.insert(value).second) {
+      bst.insert(value);
+    }
+  }
+  auto root = bst.begin<PreOrder>().get_node();
+  EXPECT_TRUE(AvlValid(root));
+  EXPECT_TRUE(ParentLinksValid(root));
+  std::vector<int> elements(bst.begin<InOrder>(), bst.end<InOrder>());
+  EXPECT_EQ(elements, std::vector<int>(reference.begin(), reference.end()));
+}
+
+TEST(BinarySearchTreeTest, Balanced_PreAndPostOrderFollowShape) {
+  RedBlackTree bst;
+  for (int i = 0; i < 100; ++i) {
+    bst.insert(i);
+  }
+  bst.erase(50);
+  bst.erase(0);
+  auto root = bst.begin<PreOrder>().get_node();
+
+  std::vector<int> pre;
+  std::vector<int> post;
+  CollectPreOrder(root, pre);
+  CollectPostOrder(root, post);
+  EXPECT_EQ(std::vector<int>(bst.begin<PreOrder>(), bst.end<PreOrder>()), pre);
+  EXPECT_EQ(std::vector<int>(bst.begin<PostOrder>(), bst.end<PostOrder>()), post);
+}
+
+TEST(BinarySearchTreeTest, Extract_KeepsTreeBalanced) {
+  AvlTree bst;
+  for (int i = 1; i <= 7; ++i) {
+    bst.insert(i);
+  }
+  auto node = bst.extract(bst.find(4));
+  EXPECT_EQ(node.value(), 4);
+  EXPECT_FALSE(bst.exist(4));
+  EXPECT_TRUE(AvlValid(bst.begin<PreOrder>().get_node()));
+}
+
+// Тесты для размера и порядковой статистики
+TEST(BinarySearchTreeTest, Size_TracksInsertAndErase) {
+  BinarySearchTree<int> bst;
+  EXPECT_EQ(bst.size(), 0);
+  bst.insert(10);
+  bst.insert(5);
+  bst.insert(20);
+  EXPECT_EQ(bst.size(), 3);
+  bst.erase(5);
+  EXPECT_EQ(bst.size(), 2);
+  bst.extract(bst.find(10));
+  EXPECT_EQ(bst.size(), 1);
+  bst.clear();
+  EXPECT_EQ(bst.size(), 0);
+}
+
+TEST(BinarySearchTreeTest, Size_CopyKeepsCounts) {
+  RedBlackTree bst;
+  for (int i = 0; i < 50; ++i) {
+    bst.insert(i);
+  }
+  RedBlackTree copy(bst);
+  EXPECT_EQ(copy.size(), 50);
+  EXPECT_EQ(*copy.select(25), 25);
+  EXPECT_GT(RedBlackHeight(copy.begin<PreOrder>().get_node()), 0);
+}
+
+TEST(BinarySearchTreeTest, Rank_CountsSmallerElements) {
+  BinarySearchTree<int> bst;
+  bst.insert(10);
+  bst.insert(5);
+  bst.insert(20);
+  EXPECT_EQ(bst.rank(1), 0);
+  EXPECT_EQ(bst.rank(5), 0);
+  EXPECT_EQ(bst.rank(10), 1);
+  EXPECT_EQ(bst.rank(15), 2);
+  EXPECT_EQ(bst.rank(25), 3);
+}
+
+TEST(BinarySearchTreeTest, Select_ReturnsKthElement) {
+  AvlTree bst;
+  for (int i = 0; i < 100; ++i) {
+    bst.insert(i * 2);
+  }
+  for (int k = 0; k < 100; ++k) {
+    EXPECT_EQ(*bst.select(k), k * 2);
+  }
+  EXPECT_EQ(*bst.nth(10), 20);
+  EXPECT_EQ(bst.select(100), bst.end<InOrder>());
+}
+
+TEST(BinarySearchTreeTest, Select_EmptyTree) {
+  BinarySearchTree<int> bst;
+  EXPECT_EQ(bst.select(0).get_node(), nullptr);
+}
+
+TEST(BinarySearchTreeTest, CountRange_HalfOpenInterval) {
+  BinarySearchTree<int> bst;
+  for (int i = 1; i <= 10; ++i) {
+    bst.insert(i);
+  }
+  EXPECT_EQ(bst.count_range(3, 7), 4);
+  EXPECT_EQ(bst.count_range(0, 100), 10);
+  EXPECT_EQ(bst.count_range(7, 3), 0);
+  EXPECT_EQ(bst.count_range(5, 5), 0);
+}
+
+TEST(BinarySearchTreeTest, OrderStatistics_RandomOperations) {
+  RedBlackTree bst;
+  std::set<int> reference;
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> dist(0, 1000);
+  for (int i = 0; i < 3000; ++i) {
+    int value = dist(gen);
+    if (gen() % 3 == 0) {
+      bst.erase(value);
+      reference.erase(value);
+    } else if (reference.insert(value).second) {
+      bst.insert(value);
+    }
+  }
+  ASSERT_EQ(bst.size(), reference.size());
+  size_t k = 0;
+  for (int value : reference) {
+    EXPECT_EQ(bst.rank(value), k);
+    EXPECT_EQ(*bst.select(k), value);
+    ++k;
+  }
+}
+
+// Тесты для PoolAllocator
+using PooledTree = BinarySearchTree<int, std::less<int>, PoolAllocator<int>, RedBlackBalance>;
+
+TEST(PoolAllocatorTest, TreeOperations) {
+  PooledTree bst;
+  for (int i = 0; i < 1000; ++i) {
+    bst.insert(i);
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    EXPECT_EQ(bst.erase(i), 1);
+  }
+  EXPECT_EQ(bst.size(), 500);
+  EXPECT_EQ(*bst.begin<InOrder>(), 1);
+  EXPECT_GT(RedBlackHeight(bst.begin<PreOrder>().get_node()), 0);
+}
+
+TEST(PoolAllocatorTest, ErasedNodeIsRecycled) {
+  PooledTree bst;
+  bst.insert(1);
+  bst.insert(2);
+  const void* erased = bst.find(2).get_node();
+  bst.erase(2);
+  bst.insert(3);
+  EXPECT_EQ(bst.find(3).get_node(), erased);
+}
+
+TEST(PoolAllocatorTest, NodesComeFromSlabs) {
+  PooledTree bst(PoolAllocator<int>(64));
+  for (int i = 0; i < 200; ++i) {
+    bst.insert(i);
+  }
+  EXPECT_EQ(bst.get_allocator().slab_count(), 4);
+}
+
+TEST(PoolAllocatorTest, ClearReleasesSlabs) {
+  PooledTree bst(PoolAllocator<int>(64));
+  for (int i = 0; i < 200; ++i) {
+    bst.insert(i);
+  }
+  bst.clear();
+  EXPECT_TRUE(bst.empty());
+  EXPECT_EQ(bst.get_allocator().slab_count(), 0);
+  bst.insert(5);
+  EXPECT_TRUE(bst.contains(5));
+}
+
+TEST(PoolAllocatorTest, SharedPoolIsNotReleased) {
+  PoolAllocator<int> alloc(16);
+  PooledTree first(alloc);
+  PooledTree second(alloc);
+  first.insert(1);
+  second.insert(2);
+  first.clear();
+  EXPECT_TRUE(second.contains(2));
+  EXPECT_EQ(alloc.slab_count(), 1);
+}
+
+TEST(PoolAllocatorTest, NonTrivialValues) {
+  BinarySearchTree<std::string, std::less<std::string>, PoolAllocator<std::string>> bst;
+  bst.insert("b");
+  bst.insert("a");
+  bst.insert("c");
+  bst.erase("a");
+  EXPECT_EQ(*bst.begin<InOrder>(), "b");
+  bst.clear();
+  EXPECT_TRUE(bst.empty());
+}
+
+TEST(PoolAllocatorTest, RebindSharesPool) {
+  PoolAllocator<int> alloc;
+  PoolAllocator<double> rebound(alloc);
+  EXPECT_TRUE(alloc == rebound);
+  EXPECT_FALSE(alloc == PoolAllocator<int>());
+  double* p = rebound.allocate(1);
+  rebound.deallocate(p, 1);
+  int* array = alloc.allocate(10);
+  alloc.deallocate(array, 10);
+}
+
+// Тесты для построения из отсортированного диапазона
+TEST(BinarySearchTreeTest, SortedConstructor_BuildsBalancedTree) {
+  std::vector<int> values(1000);
+  for (int i = 0; i < 1000; ++i) {
+    values[i] = i * 3;
+  }
+  RedBlackTree bst(SortedUnique(), values.begin(), values.end());
+  auto root = bst.begin<PreOrder>().get_node();
+  EXPECT_EQ(bst.size(), 1000);
+  EXPECT_GT(RedBlackHeight(root), 0);
+  EXPECT_EQ(SubtreeHeight(root), 10);
+  EXPECT_TRUE(ParentLinksValid(root));
+  EXPECT_EQ(std::vector<int>(bst.begin<InOrder>(), bst.end<InOrder>()), values);
+  EXPECT_EQ(*--bst.end<InOrder>(), 2997);
+}
+
+TEST(BinarySearchTreeTest, SortedConstructor_TreeStaysUsable) {
+  std::vector<int> values = {1, 2, 3, 4, 5, 6};
+  AvlTree bst(SortedUnique(), values.begin(), values.end());
+  EXPECT_TRUE(AvlValid(bst.begin<PreOrder>().get_node()));
+  bst.insert(7);
+  bst.erase(1);
+  EXPECT_TRUE(AvlValid(bst.begin<PreOrder>().get_node()));
+  EXPECT_EQ(std::vector<int>(bst.begin<InOrder>(), bst.end<InOrder>()), std::vector<int>({2, 3, 4, 5, 6, 7}));
+}
+
+TEST(BinarySearchTreeTest, SortedConstructor_EmptyRange) {
+  std::vector<int> values;
+  BinarySearchTree<int> bst(SortedUnique(), values.begin(), values.end());
+  EXPECT_TRUE(bst.empty());
+}
+
+TEST(BinarySearchTreeTest, AssignSorted_ReplacesContent) {
+  RedBlackTree bst;
+  bst.insert(100);
+  bst.insert(200);
+  std::istringstream input("1 2 3 4 5 6 7 8 9");
+  bst.assign_sorted(std::istream_iterator<int>(input), std::istream_iterator<int>());
+  EXPECT_EQ(bst.size(), 9);
+  EXPECT_FALSE(bst.contains(100));
+  EXPECT_EQ(std::vector<int>(bst.begin<PostOrder>(), bst.end<PostOrder>()),
+            std::vector<int>({1, 2, 4, 3, 6, 7, 9, 8, 5}));
+  EXPECT_GT(RedBlackHeight(bst.begin<PreOrder>().get_node()), 0);
+}
+
+TEST(PoolAllocatorTest, SortedBuildUsesSingleSlab) {
+  std::vector<int> values(1000);
+  for (int i = 0; i < 1000; ++i) {
+    values[i] = i;
+  }
+  PooledTree bst(SortedUnique(), values.begin(), values.end(), PoolAllocator<int>(64));
+  EXPECT_EQ(bst.get_allocator().slab_count(), 1);
+  EXPECT_EQ(*bst.select(500), 500);
+}
+
+// Тесты для слияния без копирования
+TEST(BinarySearchTreeTest, Merge_InterleavedRanges) {
+  RedBlackTree bst1, bst2;
+  for (int i = 0; i < 100; ++i) {
+    (i % 2 == 0 ? bst1 : bst2).insert(i);
+  }
+  bst1.merge(bst2);
+  EXPECT_TRUE(bst2.empty());
+  EXPECT_EQ(bst1.size(), 100);
+  auto root = bst1.begin<PreOrder>().get_node();
+  EXPECT_GT(RedBlackHeight(root), 0);
+  EXPECT_TRUE(ParentLinksValid(root));
+  int expected = 0;
+  for (int value : std::vector<int>(bst1.begin<InOrder>(), bst1.end<InOrder>())) {
+    EXPECT_EQ(value, expected++);
+  }
+}
+
+TEST(BinarySearchTreeTest, Merge_MovesNodesWithoutCopying) {
+  AvlTree bst1, bst2;
+  bst1.insert(1);
+  bst1.insert(5);
+  bst2.insert(3);
+  bst2.insert(7);
+  const void* node = bst2.find(3).get_node();
+  bst1.merge(bst2);
+  EXPECT_EQ(bst1.find(3).get_node(), node);
+  EXPECT_TRUE(AvlValid(bst1.begin<PreOrder>().get_node()));
+}
+
+TEST(BinarySearchTreeTest, Merge_DisjointRanges) {
+  BinarySearchTree<int> bst1, bst2;
+  for (int i = 0; i < 50; ++i) {
+    bst1.insert(i + 100);
+    bst2.insert(i);
+  }
+  bst1.merge(bst2);
+  EXPECT_EQ(bst1.size(), 100);
+  EXPECT_EQ(*bst1.begin<InOrder>(), 0);
+  EXPECT_EQ(*bst1.select(50), 100);
+  EXPECT_LE(SubtreeHeight(bst1.begin<PreOrder>().get_node()), 7);
+}
+
+TEST(BinarySearchTreeTest, Merge_DuplicatesStayInSource) {
+  RedBlackTree bst1, bst2;
+  bst1.insert(1);
+  bst1.insert(2);
+  bst1.insert(3);
+  bst2.insert(2);
+  bst2.insert(3);
+  bst2.insert(4);
+  bst1.merge(bst2);
+  EXPECT_EQ(std::vector<int>(bst1.begin<InOrder>(), bst1.end<InOrder>()), std::vector<int>({1, 2, 3, 4}));
+  EXPECT_EQ(std::vector<int>(bst2.begin<InOrder>(), bst2.end<InOrder>()), std::vector<int>({2, 3}));
+  EXPECT_GT(RedBlackHeight(bst2.begin<PreOrder>().get_node()), 0);
+}
+
+TEST(PoolAllocatorTest, MergeBetweenPoolsCopiesValues) {
+  PooledTree bst1, bst2;
+  bst1.insert(1);
+  bst1.insert(3);
+  bst2.insert(2);
+  bst2.insert(3);
+  bst1.merge(bst2);
+  EXPECT_EQ(std::vector<int>(bst1.begin<InOrder>(), bst1.end<InOrder>()), std::vector<int>({1, 2, 3}));
+  EXPECT_EQ(std::vector<int>(bst2.begin<InOrder>(), bst2.end<InOrder>()), std::vector<int>({3}));
+}
+
+// Нагрузочные тесты для вырожденных деревьев. Операции идут в потоке со стеком 128 КБ:
+// рекурсивным clear и copy понадобилось бы по кадру на уровень, то есть мегабайты.
+constexpr std::size_t kSmallStack = 128 * 1024;
+
+template<typename F>
+void RunOnSmallStack(F f) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, kSmallStack);
+  pthread_t thread;
+  auto run = [](void* arg) -> void* {
+    (*static_cast<F*>(arg))();
+    return nullptr;
+  };
+  int error = pthread_create(&thread, &attr, run, &f);
+  pthread_attr_destroy(&attr);
+  ASSERT_EQ(error, 0);
+  pthread_join(thread, nullptr);
+}
+
+TEST(BinarySearchTreeTest, DeepTree_CopyPreservesShape) {
+  const int n = 1000000;
+  BinarySearchTree<int> bst;
+  for (int i = 0; i < n; ++i) {
+    bst.insert(bst.end<InOrder>(), i); // Каждый узел - правый потомок предыдущего
+  }
+  std::size_t copied = 0;
+  bool same_shape = false;
+  int last = -1;
+  RunOnSmallStack([&] {
+    BinarySearchTree<int> copy(bst);
+    copied = copy.size();
+    same_shape = std::equal(copy.begin<PreOrder>(), copy.end<PreOrder>(), bst.begin<PreOrder>());
+    last = *--copy.end<InOrder>();
+    copy.clear();
+  });
+  EXPECT_EQ(copied, n);
+  EXPECT_TRUE(same_shape);
+  EXPECT_EQ(last, n - 1);
+  EXPECT_EQ(bst.countNodes(nullptr), 0);
+  RunOnSmallStack([&] { bst.clear(); });
+  EXPECT_TRUE(bst.empty());
+}
+
+TEST(BinarySearchTreeTest, DeepTree_Destroy) {
+  const int n = 20000; // Вставка по убыванию без подсказки квадратична, но глубины уже хватает
+  auto bst = std::make_unique<BinarySearchTree<int>>();
+  for (int i = n; i > 0; --i) {
+    bst->insert(i); // Каждый узел - левый потомок предыдущего
+  }
+  EXPECT_EQ(bst->size(), n);
+  RunOnSmallStack([&] { bst.reset(); });
+  EXPECT_EQ(bst, nullptr);
+}
+
+TEST(BinarySearchTreeTest, Copy_EmptyTree) {
+  BinarySearchTree<int> bst;
+  BinarySearchTree<int> copy(bst);
+  EXPECT_TRUE(copy.empty());
+}
+
+// Тесты для перемещения, emplace и извлечения узлов
+TEST(BinarySearchTreeTest, Insert_ReturnsPositionAndFlag) {
+  BinarySearchTree<int> bst;
+  auto first = bst.insert(10);
+  EXPECT_TRUE(first.second);
+  EXPECT_EQ(*first.first, 10);
+  auto second = bst.insert(10);
+  EXPECT_FALSE(second.second);
+  EXPECT_EQ(second.first, first.first);
+  EXPECT_EQ(bst.size(), 1);
+}
+
+TEST(BinarySearchTreeTest, Insert_MovesValue) {
+  BinarySearchTree<std::string> bst;
+  std::string value(100, 'x');
+  bst.insert(std::move(value));
+  EXPECT_TRUE(value.empty());
+  EXPECT_TRUE(bst.contains(std::string(100, 'x')));
+}
+
+TEST(BinarySearchTreeTest, Emplace_ConstructsInPlace) {
+  BinarySearchTree<std::string> bst;
+  auto result = bst.emplace(3, 'a');
+  EXPECT_TRUE(result.second);
+  EXPECT_EQ(*result.first, "aaa");
+  EXPECT_FALSE(bst.emplace("aaa").second);
+  EXPECT_EQ(bst.size(), 1);
+}
+
+TEST(BinarySearchTreeTest, EmplaceHint_InsertsElement) {
+  RedBlackTree bst;
+  auto it = bst.emplace_hint(bst.end<InOrder>(), 5);
+  EXPECT_EQ(*it, 5);
+  EXPECT_EQ(*bst.emplace_hint(it, 5), 5);
+  EXPECT_EQ(bst.size(), 1);
+}
+
+TEST(BinarySearchTreeTest, MoveConstructor_TakesNodes) {
+  RedBlackTree bst;
+  bst.insert(1);
+  bst.insert(2);
+  const void* node = bst.find(2).get_node();
+  RedBlackTree moved(std::move(bst));
+  EXPECT_TRUE(bst.empty());
+  EXPECT_EQ(moved.size(), 2);
+  EXPECT_EQ(moved.find(2).get_node(), node);
+}
+
+TEST(BinarySearchTreeTest, MoveAssignment_ReplacesContent) {
+  BinarySearchTree<int> bst1, bst2;
+  bst1.insert(1);
+  bst2.insert(2);
+  bst2.insert(3);
+  bst1 = std::move(bst2);
+  EXPECT_TRUE(bst2.empty());
+  EXPECT_EQ(std::vector<int>(bst1.begin<InOrder>(), bst1.end<InOrder>()), std::vector<int>({2, 3}));
+}
+
+TEST(BinarySearchTreeTest, CopyAssignment_CopiesContent) {
+  AvlTree bst1, bst2;
+  bst1.insert(1);
+  bst2.insert(2);
+  bst2.insert(3);
+  bst1 = bst2;
+  EXPECT_EQ(bst2.size(), 2);
+  EXPECT_EQ(std::vector<int>(bst1.begin<InOrder>(), bst1.end<InOrder>()), std::vector<int>({2, 3}));
+  EXPECT_TRUE(AvlValid(bst1.begin<PreOrder>().get_node()));
+}
+
+TEST(BinarySearchTreeTest, NodeHandle_MovesBetweenTrees) {
+  RedBlackTree bst1, bst2;
+  for (int i = 0; i < 10; ++i) {
+    bst1.insert(i);
+  }
+  const void* node = bst1.find(5).get_node();
+  auto handle = bst1.extract(5);
+  EXPECT_FALSE(bst1.contains(5));
+  EXPECT_EQ(bst1.size(), 9);
+  auto result = bst2.insert(std::move(handle));
+  EXPECT_TRUE(result.inserted);
+  EXPECT_TRUE(result.node.empty());
+  EXPECT_EQ(result.position.get_node(), node);
+  EXPECT_GT(RedBlackHeight(bst1.begin<PreOrder>().get_node()), 0);
+}
+
+TEST(BinarySearchTreeTest, NodeHandle_ChangeKeyAndReinsert) {
+  BinarySearchTree<int> bst;
+  bst.insert(1);
+  bst.insert(2);
+  auto handle = bst.extract(2);
+  handle.value() = 3;
+  bst.insert(std::move(handle));
+  EXPECT_EQ(std::vector<int>(bst.begin<InOrder>(), bst.end<InOrder>()), std::vector<int>({1, 3}));
+}
+
+TEST(BinarySearchTreeTest, NodeHandle_DuplicateIsReturned) {
+  BinarySearchTree<int> bst1, bst2;
+  bst1.insert(1);
+  bst2.insert(1);
+  auto result = bst2.insert(bst1.extract(1));
+  EXPECT_FALSE(result.inserted);
+  EXPECT_FALSE(result.node.empty());
+  EXPECT_EQ(result.node.value(), 1);
+  EXPECT_EQ(*result.position, 1);
+}
+
+TEST(BinarySearchTreeTest, NodeHandle_EmptyInsert) {
+  BinarySearchTree<int> bst;
+  auto result = bst.insert(BinarySearchTree<int>::node_type());
+  EXPECT_FALSE(result.inserted);
+  EXPECT_TRUE(bst.empty());
+}
+
+TEST(PoolAllocatorTest, MoveAssignmentKeepsPool) {
+  PooledTree bst1, bst2;
+  bst2.insert(1);
+  bst1 = std::move(bst2);
+  EXPECT_TRUE(bst1.contains(1));
+  bst2.insert(2);
+  EXPECT_TRUE(bst2.contains(2));
+}
+
+// Тесты для вставки с подсказкой
+struct CountingLess {
+  static inline int calls = 0;
+  bool operator()(int a, int b) const {
+    ++calls;
+    return a < b;
+  }
+};
+
+TEST(BinarySearchTreeTest, InsertHint_AppendAtEnd) {
+  BinarySearchTree<int, CountingLess, std::allocator<int>, RedBlackBalance> bst;
+  for (int i = 0; i < 1000; ++i) {
+    bst.insert(bst.end<InOrder>(), i);
+  }
+  CountingLess::calls = 0;
+  bst.insert(bst.end<InOrder>(), 1000);
+  EXPECT_EQ(CountingLess::calls, 1);
+  EXPECT_EQ(bst.size(), 1001);
+  EXPECT_GT(RedBlackHeight(bst.begin<PreOrder>().get_node()), 0);
+  int expected = 0;
+  for (auto it = bst.begin<InOrder>(); it != bst.end<InOrder>(); ++it) {
+    EXPECT_EQ(*it, expected++);
+  }
+}
+
+TEST(BinarySearchTreeTest, InsertHint_BeforePosition) {
+  BinarySearchTree<int, CountingLess> bst;
+  for (int i = 0; i < 100; i += 10) {
+    bst.insert(i);
+  }
+  auto hint = bst.find(50);
+  CountingLess::calls = 0;
+  auto it = bst.insert(hint, 45);
+  EXPECT_EQ(CountingLess::calls, 2);
+  EXPECT_EQ(*it, 45);
+  EXPECT_EQ(*++it, 50);
+}
+
+TEST(BinarySearchTreeTest, InsertHint_AfterPreviousInsert) {
+  AvlTree bst;
+  auto hint = bst.end<InOrder>();
+  for (int i = 0; i < 500; ++i) {
+    hint = bst.insert(hint, i);
+    ++hint; // Следующий элемент встанет сразу после только что вставленного
+  }
+  EXPECT_EQ(bst.size(), 500);
+  EXPECT_TRUE(AvlValid(bst.begin<PreOrder>().get_node()));
+  EXPECT_EQ(*bst.select(250), 250);
+}
+
+TEST(BinarySearchTreeTest, InsertHint_WrongHintFallsBack) {
+  RedBlackTree bst;
+  for (int i = 0; i < 100; ++i) {
+    bst.insert(i * 2);
+  }
+  auto it = bst.insert(bst.begin<InOrder>(), 151);
+  EXPECT_EQ(*it, 151);
+  EXPECT_EQ(*--it, 150);
+  EXPECT_EQ(*bst.insert(bst.end<InOrder>(), 3), 3);
+  EXPECT_EQ(bst.size(), 102);
+  EXPECT_GT(RedBlackHeight(bst.begin<PreOrder>().get_node()), 0);
+}
+
+TEST(BinarySearchTreeTest, InsertHint_ExistingKey) {
+  BinarySearchTree<int> bst;
+  bst.insert(1);
+  bst.insert(2);
+  auto it = bst.insert(bst.find(2), 2);
+  EXPECT_EQ(it, bst.find(2));
+  EXPECT_EQ(*bst.insert(bst.end<InOrder>(), 1), 1);
+  EXPECT_EQ(bst.size(), 2);
+}
+
+TEST(BinarySearchTreeTest, EmplaceHint_UsesHint) {
+  BinarySearchTree<std::string> bst;
+  bst.insert("a");
+  bst.insert("c");
+  auto it = bst.emplace_hint(bst.find("c"), 1, 'b');
+  EXPECT_EQ(*it, "b");
+  EXPECT_EQ(std::vector<std::string>(bst.begin<InOrder>(), bst.end<InOrder>()),
+            std::vector<std::string>({"a", "b", "c"}));
+}
+
+// Размер поддерева или -1, если сохраненный в каком-то узле размер неверен
+template<typename Node>
+long long CheckedSubtreeSize(const Node* node) {
+  if (node == nullptr) {
+    return 0;
+  }
+  long long left = CheckedSubtreeSize(node->left);
+  long long right = CheckedSubtreeSize(node->right);
+  if (left < 0 || right < 0 || static_cast<long long>(node->size) != left + right + 1) {
+    return -1;
+  }
+  return left + right + 1;
+}
+
+// Вставки с подсказкой откладывают пересчет размеров и сводок; вперемешку с обычными
+// вставками и удалениями порядковые запросы должны совпадать с эталоном
+template<typename Tree>
+void ExpectHintedInsertsKeepOrderStatistics() {
+  Tree tree;
+  std::set<int> expected;
+  std::mt19937 gen(11);
+  auto hint = tree.template end<InOrder>();
+  int next = 100000;
+  for (int i = 0; i < 4000; ++i) {
+    int value = static_cast<int>(gen() % 5000);
+    switch (gen() % 6) {
+      case 0:
+        tree.erase(value);
+        expected.erase(value);
+        hint = tree.template end<InOrder>(); // Подсказка могла указывать на удаленный элемент
+        break;
+      case 1:
+        tree.insert(value);
+        expected.insert(value);
+        break;
+      case 2:
+        tree.insert(tree.lower_bound(value), value);
+        expected.insert(value);
+        break;
+      case 3:
+        tree.insert(tree.template end<InOrder>(), next);
+        expected.insert(next++);
+        break;
+      default:
+        hint = tree.insert(hint, next); // Следующий элемент встает сразу за предыдущим
+        expected.insert(next++);
+    }
+    if (i % 100 == 0) {
+      ASSERT_EQ(tree.size(), expected.size());
+      std::size_t k = gen() % expected.size();
+      EXPECT_EQ(*tree.select(k), *std::next(expected.begin(), k));
+      EXPECT_EQ(tree.rank(value), static_cast<std::size_t>(std::distance(expected.begin(), expected.lower_bound(value))));
+      EXPECT_EQ(tree.aggregate(value, next), std::accumulate(expected.lower_bound(value), expected.end(), 0LL));
+    }
+  }
+  EXPECT_EQ(tree.aggregate(), std::accumulate(expected.begin(), expected.end(), 0LL));
+  EXPECT_EQ(CheckedSubtreeSize(tree.template begin<PreOrder>().get_node()), static_cast<long long>(expected.size()));
+  EXPECT_TRUE(std::equal(tree.template begin<InOrder>(), tree.template end<InOrder>(), expected.begin(), expected.end()));
+  Tree copy(tree);
+  EXPECT_EQ(CheckedSubtreeSize(copy.template begin<PreOrder>().get_node()), static_cast<long long>(expected.size()));
+}
+
+TEST(BinarySearchTreeTest, InsertHint_DeferredSizesStayConsistent) {
+  ExpectHintedInsertsKeepOrderStatistics<BinarySearchTree<int, std::less<int>, std::allocator<int>, NoBalance, SumAugment<long long>>>();
+  ExpectHintedInsertsKeepOrderStatistics<BinarySearchTree<int, std::less<int>, std::allocator<int>, RedBlackBalance, SumAugment<long long>>>();
+  ExpectHintedInsertsKeepOrderStatistics<BinarySearchTree<int, std::less<int>, std::allocator<int>, AvlBalance, SumAugment<long long>>>();
+}
+
+// size и копирование не пишут в узлы: отложенные размеры досчитывает только изменяющий код
+TEST(BinarySearchTreeTest, InsertHint_ConstReadsLeaveSizesDeferred) {
+  RedBlackTree bst;
+  for (int i = 0; i < 1000; ++i) {
+    bst.insert(bst.end<InOrder>(), i);
+  }
+  const RedBlackTree& view = bst;
+  EXPECT_EQ(view.size(), 1000);
+  EXPECT_FALSE(view.empty());
+  EXPECT_EQ(bst.begin<PreOrder>().get_node()->size, 0); // Корень все еще не пересчитан
+  RedBlackTree copy(view);
+  EXPECT_EQ(copy.size(), 1000);
+  EXPECT_EQ(bst.begin<PreOrder>().get_node()->size, 0);
+  bst.settleSizes();
+  EXPECT_EQ(CheckedSubtreeSize(bst.begin<PreOrder>().get_node()), 1000);
+
+  // Обычная вставка сама досчитывает размеры перед изменением
+  copy.insert(-1);
+  EXPECT_EQ(CheckedSubtreeSize(copy.begin<PreOrder>().get_node()), 1001);
+  auto parts = copy.split(500);
+  EXPECT_EQ(parts.first.size(), 501);
+  EXPECT_EQ(parts.second.size(), 500);
+  EXPECT_EQ(copy.size(), 0);
+  RedBlackTree joined = RedBlackTree::join(std::move(parts.second), std::move(parts.first));
+  EXPECT_EQ(joined.size(), 1001);
+  EXPECT_EQ(*joined.select(1000), 999);
+}
+
+TEST(BinarySearchTreeTest, InsertHint_AppendAfterEraseOfMaximum) {
+  RedBlackTree bst;
+  for (int i = 0; i < 100; ++i) {
+    bst.insert(bst.end<InOrder>(), i);
+  }
+  bst.erase(99);
+  auto it = bst.insert(bst.end<InOrder>(), 98); // Максимум снова ищется после удаления
+  EXPECT_EQ(*it, 98);
+  EXPECT_EQ(*bst.insert(bst.end<InOrder>(), 150), 150);
+  EXPECT_EQ(*bst.insert(bst.find(150), 120), 120);
+  EXPECT_EQ(bst.size(), 101);
+  EXPECT_EQ(*bst.select(100), 150);
+  EXPECT_EQ(*--bst.end<InOrder>(), 150);
+}
+
+// Тесты для прозрачного поиска
+struct StringLess {
+  using is_transparent = void;
+  bool operator()(std::string_view a, std::string_view b) const {
+    return a < b;
+  }
+};
+
+using StringTree = BinarySearchTree<std::string, StringLess>;
+
+TEST(BinarySearchTreeTest, Transparent_FindByStringView) {
+  StringTree bst;
+  bst.insert("apple");
+  bst.insert("banana");
+  bst.insert("cherry");
+  std::string_view key = "banana";
+  auto it = bst.find(key);
+  ASSERT_NE(it.get_node(), nullptr);
+  EXPECT_EQ(*it, "banana");
+  EXPECT_EQ(bst.find(std::string_view("grape")).get_node(), nullptr);
+}
+
+TEST(BinarySearchTreeTest, Transparent_LookupsByCString) {
+  StringTree bst;
+  bst.insert("a");
+  bst.insert("c");
+  bst.insert("e");
+  const char* key = "c";
+  EXPECT_TRUE(bst.contains(key));
+  EXPECT_TRUE(bst.exist(key));
+  EXPECT_EQ(bst.count(key), 1);
+  EXPECT_EQ(*bst.lower_bound("b"), "c");
+  EXPECT_EQ(*bst.upper_bound("c"), "e");
+  auto range = bst.equal_range("c");
+  EXPECT_EQ(*range.first, "c");
+  EXPECT_EQ(*range.second, "e");
+}
+
+TEST(BinarySearchTreeTest, Transparent_Erase) {
+  StringTree bst;
+  bst.insert("a");
+  bst.insert("b");
+  EXPECT_EQ(bst.erase(std::string_view("a")), 1);
+  EXPECT_EQ(bst.erase(std::string_view("z")), 0);
+  EXPECT_EQ(bst.size(), 1);
+}
+
+// Компаратор без operator== у значений: все сравнения должны идти через Compare
+struct Point {
+  int x;
+  int y;
+};
+
+struct PointLess {
+  bool operator()(const Point& a, const Point& b) const {
+    return a.x < b.x;
+  }
+};
+
+TEST(BinarySearchTreeTest, Compare_UsedForAllLookups) {
+  BinarySearchTree<Point, PointLess> bst;
+  bst.insert({1, 10});
+  bst.insert({2, 20});
+  bst.insert({3, 30});
+  EXPECT_EQ(bst.find({2, 0})->y, 20); // Эквивалентность определяется только по x
+  EXPECT_TRUE(bst.contains({3, 0}));
+  EXPECT_EQ(bst.lower_bound({2, 99})->y, 20);
+  EXPECT_EQ(bst.upper_bound({2, 99})->y, 30);
+  EXPECT_EQ(bst.erase({1, 0}), 1);
+  EXPECT_FALSE(bst.insert({3, 0}).second);
+}
+
+TEST(BinarySearchTreeTest, Compare_StoredComparator) {
+  BinarySearchTree<int, std::greater<int>> bst(std::greater<int>{});
+  bst.insert(1);
+  bst.insert(3);
+  bst.insert(2);
+  EXPECT_EQ(std::vector<int>(bst.begin<InOrder>(), bst.end<InOrder>()), std::vector<int>({3, 2, 1}));
+  EXPECT_TRUE(bst.key_comp()(2, 1));
+  EXPECT_EQ(*bst.lower_bound(5), 3);
+}
+
+TEST(BinarySearchTreeTest, Freeze_MatchesTree) {
+  std::mt19937 gen(42);
+  for (int n = 0; n <= 40; ++n) {
+    RedBlackTree bst;
+    std::uniform_int_distribution<int> dist(0, 3 * n);
+    while (bst.size() < static_cast<std::size_t>(n)) {
+      bst.insert(dist(gen) * 2);
+    }
+    auto frozen = bst.freeze();
+    ASSERT_EQ(frozen.size(), bst.size());
+    EXPECT_EQ(std::vector<int>(frozen.begin(), frozen.end()),
+              std::vector<int>(bst.begin<InOrder>(), bst.end<InOrder>()));
+    for (int key = -1; key <= 6 * n + 1; ++key) {
+      EXPECT_EQ(frozen.contains(key), bst.contains(key));
+      auto lower = bst.lower_bound(key);
+      auto upper = bst.upper_bound(key);
+      EXPECT_EQ(frozen.lower_bound(key) == frozen.end(), lower == bst.end<InOrder>());
+      EXPECT_EQ(frozen.upper_bound(key) == frozen.end(), upper == bst.end<InOrder>());
+      if (lower != bst.end<InOrder>()) {
+        EXPECT_EQ(*frozen.lower_bound(key), *lower);
+      }
+      if (upper != bst.end<InOrder>()) {
+        EXPECT_EQ(*frozen.upper_bound(key), *upper);
+      }
+    }
+  }
+}
+
+TEST(BinarySearchTreeTest, Freeze_RandomAccess) {
+  BinarySearchTree<int> bst;
+  for (int i : {50, 20, 80, 10, 30, 70, 90}) {
+    bst.insert(i);
+  }
+  auto frozen = bst.freeze();
+  EXPECT_EQ(frozen[0], 10);
+  EXPECT_EQ(frozen[6], 90);
+  EXPECT_EQ(frozen.end() - frozen.begin(), 7);
+  EXPECT_EQ(frozen.find(70) - frozen.begin(), 4);
+  EXPECT_EQ(frozen.find(75), frozen.end());
+  EXPECT_EQ(*(frozen.begin() + 3), 50);
+  EXPECT_EQ(std::distance(frozen.lower_bound(20), frozen.upper_bound(80)), 5);
+}
+
+TEST(BinarySearchTreeTest, Freeze_IndependentOfTree) {
+  StringTree bst;
+  bst.insert("b");
+  bst.insert("a");
+  auto frozen = bst.freeze();
+  bst.insert("c");
+  bst.clear();
+  EXPECT_EQ(frozen.size(), 2);
+  EXPECT_TRUE(frozen.contains(std::string_view("a")));
+  EXPECT_FALSE(frozen.contains(std::string_view("c")));
+
+  auto copy = frozen;
+  decltype(frozen) moved = std::move(frozen);
+  EXPECT_TRUE(frozen.empty());
+  EXPECT_EQ(*copy.begin(), "a");
+  EXPECT_EQ(*moved.lower_bound(std::string_view("aa")), "b");
+}
+
+TEST(BinarySearchTreeTest, Batch_MatchesSingleLookups) {
+  RedBlackTree bst;
+  for (int i = 0; i < 500; i += 3) {
+    bst.insert(i);
+  }
+  std::vector<int> keys;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> dist(-10, 510);
+  for (int i = 0; i < 75; ++i) { // Не кратно ширине группы
+    keys.push_back(dist(gen));
+  }
+
+  std::vector<bool> contained;
+  std::vector<RedBlackTree::const_iterator<InOrder>> found;
+  std::vector<RedBlackTree::const_iterator<InOrder>> lower;
+  bst.contains_batch(keys.begin(), keys.end(), std::back_inserter(contained));
+  bst.find_batch(keys.begin(), keys.end(), std::back_inserter(found));
+  bst.lower_bound_batch(keys.begin(), keys.end(), std::back_inserter(lower));
+  ASSERT_EQ(contained.size(), keys.size());
+  ASSERT_EQ(found.size(), keys.size());
+  ASSERT_EQ(lower.size(), keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    EXPECT_EQ(contained[i], bst.contains(keys[i]));
+    EXPECT_TRUE(found[i] == bst.find(keys[i]));
+    EXPECT_TRUE(lower[i] == bst.lower_bound(keys[i]));
+  }
+}
+
+TEST(BinarySearchTreeTest, Batch_EmptyInputs) {
+  BinarySearchTree<int> bst;
+  std::vector<int> keys = {1, 2, 3};
+  bool results[3] = {true, true, true};
+  EXPECT_EQ(bst.contains_batch(keys.begin(), keys.end(), results), results + 3);
+  EXPECT_FALSE(results[0] || results[1] || results[2]);
+
+  bst.insert(2);
+  EXPECT_EQ(bst.contains_batch(keys.begin(), keys.begin(), results), results);
+  bst.contains_batch(keys.begin(), keys.end(), results);
+  EXPECT_FALSE(results[0]);
+  EXPECT_TRUE(results[1]);
+  EXPECT_FALSE(results[2]);
+}
+
+TEST(BinarySearchTreeTest, Batch_TransparentKeys) {
+  StringTree bst;
+  bst.insert("apple");
+  bst.insert("cherry");
+  std::string_view keys[] = {"cherry", "banana", "apple"};
+  std::vector<StringTree::const_iterator<InOrder>> found;
+  bst.find_batch(std::begin(keys), std::end(keys), std::back_inserter(found));
+  EXPECT_EQ(*found[0], "cherry");
+  EXPECT_TRUE(found[1] == bst.end<InOrder>());
+  EXPECT_EQ(*found[2], "apple");
+}
+
+// Узлы по три ключа: даже на небольших данных дерево получается многоуровневым
+TEST(BinarySearchTreeTest, Parallel_ForEachAndCountIf) {
+  std::vector<int> values(50000);
+  std::iota(values.begin(), values.end(), 0);
+  BinarySearchTree<int> bst(SortedUnique(), values.begin(), values.end());
+  ThreadPool pool(4);
+
+  std::atomic<long long> sum{0};
+  std::atomic<int> calls{0};
+  bst.for_each(pool, [&](int value) {
+    sum.fetch_add(value, std::memory_order_relaxed);
+    calls.fetch_add(1, std::memory_order_relaxed);
+  });
+  EXPECT_EQ(calls.load(), 50000);
+  EXPECT_EQ(sum.load(), 50000LL * 49999 / 2);
+  EXPECT_EQ(bst.count_if(pool, [](int value) { return value % 3 == 0; }), 16667u);
+}
+
+TEST(BinarySearchTreeTest, Parallel_ReduceKeepsOrder) {
+  std::vector<std::string> values;
+  std::string expected = "init";
+  for (int i = 0; i < 20000; ++i) {
+    values.push_back(std::to_string(100000 + i));
+    expected += values.back();
+  }
+  BinarySearchTree<std::string> bst(SortedUnique(), values.begin(), values.end());
+  ThreadPool pool(4);
+  // Конкатенация некоммутативна: результат совпадает с последовательным только при сохранении порядка
+  auto concat = [](std::string lhs, const std::string& rhs) {
+    lhs += rhs;
+    return lhs;
+  };
+  EXPECT_EQ(bst.reduce(pool, std::string("init"), concat), expected);
+  EXPECT_EQ(BinarySearchTree<std::string>().reduce(pool, std::string("init"), concat), "init");
+}
+
+TEST(BinarySearchTreeTest, Parallel_DegenerateTreeAndNoWorkers) {
+  BinarySearchTree<int> bst;
+  for (int i = 0; i < 5000; ++i) {
+    bst.insert(i); // Без балансировки дерево вырождается в цепочку
+  }
+  ThreadPool pool(3);
+  EXPECT_EQ(bst.reduce(pool, 0LL, std::plus<long long>()), 5000LL * 4999 / 2);
+  ThreadPool inline_pool(0);
+  EXPECT_EQ(bst.count_if(inline_pool, [](int value) { return value < 100; }), 100u);
+}
+
+TEST(BinarySearchTreeTest, Parallel_ExceptionPropagates) {
+  std::vector<int> values(30000);
+  std::iota(values.begin(), values.end(), 0);
+  BinarySearchTree<int> bst(SortedUnique(), values.begin(), values.end());
+  ThreadPool pool(4);
+  EXPECT_THROW(bst.for_each(pool, [](int value) {
+    if (value == 25000) {
+      throw std::runtime_error("stop");
+    }
+  }), std::runtime_error);
+  // Пул остается рабочим
+  EXPECT_EQ(bst.count_if(pool, [](int value) { return value >= 29000; }), 1000u);
+}
+
+TEST(BinarySearchTreeTest, ParallelBuild_MatchesSortedBuild) {
+  std::vector<int> values(40000);
+  std::mt19937 gen(17);
+  for (int& value : values) {
+    value = static_cast<int>(gen() % 30000);
+  }
+  std::set<int> expected(values.begin(), values.end());
+  ThreadPool pool(4);
+  RedBlackTree bst(pool, values.begin(), values.end());
+  RedBlackTree sorted(SortedUnique(), expected.begin(), expected.end());
+  auto root = bst.begin<PreOrder>().get_node();
+  EXPECT_EQ(bst.size(), expected.size());
+  EXPECT_GT(RedBlackHeight(root), 0);
+  EXPECT_TRUE(ParentLinksValid(root));
+  EXPECT_EQ(std::vector<int>(bst.begin<InOrder>(), bst.end<InOrder>()),
+            std::vector<int>(expected.begin(), expected.end()));
+  // Форма та же, что у построения из отсортированного диапазона
+  EXPECT_EQ(std::vector<int>(bst.begin<PreOrder>(), bst.end<PreOrder>()),
+            std::vector<int>(sorted.begin<PreOrder>(), sorted.end<PreOrder>()));
+  bst.insert(-1);
+  bst.erase(values[0]);
+  EXPECT_GT(RedBlackHeight(bst.begin<PreOrder>().get_node()), 0);
+
+  AvlTree avl(pool, values.begin(), values.end());
+  EXPECT_TRUE(AvlValid(avl.begin<PreOrder>().get_node()));
+  EXPECT_EQ(avl.size(), expected.size());
+}
+
+TEST(BinarySearchTreeTest, ParallelBuild_KeepsFirstEquivalent) {
+  std::vector<Point> points;
+  for (int i = 0; i < 10000; ++i) {
+    points.push_back({(i * 7919) % 1000, i});
+  }
+  ThreadPool pool(3);
+  BinarySearchTree<Point, PointLess> bst(pool, points.begin(), points.end());
+  EXPECT_EQ(bst.size(), 1000u);
+  for (const Point& point : points) {
+    // Первое вхождение x в points имеет наименьший y
+    EXPECT_LE(bst.find(point)->y, point.y);
+  }
+  EXPECT_EQ(bst.find(Point{0, 0})->y, 0);
+}
+
+TEST(BinarySearchTreeTest, ParallelBuild_SmallAndEmptyRanges) {
+  ThreadPool pool(2);
+  std::vector<int> values;
+  BinarySearchTree<int> empty(pool, values.begin(), values.end());
+  EXPECT_TRUE(empty.empty());
+  values = {5, 5, 5};
+  BinarySearchTree<int> same(pool, values.begin(), values.end());
+  EXPECT_EQ(std::vector<int>(same.begin<InOrder>(), same.end<InOrder>()), std::vector<int>({5}));
+  values = {3, 1, 2};
+  same.assign_parallel(pool, values.begin(), values.end());
+  EXPECT_EQ(std::vector<int>(same.begin<InOrder>(), same.end<InOrder>()), std::vector<int>({1, 2, 3}));
+}
+
+TEST(PoolAllocatorTest, ParallelBuildUsesSingleSlab) {
+  std::vector<int> values(5000);
+  for (int i = 0; i < 5000; ++i) {
+    values[i] = (i * 31) % 5000;
+  }
+  ThreadPool pool(2);
+  PooledTree bst(pool, values.begin(), values.end(), std::less<int>(), PoolAllocator<int>(64));
+  EXPECT_EQ(bst.get_allocator().slab_count(), 1);
+  EXPECT_EQ(*bst.select(2500), 2500);
+}
+
+struct ThrowingCopy {
+  static int copies_left;
+  int value;
+
+  explicit ThrowingCopy(int value) : value(value) {}
+
+  ThrowingCopy(const ThrowingCopy& other) : value(other.value) {
+    if (--copies_left < 0) {
+      throw std::runtime_error("copy");
+    }
+  }
+
+  ThrowingCopy(ThrowingCopy&&) = default;
+  ThrowingCopy& operator=(ThrowingCopy&&) = default;
+
+  bool operator<(const ThrowingCopy& other) const {
+    return value < other.value;
+  }
+};
+
+int ThrowingCopy::copies_left = 0;
+
+TEST(BinarySearchTreeTest, ParallelBuild_ExceptionLeavesTreeEmpty) {
+  std::vector<ThrowingCopy> values;
+  for (int i = 0; i < 5000; ++i) {
+    values.emplace_back(5000 - i);
+  }
+  ThreadPool pool(2);
+  BinarySearchTree<ThrowingCopy> bst;
+  bst.insert(ThrowingCopy(1));
+  ThrowingCopy::copies_left = 3000;
+  EXPECT_THROW(bst.assign_parallel(pool, values.begin(), values.end()), std::runtime_error);
+  EXPECT_TRUE(bst.empty());
+  ThrowingCopy::copies_left = 5000;
+  bst.assign_parallel(pool, values.begin(), values.end());
+  EXPECT_EQ(bst.size(), 5000u);
+  EXPECT_EQ(bst.begin<InOrder>()->value, 1);
+}
+
+// Исключение при копировании значения или ключа освобождает все, что снимок успел создать
+TEST(BinarySearchTreeTest, Freeze_ExceptionReleasesPartialSnapshot) {
+  BinarySearchTree<ThrowingCopy> bst;
+  for (int i = 0; i < 100; ++i) {
+    bst.insert(ThrowingCopy(i));
+  }
+  for (int copies : {0, 50, 100, 150}) { // Сначала копируются 100 значений, затем 100 ключей
+    ThrowingCopy::copies_left = copies;
+    EXPECT_THROW(bst.freeze(), std::runtime_error);
+  }
+  ThrowingCopy::copies_left = 200;
+  auto frozen = bst.freeze();
+  EXPECT_EQ(frozen.size(), 100u);
+  EXPECT_TRUE(frozen.contains(ThrowingCopy(42)));
+
+  // Диапазон короче заявленной длины: массивы освобождаются с исходной длиной
+  std::vector<ThrowingCopy> values;
+  for (int i = 0; i < 10; ++i) {
+    values.emplace_back(i);
+  }
+  ThrowingCopy::copies_left = 15;
+  EXPECT_THROW(FrozenTree<ThrowingCopy>(values.begin(), values.end(), 20), std::runtime_error);
+  ThrowingCopy::copies_left = 20;
+  FrozenTree<ThrowingCopy> partial(values.begin(), values.end(), 20);
+  EXPECT_EQ(partial.size(), 10u);
+  EXPECT_EQ((partial.end() - 1)->value, 9);
+  EXPECT_TRUE(partial.contains(ThrowingCopy(3)));
+}
+
+template<typename Tree, typename Valid>
+void ExpectTreeMatches(const Tree& tree, const std::vector<int>& expected, Valid valid) {
+  auto root = tree.template begin<PreOrder>().get_node();
+  EXPECT_TRUE(valid(root));
+  EXPECT_TRUE(ParentLinksValid(root));
+  EXPECT_TRUE(root == nullptr || root->parent == nullptr);
+  EXPECT_EQ(std::vector<int>(tree.template begin<InOrder>(), tree.template end<InOrder>()), expected);
+  ASSERT_EQ(tree.size(), expected.size());
+  for (std::size_t i = 0; i < expected.size(); i += 7) {
+    EXPECT_EQ(*tree.select(i), expected[i]); // Размеры поддеревьев пересчитаны
+  }
+}
+
+template<typename Tree, typename Valid>
+void ExpectSplitJoin(Valid valid) {
+  std::mt19937 gen(18);
+  for (int round = 0; round < 20; ++round) {
+    Tree tree;
+    std::set<int> values;
+    int count = static_cast<int>(gen() % 2000);
+    for (int i = 0; i < count; ++i) {
+      int value = static_cast<int>(gen() % 5000);
+      tree.insert(value);
+      values.insert(value);
+    }
+    int key = static_cast<int>(gen() % 5200) - 100;
+    auto [less, rest] = tree.split(key);
+    EXPECT_TRUE(tree.empty());
+    std::vector<int> expected_less(values.begin(), values.lower_bound(key));
+    std::vector<int> expected_rest(values.lower_bound(key), values.end());
+    ExpectTreeMatches(less, expected_less, valid);
+    ExpectTreeMatches(rest, expected_rest, valid);
+
+    // Порядок аргументов не важен
+    Tree joined = round % 2 == 0 ? Tree::join(std::move(less), std::move(rest)) : Tree::join(std::move(rest), std::move(less));
+    ExpectTreeMatches(joined, std::vector<int>(values.begin(), values.end()), valid);
+    joined.insert(-1);
+    joined.erase(*std::next(joined.template begin<InOrder>()));
+    EXPECT_TRUE(valid(joined.template begin<PreOrder>().get_node()));
+  }
+}
+
+TEST(BinarySearchTreeTest, SplitJoin_RedBlack) {
+  ExpectSplitJoin<RedBlackTree>([](auto root) { return RedBlackHeight(root) > 0; });
+}
+
+TEST(BinarySearchTreeTest, SplitJoin_Avl) {
+  ExpectSplitJoin<AvlTree>([](auto root) { return AvlValid(root); });
+}
+
+TEST(BinarySearchTreeTest, SplitJoin_NoBalance) {
+  ExpectSplitJoin<BinarySearchTree<int>>([](auto) { return true; });
+}
+
+TEST(BinarySearchTreeTest, SplitJoin_DegenerateTreeWithoutRecursion) {
+  BinarySearchTree<int> bst;
+  for (int i = 0; i < 3000; ++i) {
+    bst.insert(i);
+  }
+  auto [less, rest] = bst.split(1000);
+  EXPECT_EQ(less.size(), 1000u);
+  EXPECT_EQ(*rest.begin<InOrder>(), 1000);
+  BinarySearchTree<int> joined = BinarySearchTree<int>::join(std::move(less), std::move(rest));
+  EXPECT_EQ(joined.size(), 3000u);
+}
+
+TEST(BinarySearchTreeTest, SplitJoin_UnbalancedSizes) {
+  // Сильно различающиеся по высоте деревья: mid подвешивается глубоко вдоль края
+  RedBlackTree big;
+  AvlTree big_avl;
+  for (int i = 0; i < 5000; ++i) {
+    big.insert(i);
+    big_avl.insert(i);
+  }
+  RedBlackTree small;
+  small.insert(10000);
+  AvlTree small_avl;
+  small_avl.insert(-10000);
+  std::vector<int> expected(5000);
+  std::iota(expected.begin(), expected.end(), 0);
+  std::vector<int> expected_avl = expected;
+  expected.push_back(10000);
+  expected_avl.insert(expected_avl.begin(), -10000);
+  ExpectTreeMatches(RedBlackTree::join(std::move(big), std::move(small)), expected,
+                    [](auto root) { return RedBlackHeight(root) > 0; });
+  ExpectTreeMatches(AvlTree::join(std::move(small_avl), std::move(big_avl)), expected_avl,
+                    [](auto root) { return AvlValid(root); });
+}
+
+TEST(BinarySearchTreeTest, SplitJoin_OverlappingFallsBackToMerge) {
+  RedBlackTree left;
+  RedBlackTree right;
+  for (int i = 0; i < 10; ++i) {
+    left.insert(i * 2);
+    right.insert(i * 3);
+  }
+  RedBlackTree joined = RedBlackTree::join(std::move(left), std::move(right));
+  std::set<int> expected;
+  for (int i = 0; i < 10; ++i) {
+    expected.insert(i * 2);
+    expected.insert(i * 3);
+  }
+  ExpectTreeMatches(joined, std::vector<int>(expected.begin(), expected.end()),
+                    [](auto root) { return RedBlackHeight(root) > 0; });
+  EXPECT_TRUE(RedBlackTree::join(RedBlackTree(), RedBlackTree()).empty());
+}
+
+template<typename Tree>
+void ExpectAggregatesMatch() {
+  Tree tree;
+  std::set<int> expected;
+  std::mt19937 gen(19);
+  for (int i = 0; i < 3000; ++i) {
+    int value = static_cast<int>(gen() % 1000);
+    switch (gen() % 4) {
+      case 0:
+        tree.erase(value);
+        expected.erase(value);
+        break;
+      case 1:
+        if (tree.contains(value) && !tree.contains(value + 1000)) {
+          // Измененное в node handle значение пересчитывается при вставке
+          auto handle = tree.extract(value);
+          handle.value() = value + 1000;
+          tree.insert(std::move(handle));
+          expected.erase(value);
+          expected.insert(value + 1000);
+        }
+        break;
+      default:
+        tree.insert(value);
+        expected.insert(value);
+    }
+    if (i % 50 == 0) {
+      int lo = static_cast<int>(gen() % 2100) - 50;
+      int hi = lo + static_cast<int>(gen() % 800);
+      EXPECT_EQ(tree.aggregate(lo, hi),
+                std::accumulate(expected.lower_bound(lo), expected.lower_bound(hi), 0));
+    }
+  }
+  EXPECT_EQ(tree.aggregate(), std::accumulate(expected.begin(), expected.end(), 0));
+  EXPECT_EQ(tree.aggregate(500, 100), 0);
+}
+
+TEST(BinarySearchTreeTest, Augment_SumOverRanges) {
+  ExpectAggregatesMatch<BinarySearchTree<int, std::less<int>, std::allocator<int>, NoBalance, SumAugment<int>>>();
+  ExpectAggregatesMatch<BinarySearchTree<int, std::less<int>, std::allocator<int>, RedBlackBalance, SumAugment<int>>>();
+  ExpectAggregatesMatch<BinarySearchTree<int, std::less<int>, std::allocator<int>, AvlBalance, SumAugment<int>>>();
+}
+
+TEST(BinarySearchTreeTest, Augment_MinMax) {
+  BinarySearchTree<int, std::greater<int>, std::allocator<int>, RedBlackBalance, MinAugment<int>> by_min;
+  BinarySearchTree<int, std::less<int>, std::allocator<int>, AvlBalance, MaxAugment<int>> by_max;
+  for (int i = 0; i < 100; ++i) {
+    by_min.insert(i * 3);
+    by_max.insert(i * 3);
+  }
+  // При обратном порядке [lo, hi) идет от большего к меньшему
+  EXPECT_EQ(by_min.aggregate(50, 10), 12);
+  EXPECT_EQ(by_max.aggregate(10, 50), 48);
+  EXPECT_EQ(by_max.aggregate(50, 50), std::numeric_limits<int>::lowest());
+}
+
+// Некоммутативный моноид: сводка - конкатенация значений по порядку
+struct ConcatAugment {
+  using summary_type = std::string;
+
+  static std::string identity() {
+    return std::string();
+  }
+
+  static std::string summarize(const std::string& value) {
+    return value;
+  }
+
+  static std::string combine(const std::string& lhs, const std::string& rhs) {
+    return lhs + rhs;
+  }
+};
+
+TEST(BinarySearchTreeTest, Augment_OrderPreservedThroughRestructuring) {
+  using ConcatTree = BinarySearchTree<std::string, std::less<std::string>, std::allocator<std::string>,
+                                      RedBlackBalance, ConcatAugment>;
+  ConcatTree tree;
+  for (char c : std::string("qwertyuiopasdfghjklzxcvbnm")) {
+    tree.insert(std::string(1, c));
+  }
+  EXPECT_EQ(tree.aggregate(), "abcdefghijklmnopqrstuvwxyz");
+  EXPECT_EQ(tree.aggregate("d", "k"), "defghij");
+
+  ConcatTree copy = tree;
+  auto [less, rest] = copy.split("n");
+  EXPECT_EQ(less.aggregate(), "abcdefghijklm");
+  EXPECT_EQ(rest.aggregate("p", "zz"), "pqrstuvwxyz");
+  ConcatTree joined = ConcatTree::join(std::move(rest), std::move(less));
+  EXPECT_EQ(joined.aggregate("c", "f"), "cde");
+
+  ConcatTree other;
+  other.insert("A");
+  other.insert("m0");
+  tree.merge(other);
+  EXPECT_EQ(tree.aggregate("l", "n"), "lmm0");
+
+  std::vector<std::string> values = {"k", "b", "x", "b"};
+  ThreadPool pool(2);
+  ConcatTree built(pool, values.begin(), values.end());
+  EXPECT_EQ(built.aggregate(), "bkx");
+}
+
+using ThreadedTree = BinarySearchTree<int, std::less<int>, std::allocator<int>, RedBlackBalance, NoAugment, Threaded>;
+
+// Прошивка совпадает с обходом по ссылкам на родителей
+template<typename Tree>
+void ExpectThreadsValid(const Tree& tree, const std::set<int>& expected) {
+  std::vector<int> by_threads;
+  auto node = tree.template begin<InOrder>().get_node();
+  decltype(node) prev = nullptr;
+  for (; node != nullptr; prev = node, node = node->next) {
+    EXPECT_EQ(node->prev, prev);
+    by_threads.push_back(node->value);
+  }
+  EXPECT_EQ(by_threads, std::vector<int>(expected.begin(), expected.end()));
+  ExpectReverseTraversal<InOrder>(tree);
+}
+
+TEST(BinarySearchTreeTest, Threaded_MaintainedByAllOperations) {
+  ThreadedTree tree;
+  std::set<int> expected;
+  std::mt19937 gen(20);
+  for (int i = 0; i < 2000; ++i) {
+    int value = static_cast<int>(gen() % 600);
+    switch (gen() % 4) {
+      case 0:
+        tree.erase(value);
+        expected.erase(value);
+        break;
+      case 1:
+        if (tree.contains(value) && !tree.contains(value + 600)) {
+          auto handle = tree.extract(value);
+          handle.value() = value + 600;
+          tree.insert(std::move(handle));
+          expected.erase(value);
+          expected.insert(value + 600);
+        }
+        break;
+      default:
+        tree.insert(tree.lower_bound(value), value);
+        expected.insert(value);
+    }
+  }
+  ExpectThreadsValid(tree, expected);
+  std::vector<int> pre;
+  std::vector<int> post;
+  CollectPreOrder(tree.begin<PreOrder>().get_node(), pre);
+  CollectPostOrder(tree.begin<PreOrder>().get_node(), post);
+  EXPECT_EQ(std::vector<int>(tree.begin<PreOrder>(), tree.end<PreOrder>()), pre);
+  EXPECT_EQ(std::vector<int>(tree.begin<PostOrder>(), tree.end<PostOrder>()), post);
+
+  ThreadedTree copy = tree;
+  ExpectThreadsValid(copy, expected);
+  auto [less, rest] = copy.split(300);
+  ExpectThreadsValid(less, std::set<int>(expected.begin(), expected.lower_bound(300)));
+  ExpectThreadsValid(rest, std::set<int>(expected.lower_bound(300), expected.end()));
+  ThreadedTree joined = ThreadedTree::join(std::move(rest), std::move(less));
+  ExpectThreadsValid(joined, expected);
+
+  ThreadedTree other;
+  for (int i = 0; i < 50; ++i) {
+    other.insert(i * 37);
+    expected.insert(i * 37);
+  }
+  tree.merge(other);
+  ExpectThreadsValid(tree, expected);
+}
+
+TEST(BinarySearchTreeTest, Threaded_Builds) {
+  std::vector<int> values = {9, 3, 7, 1, 3, 5};
+  std::set<int> expected(values.begin(), values.end());
+  ThreadPool pool(2);
+  ThreadedTree built(pool, values.begin(), values.end());
+  ExpectThreadsValid(built, expected);
+  ThreadedTree sorted(SortedUnique(), expected.begin(), expected.end());
+  ExpectThreadsValid(sorted, expected);
+  sorted.erase(*sorted.begin<InOrder>());
+  sorted.erase(*--sorted.end<InOrder>());
+  ExpectThreadsValid(sorted, std::set<int>({3, 5, 7}));
+}
+
+TEST(BinarySearchTreeTest, Serialize_RoundTrip) {
+  // Отсортированный дамп в несбалансированное дерево: загрузка строит сбалансированное за O(n)
+  std::vector<int> values(100000);
+  std::iota(values.begin(), values.end(), -50000);
+  BinarySearchTree<int> tree(SortedUnique(), values.begin(), values.end());
+  std::stringstream stream;
+  tree.save(stream);
+  BinarySearchTree<int> loaded;
+  loaded.insert(7);
+  loaded.load(stream);
+  EXPECT_TRUE(std::equal(loaded.begin<InOrder>(), loaded.end<InOrder>(), values.begin(), values.end()));
+  EXPECT_EQ(std::vector<int>(loaded.begin<PreOrder>(), loaded.end<PreOrder>()),
+            std::vector<int>(tree.begin<PreOrder>(), tree.end<PreOrder>()));
+
+  // Формат не зависит от балансировки, прошивки и аугментации
+  std::stringstream small;
+  BinarySearchTree<int>(SortedUnique(), values.begin(), values.begin() + 1000).save(small);
+  ThreadedTree threaded;
+  threaded.load(small);
+  ExpectThreadsValid(threaded, std::set<int>(values.begin(), values.begin() + 1000));
+  small.clear();
+  small.seekg(0);
+  BinarySearchTree<int, std::less<int>, std::allocator<int>, AvlBalance, SumAugment<int>> summed;
+  summed.load(small);
+  EXPECT_EQ(summed.aggregate(), std::accumulate(values.begin(), values.begin() + 1000, 0));
+
+  std::stringstream empty;
+  BinarySearchTree<int>().save(empty);
+  loaded.load(empty);
+  EXPECT_TRUE(loaded.empty());
+}
+
+// Тривиально копируемый тип без конструктора по умолчанию
+struct RawPoint {
+  std::int32_t x;
+  std::int32_t y;
+
+  RawPoint(std::int32_t x, std::int32_t y) : x(x), y(y) {}
+
+  bool operator<(const RawPoint& other) const {
+    return x < other.x || (x == other.x && y < other.y);
+  }
+};
+
+TEST(BinarySearchTreeTest, Serialize_RawTypeWithoutDefaultConstructor) {
+  // Больше одного блока ввода-вывода
+  BinarySearchTree<RawPoint> tree;
+  for (std::int32_t i = 0; i < 20000; ++i) {
+    tree.insert(tree.end<InOrder>(), RawPoint(i / 3, i));
+  }
+  std::stringstream stream;
+  tree.save(stream);
+  BinarySearchTree<RawPoint> loaded;
+  loaded.load(stream);
+  ASSERT_EQ(loaded.size(), tree.size());
+  auto expected = tree.begin<InOrder>();
+  for (auto it = loaded.begin<InOrder>(); it != loaded.end<InOrder>(); ++it, ++expected) {
+    EXPECT_EQ(it->x, expected->x);
+    EXPECT_EQ(it->y, expected->y);
+  }
+}
+
+TEST(BinarySearchTreeTest, Serialize_Strings) {
+  BinarySearchTree<std::string, std::less<std::string>, std::allocator<std::string>, RedBlackBalance> tree;
+  for (int i = 0; i < 500; ++i) {
+    tree.insert(std::string(static_cast<std::size_t>(i % 37), 'a') + std::to_string(i));
+  }
+  tree.insert("");
+  std::stringstream stream;
+  tree.save(stream);
+  decltype(tree) loaded;
+  loaded.load(stream);
+  EXPECT_EQ(std::vector<std::string>(loaded.begin<InOrder>(), loaded.end<InOrder>()),
+            std::vector<std::string>(tree.begin<InOrder>(), tree.end<InOrder>()));
+  EXPECT_EQ(loaded.size(), 501u);
+}
+
+TEST(BinarySearchTreeTest, Serialize_RejectsDamagedData) {
+  std::vector<int> values = {1, 2, 3, 4};
+  BinarySearchTree<int> tree(SortedUnique(), values.begin(), values.end());
+  std::stringstream stream;
+  tree.save(stream);
+  std::string bytes = stream.str();
+  BinarySearchTree<int> loaded;
+  loaded.insert(42);
+  auto expect_rejected = [&loaded](const std::string& data) {
+    std::stringstream damaged(data);
+    EXPECT_THROW(loaded.load(damaged), FormatError);
+    // Дерево при ошибке не меняется
+    EXPECT_EQ(std::vector<int>(loaded.begin<InOrder>(), loaded.end<InOrder>()), std::vector<int>({42}));
+  };
+  expect_rejected(bytes.substr(0, bytes.size() - 1));
+  expect_rejected(bytes.substr(0, 10));
+  expect_rejected("XXXX" + bytes.substr(4));
+  std::string unsorted = bytes;
+  std::swap(unsorted[unsorted.size() - 4], unsorted[unsorted.size() - 8]);
+  expect_rejected(unsorted);
+  std::stringstream doubles;
+  BinarySearchTree<double> other;
+  other.insert(1.0);
+  other.save(doubles);
+  expect_rejected(doubles.str());
+}
+
+using SmallBTree = BTree<int, std::less<int>, std::allocator<int>, 16>;
+
+TEST(BTreeTest, SplitAndTraversalOrders) {
+  SmallBTree tree;
+  ASSERT_EQ(SmallBTree::node_capacity(), 3);
+  for (int i : {1, 2, 3, 4}) {
+    tree.insert(i);
+  }
+  // Корень [2], листья [1] и [3, 4]
+  EXPECT_EQ(std::vector<int>(tree.begin<InOrder>(), tree.end<InOrder>()), std::vector<int>({1, 2, 3, 4}));
+  EXPECT_EQ(std::vector<int>(tree.begin<PreOrder>(), tree.end<PreOrder>()), std::vector<int>({2, 1, 3, 4}));
+  EXPECT_EQ(std::vector<int>(tree.begin<PostOrder>(), tree.end<PostOrder>()), std::vector<int>({1, 3, 4, 2}));
+  EXPECT_EQ(*tree.rbegin<PostOrder>(), 2);
+  EXPECT_EQ(*tree.rbegin<PreOrder>(), 4);
+}
+
+TEST(BTreeTest, RandomOperationsMatchStdSet) {
+  SmallBTree tree;
+  std::set<int> expected;
+  std::mt19937 gen(123);
+  std::uniform_int_distribution<int> dist(0, 300);
+  for (int step = 0; step < 3000; ++step) {
+    int value = dist(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(tree.erase(value), expected.erase(value));
+    } else {
+      EXPECT_EQ(tree.insert(value).second, expected.insert(value).second);
+    }
+  }
+  ASSERT_EQ(tree.size(), expected.size());
+  EXPECT_EQ(std::vector<int>(tree.begin<InOrder>(), tree.end<InOrder>()),
+            std::vector<int>(expected.begin(), expected.end()));
+  ExpectReverseTraversal<InOrder>(tree);
+  ExpectReverseTraversal<PreOrder>(tree);
+  ExpectReverseTraversal<PostOrder>(tree);
+  for (int key = -1; key <= 301; ++key) {
+    EXPECT_EQ(tree.contains(key), expected.count(key) == 1);
+    auto lower = expected.lower_bound(key);
+    auto upper = expected.upper_bound(key);
+    EXPECT_EQ(tree.lower_bound(key) == tree.end<InOrder>(), lower == expected.end());
+    EXPECT_EQ(tree.upper_bound(key) == tree.end<InOrder>(), upper == expected.end());
+    if (lower != expected.end()) {
+      EXPECT_EQ(*tree.lower_bound(key), *lower);
+    }
+    if (upper != expected.end()) {
+      EXPECT_EQ(*tree.upper_bound(key), *upper);
+    }
+    EXPECT_EQ(tree.rank(key), static_cast<std::size_t>(std::distance(expected.begin(), lower)));
+  }
+  std::size_t k = 0;
+  for (int value : expected) {
+    EXPECT_EQ(*tree.select(k++), value);
+  }
+  EXPECT_TRUE(tree.select(k) == tree.end<InOrder>());
+}
+
+TEST(BTreeTest, EraseAll) {
+  std::vector<int> values(10);
+  std::iota(values.begin(), values.end(), 1);
+  SmallBTree sorted(SortedUnique(), values.begin(), values.end());
+  EXPECT_EQ(std::vector<int>(sorted.begin<InOrder>(), sorted.end<InOrder>()), values);
+  for (int i : {5, 1, 10, 3, 7, 2, 9, 4, 8, 6}) {
+    EXPECT_EQ(sorted.erase(i), 1);
+    ExpectReverseTraversal<InOrder>(sorted);
+  }
+  EXPECT_TRUE(sorted.empty());
+  EXPECT_EQ(sorted.begin<PreOrder>(), sorted.end<PreOrder>());
+  sorted.insert(1);
+  EXPECT_EQ(sorted.size(), 1);
+}
+
+TEST(BTreeTest, CopyMoveMerge) {
+  SmallBTree first;
+  for (int i = 0; i < 50; i += 2) {
+    first.insert(i);
+  }
+  SmallBTree copy(first);
+  first.insert(1);
+  EXPECT_EQ(copy.size(), 25);
+  EXPECT_FALSE(copy.contains(1));
+
+  SmallBTree moved(std::move(copy));
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(moved.size(), 25);
+
+  SmallBTree source;
+  for (int i = 0; i < 10; ++i) {
+    source.insert(i);
+  }
+  moved.merge(source);
+  EXPECT_EQ(moved.size(), 30); // Добавились нечетные 1, 3, 5, 7, 9
+  EXPECT_EQ(std::vector<int>(source.begin<InOrder>(), source.end<InOrder>()), std::vector<int>({0, 2, 4, 6, 8}));
+  EXPECT_EQ(moved.count_range(0, 10), 10);
+}
+
+TEST(BTreeTest, SameInterfaceAsBinarySearchTree) {
+  // Контейнеры взаимозаменяемы через псевдоним типа
+  using Set = BTree<std::string, StringLess>;
+  Set set;
+  set.emplace("banana");
+  set.insert("apple");
+  auto hint = set.insert(set.end<InOrder>(), "cherry");
+  EXPECT_EQ(*hint, "cherry");
+  EXPECT_EQ(*set.emplace_hint(set.begin<InOrder>(), "avocado"), "avocado");
+  EXPECT_FALSE(set.insert("apple").second);
+  EXPECT_TRUE(set.contains(std::string_view("banana")));
+  EXPECT_EQ(*set.find(std::string_view("cherry")), "cherry");
+  EXPECT_EQ(set.erase(std::string_view("banana")), 1);
+  EXPECT_EQ(*set.findMin(), "apple");
+  EXPECT_EQ(*set.findMax(), "cherry");
+  auto frozen = set.freeze();
+  EXPECT_EQ(frozen.size(), 3);
+  EXPECT_EQ(frozen[1], "avocado");
+}
+
+TEST(BTreeTest, LargeNodes) {
+  BTree<int> tree;
+  EXPECT_GT(BTree<int>::node_capacity(), 32);
+  for (int i = 10000; i > 0; --i) {
+    tree.insert(i);
+  }
+  EXPECT_EQ(tree.size(), 10000);
+  EXPECT_EQ(*tree.select(4999), 5000);
+  for (int i = 1; i <= 10000; i += 2) {
+    tree.erase(i);
+  }
+  EXPECT_EQ(tree.size(), 5000);
+  EXPECT_EQ(*tree.begin<InOrder>(), 2);
+  ExpectReverseTraversal<InOrder>(tree);
+  ExpectReverseTraversal<PostOrder>(tree);
+}
+
+TEST(BTreeTest, InternalNodesFitNodeBytes) {
+  EXPECT_LE(BTree<int>::leaf_node_bytes(), 256);
+  EXPECT_LE(BTree<int>::internal_node_bytes(), 256);
+  EXPECT_LT(BTree<int>::internal_node_capacity(), BTree<int>::node_capacity());
+  EXPECT_LE((BTree<char, std::less<char>, std::allocator<char>, 100>::internal_node_bytes()), 100);
+  EXPECT_LE((BTree<long double>::internal_node_bytes()), 256);
+
+  // Внутренние узлы делятся и сливаются по своей вместимости, отличной от вместимости листа
+  BTree<int> tree;
+  std::set<int> expected;
+  std::mt19937 gen(12);
+  std::uniform_int_distribution<int> dist(0, 200000);
+  for (int i = 0; i < 100000; ++i) {
+    int value = dist(gen);
+    tree.insert(value);
+    expected.insert(value);
+  }
+  for (int i = 0; i < 80000; ++i) {
+    int value = dist(gen);
+    EXPECT_EQ(tree.erase(value), expected.erase(value));
+  }
+  ASSERT_EQ(tree.size(), expected.size());
+  EXPECT_TRUE(std::equal(tree.begin<InOrder>(), tree.end<InOrder>(), expected.begin(), expected.end()));
+  ExpectReverseTraversal<PreOrder>(tree);
+}
+
+TEST(BTreeTest, MergeExceptionLeavesSourceIntact) {
+  BTree<ThrowingCopy> tree;
+  BTree<ThrowingCopy> source;
+  for (int i = 0; i < 300; ++i) {
+    if (i % 3 == 0) {
+      tree.insert(ThrowingCopy(i));
+    }
+    source.insert(ThrowingCopy(i));
+  }
+  ThrowingCopy::copies_left = 100;
+  EXPECT_THROW(tree.merge(source), std::runtime_error);
+  ASSERT_EQ(source.size(), 300u);
+  int expected = 0;
+  for (auto it = source.begin<InOrder>(); it != source.end<InOrder>(); ++it) {
+    EXPECT_EQ(it->value, expected++);
+  }
+  std::size_t present = tree.size();
+  EXPECT_GT(present, 100u);
+
+  ThrowingCopy::copies_left = 1000;
+  tree.merge(source);
+  EXPECT_EQ(tree.size(), 300u);
+  EXPECT_EQ(source.size(), present); // В source остались только уже имевшиеся в дереве
+}
+
+TEST(ConcurrentTreeTest, MatchesStdSet) {
+  ConcurrentTree<int> tree;
+  std::set<int> expected;
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<int> dist(0, 500);
+  for (int step = 0; step < 3000; ++step) {
+    int value = dist(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(tree.erase(value), expected.erase(value));
+    } else {
+      EXPECT_EQ(tree.insert(value), expected.insert(value).second);
+    }
+  }
+  auto snapshot = tree.snapshot();
+  EXPECT_EQ(snapshot.size(), expected.size());
+  EXPECT_EQ(std::vector<int>(snapshot.begin(), snapshot.end()), std::vector<int>(expected.begin(), expected.end()));
+  for (int key = -1; key <= 501; ++key) {
+    EXPECT_EQ(tree.contains(key), expected.count(key) == 1);
+    auto lower = expected.lower_bound(key);
+    EXPECT_EQ(tree.lower_bound(key), lower != expected.end() ? std::optional<int>(*lower) : std::nullopt);
+    auto upper = expected.upper_bound(key);
+    EXPECT_EQ(snapshot.upper_bound(key) == snapshot.end(), upper == expected.end());
+  }
+}
+
+TEST(ConcurrentTreeTest, EpochReservationRetiresAfterPublish) {
+  EpochDomain domain;
+  int freed = 0;
+  auto count_free = [](void* context, void*) { ++*static_cast<int*>(context); };
+  int objects[3];
+  {
+    EpochDomain::Reservation reservation(domain, 3);
+    reservation.retire(&objects[0], count_free, &freed);
+    reservation.retire(&objects[1], count_free, &freed);
+  }
+  EXPECT_EQ(domain.pending(), 2u);
+  domain.retire(&objects[2], count_free, &freed); // Неиспользованная запись вернулась в запас
+  {
+    EpochDomain::Guard guard(domain);
+    domain.collect();
+    EXPECT_EQ(freed, 0); // Читатель мог видеть объекты, освобождать их рано
+  }
+  domain.drain();
+  EXPECT_EQ(freed, 3);
+  EXPECT_EQ(domain.pending(), 0u);
+
+  // clear резервирует записи на все узлы до того, как дерево становится пустым
+  ConcurrentTree<int> tree;
+  for (int i = 0; i < 1000; ++i) {
+    tree.insert(i);
+  }
+  auto snapshot = tree.snapshot();
+  tree.clear();
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(snapshot.size(), 1000u);
+  EXPECT_EQ(*snapshot.find(999), 999);
+}
+
+TEST(ConcurrentTreeTest, SnapshotIsStable) {
+  ConcurrentTree<std::string> tree;
+  tree.insert("a");
+  tree.insert("b");
+  auto snapshot = tree.snapshot();
+  tree.insert("c");
+  tree.erase(std::string("a"));
+  tree.clear();
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(std::vector<std::string>(snapshot.begin(), snapshot.end()), std::vector<std::string>({"a", "b"}));
+  EXPECT_EQ(*snapshot.find(std::string("b")), "b");
+  EXPECT_EQ(tree.find(std::string("b")), std::nullopt);
+}
+
+// Писатель вставляет и удаляет нечетные ключи, читатели без блокировок проверяют,
+// что четные ключи видны всегда, а каждая версия дерева упорядочена
+TEST(ConcurrentTreeTest, ReadersDuringWrites) {
+  ConcurrentTree<int> tree;
+  const int kRange = 2000;
+  for (int i = 0; i < kRange; i += 2) {
+    tree.insert(i);
+  }
+  std::atomic<bool> done{false};
+  std::atomic<int> errors{0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&tree, &done, &errors, r] {
+      std::mt19937 gen(r);
+      while (!done.load()) {
+        int key = static_cast<int>(gen() % kRange) & ~1;
+        if (!tree.contains(key) || tree.lower_bound(key) != key) {
+          ++errors;
+        }
+        auto snapshot = tree.snapshot();
+        int previous = -1;
+        std::size_t count = 0;
+        for (int value : snapshot) {
+          if (value <= previous) {
+            ++errors;
+          }
+          previous = value;
+          ++count;
+        }
+        if (count != snapshot.size()) {
+          ++errors;
+        }
+      }
+    });
+  }
+  std::mt19937 gen(99);
+  for (int step = 0; step < 20000; ++step) {
+    int key = static_cast<int>(gen() % kRange) | 1;
+    if (gen() % 2 == 0) {
+      tree.insert(key);
+    } else {
+      tree.erase(key);
+    }
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(errors.load(), 0);
+}
+
+TEST(FineGrainedTreeTest, MatchesStdSet) {
+  FineGrainedTree<int> tree;
+  std::set<int> expected;
+  EXPECT_TRUE(tree.empty());
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<int> dist(0, 300);
+  for (int step = 0; step < 3000; ++step) {
+    int value = dist(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(tree.erase(value), expected.erase(value));
+    } else {
+      EXPECT_EQ(tree.insert(value), expected.insert(value).second);
+    }
+  }
+  std::vector<int> values;
+  tree.for_each([&values](int value) { values.push_back(value); });
+  EXPECT_EQ(values, std::vector<int>(expected.begin(), expected.end()));
+  EXPECT_EQ(tree.size(), expected.size());
+  for (int key = -1; key <= 301; ++key) {
+    EXPECT_EQ(tree.contains(key), expected.count(key) == 1);
+  }
+}
+
+TEST(FineGrainedTreeTest, SortedInsertionDestroysWithoutRecursion) {
+  FineGrainedTree<std::string> tree;
+  for (int i = 0; i < 3000; ++i) {
+    tree.insert(std::to_string(100000 + i)); // Вырожденное дерево глубины n
+  }
+  EXPECT_TRUE(tree.contains(std::string("100500")));
+  EXPECT_EQ(tree.erase(std::string("100500")), 1);
+  EXPECT_FALSE(tree.contains(std::string("100500")));
+}
+
+// Каждый поток вставляет свою полосу ключей и удаляет из нее половину, соседние полосы
+// перемежаются, поэтому потоки постоянно меняют одни и те же участки дерева
+TEST(FineGrainedTreeTest, ConcurrentWriters) {
+  FineGrainedTree<int> tree;
+  const int kThreads = 4;
+  const int kPerThread = 2000;
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kThreads; ++t) {
+    writers.emplace_back([&tree, t] {
+      for (int i = 0; i < kPerThread; ++i) {
+        tree.insert(i * kThreads + t);
+      }
+      for (int i = 0; i < kPerThread; i += 2) {
+        tree.erase(i * kThreads + t);
+      }
+      for (int i = 1; i < kPerThread; i += 2) {
+        if (!tree.contains(i * kThreads + t)) {
+          ADD_FAILURE() << "missing " << i * kThreads + t;
+        }
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  std::vector<int> values;
+  tree.for_each([&values](int value) { values.push_back(value); });
+  ASSERT_EQ(values.size(), static_cast<std::size_t>(kThreads * kPerThread / 2));
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    int index = values[i] / kThreads;
+    EXPECT_EQ(index % 2, 1);
+    if (i > 0) {
+      EXPECT_LT(values[i - 1], values[i]);
+    }
+  }
+}
+
+TEST(PersistentTreeTest, TraversalOrders) {
+  PersistentTree<int> tree;
+  for (int i = 1; i <= 7; ++i) {
+    EXPECT_EQ(*tree.insert(i).first, i);
+  }
+  EXPECT_EQ(std::vector<int>(tree.begin<InOrder>(), tree.end<InOrder>()), std::vector<int>({1, 2, 3, 4, 5, 6, 7}));
+  EXPECT_EQ(std::vector<int>(tree.begin<PreOrder>(), tree.end<PreOrder>()), std::vector<int>({4, 2, 1, 3, 6, 5, 7}));
+  EXPECT_EQ(std::vector<int>(tree.begin<PostOrder>(), tree.end<PostOrder>()), std::vector<int>({1, 3, 2, 5, 7, 6, 4}));
+  EXPECT_EQ(*tree.rbegin<PreOrder>(), 7);
+  EXPECT_EQ(*tree.rbegin<PostOrder>(), 4);
+  ExpectReverseTraversal<InOrder>(tree);
+  ExpectReverseTraversal<PreOrder>(tree);
+  ExpectReverseTraversal<PostOrder>(tree);
+}
+
+TEST(PersistentTreeTest, MatchesStdSet) {
+  PersistentTree<int> tree;
+  std::set<int> expected;
+  std::mt19937 gen(15);
+  std::uniform_int_distribution<int> dist(0, 500);
+  for (int i = 0; i < 3000; ++i) {
+    int value = dist(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(tree.erase(value), expected.erase(value));
+    } else {
+      auto [it, inserted] = tree.insert(value);
+      EXPECT_EQ(inserted, expected.insert(value).second);
+      EXPECT_EQ(*it, value);
+      EXPECT_TRUE(it == tree.begin<InOrder>() || *std::prev(it) < value);
+    }
+  }
+  EXPECT_EQ(std::vector<int>(tree.begin<InOrder>(), tree.end<InOrder>()),
+            std::vector<int>(expected.begin(), expected.end()));
+  EXPECT_EQ(tree.size(), expected.size());
+  for (int value = -1; value <= 501; ++value) {
+    auto lower = expected.lower_bound(value);
+    auto upper = expected.upper_bound(value);
+    EXPECT_EQ(tree.lower_bound(value) == tree.end<InOrder>(), lower == expected.end());
+    if (lower != expected.end()) {
+      EXPECT_EQ(*tree.lower_bound(value), *lower);
+    }
+    if (upper != expected.end()) {
+      EXPECT_EQ(*tree.upper_bound(value), *upper);
+    }
+    EXPECT_EQ(tree.contains(value), expected.count(value) == 1);
+    EXPECT_EQ(tree.rank(value), static_cast<std::size_t>(std::distance(expected.begin(), lower)));
+  }
+  EXPECT_EQ(*tree.select(3), *std::next(expected.begin(), 3));
+  EXPECT_EQ(tree.select(tree.size()), tree.end<InOrder>());
+  ExpectReverseTraversal<PreOrder>(tree);
+  ExpectReverseTraversal<PostOrder>(tree);
+}
+
+TEST(PersistentTreeTest, SnapshotsAreIndependent) {
+  PersistentTree<std::string> tree;
+  std::vector<PersistentTree<std::string>> snapshots;
+  std::vector<std::vector<std::string>> expected;
+  std::set<std::string> current;
+  std::mt19937 gen(7);
+  for (int i = 0; i < 400; ++i) {
+    std::string value = std::to_string(gen() % 100);
+    if (gen() % 4 == 0) {
+      tree.erase(value);
+      current.erase(value);
+    } else {
+      tree.insert(value);
+      current.insert(value);
+    }
+    if (i % 20 == 0) {
+      snapshots.push_back(tree.snapshot());
+      expected.emplace_back(current.begin(), current.end());
+    }
+  }
+  // Изменение снимка не затрагивает ни дерево, ни другие снимки
+  snapshots[3].clear();
+  snapshots[4].insert("new");
+  expected[3].clear();
+  expected[4].insert(std::lower_bound(expected[4].begin(), expected[4].end(), "new"), "new");
+  tree = PersistentTree<std::string>();
+  for (std::size_t i = 0; i < snapshots.size(); ++i) {
+    EXPECT_EQ(std::vector<std::string>(snapshots[i].begin<InOrder>(), snapshots[i].end<InOrder>()), expected[i]);
+    EXPECT_EQ(snapshots[i].size(), expected[i].size());
+  }
+}
+
+TEST(PersistentTreeTest, SnapshotsReadInOtherThreads) {
+  PersistentTree<int> tree;
+  std::vector<std::thread> readers;
+  for (int round = 0; round < 4; ++round) {
+    for (int i = 0; i < 500; ++i) {
+      tree.insert(round * 500 + i);
+    }
+    tree.erase(round * 500);
+    // Читатель владеет своим снимком, писатель продолжает менять дерево
+    readers.emplace_back([snapshot = tree.snapshot(), round] {
+      long long sum = std::accumulate(snapshot.begin<InOrder>(), snapshot.end<InOrder>(), 0LL);
+      long long expected = 0;
+      for (int i = 0; i < (round + 1) * 500; ++i) {
+        expected += i % 500 == 0 ? 0 : i;
+      }
+      EXPECT_EQ(sum, expected);
+    });
+  }
+  tree.clear();
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+}
+
+TEST(CompactTreeTest, TraversalOrdersMatchRedBlackTree) {
+  CompactTree<int> tree;
+  RedBlackTree reference;
+  std::mt19937 gen(21);
+  for (int i = 0; i < 300; ++i) {
+    int value = static_cast<int>(gen() % 1000);
+    EXPECT_EQ(tree.insert(value).second, reference.insert(value).second);
+  }
+  // Та же балансировка дает ту же форму дерева
+  EXPECT_EQ(std::vector<int>(tree.begin<PreOrder>(), tree.end<PreOrder>()),
+            std::vector<int>(reference.begin<PreOrder>(), reference.end<PreOrder>()));
+  EXPECT_EQ(std::vector<int>(tree.begin<PostOrder>(), tree.end<PostOrder>()),
+            std::vector<int>(reference.begin<PostOrder>(), reference.end<PostOrder>()));
+  ExpectReverseTraversal<InOrder>(tree);
+  ExpectReverseTraversal<PreOrder>(tree);
+  ExpectReverseTraversal<PostOrder>(tree);
+}
+
+TEST(CompactTreeTest, MatchesStdSet) {
+  CompactTree<int> tree;
+  std::set<int> expected;
+  std::mt19937 gen(22);
+  std::uniform_int_distribution<int> dist(0, 500);
+  for (int i = 0; i < 5000; ++i) {
+    int value = dist(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(tree.erase(value), expected.erase(value));
+    } else {
+      auto [it, inserted] = tree.insert(value);
+      EXPECT_EQ(inserted, expected.insert(value).second);
+      EXPECT_EQ(*it, value);
+    }
+  }
+  EXPECT_EQ(std::vector<int>(tree.begin<InOrder>(), tree.end<InOrder>()),
+            std::vector<int>(expected.begin(), expected.end()));
+  EXPECT_EQ(tree.size(), expected.size());
+  for (int value = -1; value <= 501; ++value) {
+    auto lower = expected.lower_bound(value);
+    auto upper = expected.upper_bound(value);
+    EXPECT_EQ(tree.lower_bound(value) == tree.end<InOrder>(), lower == expected.end());
+    if (lower != expected.end()) {
+      EXPECT_EQ(*tree.lower_bound(value), *lower);
+    }
+    if (upper != expected.end()) {
+      EXPECT_EQ(*tree.upper_bound(value), *upper);
+    }
+    EXPECT_EQ(tree.count(value), expected.count(value));
+    EXPECT_EQ(tree.rank(value), static_cast<std::size_t>(std::distance(expected.begin(), lower)));
+  }
+  EXPECT_EQ(*tree.select(5), *std::next(expected.begin(), 5));
+  EXPECT_EQ(tree.select(tree.size()), tree.end<InOrder>());
+
+  // Удаление по итератору возвращает следующий элемент
+  auto it = tree.begin<InOrder>();
+  while (it != tree.end<InOrder>()) {
+    it = *it % 2 == 0 ? tree.erase(it) : std::next(it);
+  }
+  for (auto value = expected.begin(); value != expected.end();) {
+    value = *value % 2 == 0 ? expected.erase(value) : std::next(value);
+  }
+  EXPECT_EQ(std::vector<int>(tree.begin<InOrder>(), tree.end<InOrder>()),
+            std::vector<int>(expected.begin(), expected.end()));
+}
+
+TEST(CompactTreeTest, SlotsAreReusedAndIteratorsSurviveGrowth) {
+  CompactTree<std::string> tree;
+  auto first = tree.insert("m").first;
+  for (int i = 0; i < 1000; ++i) {
+    tree.insert(std::to_string(i));
+  }
+  EXPECT_EQ(*first, "m"); // Итератор хранит индекс и переживает перенос массива
+  CompactTree<std::string> copy = tree;
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(tree.erase(std::to_string(i)), 1u);
+  }
+  EXPECT_EQ(tree.size(), 1u);
+  EXPECT_EQ(copy.size(), 1001u);
+  EXPECT_TRUE(copy.contains("500"));
+  for (int i = 0; i < 1000; ++i) {
+    tree.emplace(3, 'x');
+  }
+  EXPECT_EQ(std::vector<std::string>(tree.begin<InOrder>(), tree.end<InOrder>()),
+            std::vector<std::string>({"m", "xxx"}));
+  CompactTree<std::string> moved = std::move(copy);
+  EXPECT_TRUE(copy.empty());
+  copy.insert("again");
+  EXPECT_EQ(copy.size(), 1u);
+  EXPECT_EQ(moved.size(), 1001u);
+  moved.clear();
+  EXPECT_TRUE(moved.empty());
+  EXPECT_EQ(moved.begin<PostOrder>(), moved.end<PostOrder>());
+}
+
+template<typename Order, typename Tree>
+void ExpectEmptyCompactTree(const Tree& tree) {
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.size(), 0u);
+  EXPECT_EQ(tree.template begin<Order>(), tree.template end<Order>());
+  EXPECT_EQ(tree.template rbegin<Order>(), tree.template rend<Order>());
+  auto it = tree.template end<Order>();
+  --it;
+  EXPECT_EQ(it, tree.template end<Order>());
+}
+
+TEST(CompactTreeTest, MovedFromAndEmptyTreesAreUsable) {
+  CompactTree<int> empty;
+  ExpectEmptyCompactTree<InOrder>(empty);
+  ExpectEmptyCompactTree<PreOrder>(empty);
+  ExpectEmptyCompactTree<PostOrder>(empty);
+
+  CompactTree<int> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(i);
+  }
+  CompactTree<int> moved = std::move(tree);
+  ExpectEmptyCompactTree<InOrder>(tree);
+  ExpectEmptyCompactTree<PreOrder>(tree);
+  ExpectEmptyCompactTree<PostOrder>(tree);
+  EXPECT_FALSE(tree.contains(5));
+  EXPECT_EQ(tree.erase(5), 0u);
+  EXPECT_EQ(tree.lower_bound(5), tree.end<InOrder>());
+  EXPECT_EQ(tree.rank(5), 0u);
+  EXPECT_EQ(*moved.rbegin<InOrder>(), 99);
+  EXPECT_EQ(moved.size(), 100u);
+
+  tree.insert(7);
+  EXPECT_EQ(*tree.rbegin<InOrder>(), 7);
+  EXPECT_EQ(*--tree.end<PreOrder>(), 7);
+  tree = std::move(moved);
+  ExpectEmptyCompactTree<InOrder>(moved);
+  EXPECT_EQ(tree.size(), 100u);
+}
+
+TEST(CompactTreeTest, IteratorsOfDifferentTreesDiffer) {
+  CompactTree<int> first;
+  CompactTree<int> second;
+  EXPECT_NE(first.end<InOrder>(), second.end<InOrder>());
+  first.insert(1);
+  second.insert(1);
+  // Одинаковые индексы в разных деревьях - разные позиции
+  EXPECT_NE(first.begin<InOrder>(), second.begin<InOrder>());
+  EXPECT_NE(first.find(1), second.find(1));
+
+  for (int i = 2; i <= 10; ++i) {
+    second.insert(i);
+  }
+  first.swap(second);
+  // После обмена итераторы берутся заново у каждого дерева
+  EXPECT_EQ(std::vector<int>(first.begin<InOrder>(), first.end<InOrder>()),
+            std::vector<int>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+  EXPECT_EQ(std::vector<int>(second.rbegin<InOrder>(), second.rend<InOrder>()), std::vector<int>({1}));
+  EXPECT_EQ(*first.rbegin<InOrder>(), 10);
+  EXPECT_EQ(std::distance(first.begin<PostOrder>(), first.end<PostOrder>()), 10);
+  EXPECT_EQ(std::distance(second.begin<PreOrder>(), second.end<PreOrder>()), 1);
+}
+
+TEST(CompactTreeTest, UsesLessThanHalfTheMemoryOfNodes) {
+  // Узел RedBlackTree с int: значение, три указателя, размер и цвет - 6 машинных слов
+  EXPECT_LE(CompactTree<int>::node_bytes() * 2, 6 * sizeof(void*));
+  EXPECT_EQ(CompactTree<int>::node_bytes(), sizeof(int) + 4 * sizeof(std::uint32_t));
+}
+
+std::string WriteMappedFile(const std::string& name, const std::vector<int>& values) {
+  std::string path = testing::TempDir() + name;
+  std::ofstream out(path, std::ios::binary);
+  MappedTree<int>::write(out, values.begin(), values.size());
+  return path;
+}
+
+TEST(MappedTreeTest, LookupsMatchStdSet) {
+  std::set<int> expected;
+  std::mt19937 gen(23);
+  for (int i = 0; i < 5000; ++i) {
+    expected.insert(static_cast<int>(gen() % 20000));
+  }
+  std::string path = WriteMappedFile("mapped_lookups.bin", std::vector<int>(expected.begin(), expected.end()));
+  MappedTree<int> tree(path.c_str());
+  EXPECT_EQ(tree.size(), expected.size());
+  EXPECT_TRUE(std::equal(tree.begin<InOrder>(), tree.end<InOrder>(), expected.begin(), expected.end()));
+  for (int value = -1; value <= 20001; value += 3) {
+    auto lower = expected.lower_bound(value);
+    auto upper = expected.upper_bound(value);
+    EXPECT_EQ(tree.contains(value), expected.count(value) == 1);
+    EXPECT_EQ(tree.find(value) == tree.end<InOrder>(), expected.count(value) == 0);
+    EXPECT_EQ(tree.lower_bound(value) == tree.end<InOrder>(), lower == expected.end());
+    if (lower != expected.end()) {
+      EXPECT_EQ(*tree.lower_bound(value), *lower);
+    }
+    if (upper != expected.end()) {
+      EXPECT_EQ(*tree.upper_bound(value), *upper);
+    }
+    EXPECT_EQ(tree.rank(value), static_cast<std::size_t>(std::distance(expected.begin(), lower)));
+  }
+  EXPECT_EQ(*tree.select(10), *std::next(expected.begin(), 10));
+  std::remove(path.c_str());
+}
+
+TEST(MappedTreeTest, TraversalOrdersMatchSortedBuild) {
+  std::vector<int> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  std::string path = WriteMappedFile("mapped_orders.bin", values);
+  BinarySearchTree<int> reference(SortedUnique(), values.begin(), values.end());
+  MappedTree<int> tree(path.c_str());
+  std::remove(path.c_str()); // Отображение остается действительным и после удаления файла
+  EXPECT_EQ(std::vector<int>(tree.begin<PreOrder>(), tree.end<PreOrder>()),
+            std::vector<int>(reference.begin<PreOrder>(), reference.end<PreOrder>()));
+  EXPECT_EQ(std::vector<int>(tree.begin<PostOrder>(), tree.end<PostOrder>()),
+            std::vector<int>(reference.begin<PostOrder>(), reference.end<PostOrder>()));
+  ExpectReverseTraversal<InOrder>(tree);
+  ExpectReverseTraversal<PreOrder>(tree);
+  ExpectReverseTraversal<PostOrder>(tree);
+
+  // Итераторы не зависят от объекта дерева, только от отображения
+  auto it = tree.find(500);
+  MappedTree<int> moved = std::move(tree);
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(*++it, 501);
+  EXPECT_EQ(moved.size(), 1000u);
+}
+
+TEST(MappedTreeTest, IteratorsOfDifferentTreesDiffer) {
+  std::string path = WriteMappedFile("mapped_iterators.bin", {1, 2, 3});
+  MappedTree<int> first(path.c_str());
+  MappedTree<int> second(path.c_str());
+  std::remove(path.c_str());
+  // Один и тот же файл, но разные отображения: одинаковые индексы - разные позиции
+  EXPECT_NE(first.begin<InOrder>(), second.begin<InOrder>());
+  EXPECT_NE(first.find(2), second.find(2));
+  EXPECT_NE(first.begin<PreOrder>(), second.begin<PreOrder>());
+  EXPECT_EQ(first.find(2), first.lower_bound(2));
+  EXPECT_EQ(++first.begin<InOrder>(), first.find(2));
+}
+
+TEST(MappedTreeTest, EmptyAndInvalidFiles) {
+  std::string path = WriteMappedFile("mapped_empty.bin", {});
+  MappedTree<int> empty(path.c_str());
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.begin<PreOrder>(), empty.end<PreOrder>());
+  EXPECT_EQ(empty.begin<PostOrder>(), empty.end<PostOrder>());
+  EXPECT_FALSE(empty.contains(1));
+  EXPECT_THROW(MappedTree<double>(path.c_str()), FormatError);
+
+  path = WriteMappedFile("mapped_truncated.bin", {1, 2, 3});
+  std::ifstream in(path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+  std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 1));
+  EXPECT_THROW(MappedTree<int>(path.c_str()), FormatError);
+  std::ofstream(path, std::ios::binary | std::ios::trunc);
+  EXPECT_THROW(MappedTree<int>(path.c_str()), FormatError);
+  std::remove(path.c_str());
+  EXPECT_THROW(MappedTree<int>(path.c_str()), std::system_error);
+  std::remove((testing::TempDir() + "mapped_empty.bin").c_str());
+}
+
+TEST(DiskTreeTest, MatchesStdSetWithSmallBuffer) {
+  std::string path = testing::TempDir() + "disk_tree_ops.bin";
+  std::remove(path.c_str());
+  std::set<int> expected;
+  {
+    // 8 страниц по 4 КБ на десятки тысяч ключей: почти каждое обращение идет через вытеснение
+    DiskTree<int> tree(path.c_str(), 8);
+    std::mt19937 gen(24);
+    for (int i = 0; i < 60000; ++i) {
+      int value = static_cast<int>(gen() % 40000);
+      if (gen() % 3 == 0) {
+        EXPECT_EQ(tree.erase(value), expected.erase(value));
+      } else {
+        EXPECT_EQ(tree.insert(value), expected.insert(value).second);
+      }
+    }
+    EXPECT_EQ(tree.size(), expected.size());
+    EXPECT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+    std::vector<int> reversed;
+    for (auto it = tree.end(); it != tree.begin();) {
+      reversed.push_back(*--it);
+    }
+    EXPECT_TRUE(std::equal(reversed.begin(), reversed.end(), expected.rbegin(), expected.rend()));
+    for (int value = -1; value <= 40001; value += 7) {
+      auto lower = expected.lower_bound(value);
+      auto upper = expected.upper_bound(value);
+      EXPECT_EQ(tree.contains(value), expected.count(value) == 1);
+      EXPECT_EQ(tree.lower_bound(value) == tree.end(), lower == expected.end());
+      if (lower != expected.end()) {
+        EXPECT_EQ(*tree.lower_bound(value), *lower);
+      }
+      if (upper != expected.end()) {
+        EXPECT_EQ(*tree.upper_bound(value), *upper);
+      }
+    }
+    EXPECT_GT(tree.buffer_pool().reads(), 0u);
+    tree.flush();
+  }
+  // После повторного открытия содержимое то же
+  DiskTree<int> reopened(path.c_str(), 16);
+  EXPECT_EQ(reopened.size(), expected.size());
+  EXPECT_TRUE(std::equal(reopened.begin(), reopened.end(), expected.begin(), expected.end()));
+  std::remove(path.c_str());
+}
+
+TEST(DiskTreeTest, RangeScansAndPageReuse) {
+  std::string path = testing::TempDir() + "disk_tree_reuse.bin";
+  std::remove(path.c_str());
+  DiskTree<long long> tree(path.c_str(), 32);
+  EXPECT_EQ(tree.begin(), tree.end());
+  EXPECT_EQ(--tree.end(), tree.end());
+  for (long long i = 0; i < 20000; ++i) {
+    EXPECT_TRUE(tree.insert(i * 2));
+  }
+  EXPECT_FALSE(tree.insert(100));
+  auto [first, last] = tree.equal_range(100);
+  EXPECT_EQ(*first, 100);
+  EXPECT_EQ(*last, 102);
+  long long sum = 0;
+  for (auto it = tree.lower_bound(1001); it != tree.upper_bound(2000); ++it) {
+    sum += *it;
+  }
+  EXPECT_EQ(sum, 250 * (1002 + 2000));
+
+  tree.flush();
+  std::uint64_t pages = tree.buffer_pool().page_count();
+  for (long long i = 0; i < 20000; ++i) {
+    EXPECT_EQ(tree.erase(i * 2), 1u);
+  }
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.begin(), tree.end());
+  // Освобожденные страницы переиспользуются, файл не растет
+  for (long long i = 20000; i > 0; --i) {
+    EXPECT_TRUE(tree.insert(i));
+  }
+  EXPECT_LE(tree.buffer_pool().page_count(), pages + 1);
+  EXPECT_EQ(*tree.begin(), 1);
+  EXPECT_EQ(*--tree.end(), 20000);
+  std::remove(path.c_str());
+}
+
+TEST(DiskTreeTest, RejectsForeignFiles) {
+  std::string path = testing::TempDir() + "disk_tree_foreign.bin";
+  std::remove(path.c_str());
+  {
+    DiskTree<int> tree(path.c_str(), 8);
+    tree.insert(1);
+  }
+  EXPECT_THROW(DiskTree<double>(path.c_str(), 8), FormatError);
+  EXPECT_THROW(DiskTree<int>(path.c_str(), 2), std::invalid_argument);
+  EXPECT_EQ(DiskTree<int>(path.c_str(), 8).size(), 1u);
+  std::remove(path.c_str());
+
+  // Чужой файл короче страницы не принимается за пустой и остается нетронутым
+  std::string text = "not a tree, just 33 bytes of text";
+  std::ofstream(path, std::ios::binary).write(text.data(), static_cast<std::streamsize>(text.size()));
+  EXPECT_THROW(DiskTree<int>(path.c_str(), 8), FormatError);
+  std::ifstream in(path, std::ios::binary);
+  EXPECT_EQ(std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()), text);
+  std::remove(path.c_str());
+}
+
+std::string ReadFileBytes(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void WriteFileBytes(const std::string& path, const std::string& bytes) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+void RemoveLoggedTreeFiles(const std::string& path) {
+  std::remove((path + ".snapshot").c_str());
+  std::remove((path + ".log").c_str());
+}
+
+TEST(LoggedTreeTest, RecoversFromLogAndCheckpoints) {
+  std::string path = testing::TempDir() + "logged_tree";
+  RemoveLoggedTreeFiles(path);
+  std::set<int> expected;
+  std::mt19937 gen(25);
+  auto mutate = [&](LoggedTree<RedBlackTree>& tree, int operations) {
+    for (int i = 0; i < operations; ++i) {
+      int value = static_cast<int>(gen() % 3000);
+      if (gen() % 3 == 0) {
+        EXPECT_EQ(tree.erase(value), expected.erase(value));
+      } else {
+        EXPECT_EQ(tree.insert(value), expected.insert(value).second);
+      }
+    }
+  };
+  {
+    LoggedTree<RedBlackTree> tree(path);
+    EXPECT_TRUE(tree.empty());
+    mutate(tree, 5000); // Только журнал, снимка еще нет
+  }
+  {
+    LoggedTree<RedBlackTree> tree(path);
+    EXPECT_TRUE(std::equal(tree.tree().begin<InOrder>(), tree.tree().end<InOrder>(), expected.begin(), expected.end()));
+    tree.checkpoint();
+    std::size_t log_size = ReadFileBytes(path + ".log").size();
+    EXPECT_EQ(log_size, BinaryFormat::kHeaderBytes);
+    mutate(tree, 3000); // Снимок и хвост журнала
+  }
+  LoggedTree<RedBlackTree> tree(path, 1);
+  EXPECT_EQ(tree.size(), expected.size());
+  EXPECT_TRUE(std::equal(tree.tree().begin<InOrder>(), tree.tree().end<InOrder>(), expected.begin(), expected.end()));
+  RemoveLoggedTreeFiles(path);
+}
+
+TEST(LoggedTreeTest, UncommittedAndTornRecordsAreDropped) {
+  std::string path = testing::TempDir() + "logged_torn";
+  std::string crashed = testing::TempDir() + "logged_torn_crash";
+  RemoveLoggedTreeFiles(path);
+  RemoveLoggedTreeFiles(crashed);
+  using StringTree = BinarySearchTree<std::string, std::less<std::string>, std::allocator<std::string>, AvlBalance>;
+  {
+    LoggedTree<StringTree> tree(path, 1000);
+    for (int i = 0; i < 100; ++i) {
+      tree.insert("key" + std::to_string(i));
+    }
+    tree.erase("key7");
+    tree.commit();
+    EXPECT_EQ(tree.pending(), 0u);
+    tree.insert("lost");
+    EXPECT_EQ(tree.pending(), 1u);
+    // Сбой до commit: на диске только то, что было записано к этому моменту
+    WriteFileBytes(crashed + ".log", ReadFileBytes(path + ".log") + "\x01\x05\x00");
+  }
+  {
+    LoggedTree<StringTree> recovered(crashed);
+    EXPECT_EQ(recovered.size(), 99u);
+    EXPECT_FALSE(recovered.contains("key7"));
+    EXPECT_FALSE(recovered.contains("lost"));
+    // Оборванный хвост отрезан, новые записи читаются после него
+    recovered.insert("after");
+  }
+  LoggedTree<StringTree> reopened(crashed);
+  EXPECT_EQ(reopened.size(), 100u);
+  EXPECT_TRUE(reopened.contains("after"));
+  RemoveLoggedTreeFiles(path);
+  RemoveLoggedTreeFiles(crashed);
+}
+
+// Ограничение размера файла обрывает запись группы посередине: write записывает часть
+// байтов, а следующий вызов завершается с EFBIG
+TEST(LoggedTreeTest, FailedGroupWriteIsCutBeforeRetry) {
+  std::string path = testing::TempDir() + "logged_partial";
+  RemoveLoggedTreeFiles(path);
+  auto previous_handler = std::signal(SIGXFSZ, SIG_IGN);
+  rlimit original;
+  ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &original), 0);
+  {
+    LoggedTree<RedBlackTree> tree(path, 1000);
+    for (int i = 0; i < 100; ++i) {
+      tree.insert(i);
+    }
+    tree.commit();
+    std::size_t committed = ReadFileBytes(path + ".log").size();
+    for (int i = 100; i < 200; ++i) {
+      tree.insert(i);
+    }
+    rlimit limited = original;
+    limited.rlim_cur = committed + 50;
+    ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limited), 0);
+    EXPECT_THROW(tree.commit(), std::system_error);
+    ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &original), 0);
+    EXPECT_EQ(tree.pending(), 100u);
+    EXPECT_EQ(ReadFileBytes(path + ".log").size(), committed); // Оборванная группа отрезана
+    tree.commit();
+    tree.erase(0);
+  }
+  std::signal(SIGXFSZ, previous_handler);
+  LoggedTree<RedBlackTree> recovered(path);
+  EXPECT_EQ(recovered.size(), 199u);
+  EXPECT_FALSE(recovered.contains(0));
+  EXPECT_TRUE(recovered.contains(199));
+  RemoveLoggedTreeFiles(path);
+}
+
+TEST(LoggedTreeTest, StaleLogAfterCheckpointIsIgnored) {
+  std::string path = testing::TempDir() + "logged_stale";
+  RemoveLoggedTreeFiles(path);
+  std::string old_log;
+  {
+    LoggedTree<RedBlackTree> tree(path);
+    tree.insert(1);
+    tree.insert(2);
+    tree.commit();
+    old_log = ReadFileBytes(path + ".log");
+    tree.erase(1);
+    tree.checkpoint();
+  }
+  // Сбой между заменой снимка и очисткой журнала: журнал прежнего поколения уже в снимке
+  WriteFileBytes(path + ".log", old_log);
+  LoggedTree<RedBlackTree> tree(path);
+  EXPECT_EQ(std::vector<int>(tree.tree().begin<InOrder>(), tree.tree().end<InOrder>()), std::vector<int>({2}));
+  RemoveLoggedTreeFiles(path);
+}
+
+// Значения журнала и снимка восстанавливаются без конструктора по умолчанию
+TEST(LoggedTreeTest, RawTypeWithoutDefaultConstructor) {
+  using PointTree = BinarySearchTree<RawPoint>;
+  std::string path = testing::TempDir() + "logged_points";
+  RemoveLoggedTreeFiles(path);
+  {
+    LoggedTree<PointTree> tree(path);
+    for (std::int32_t i = 0; i < 100; ++i) {
+      tree.insert(RawPoint(i % 10, i));
+    }
+    tree.checkpoint();
+    tree.erase(RawPoint(0, 0));
+    tree.insert(RawPoint(-1, 7));
+  }
+  LoggedTree<PointTree> tree(path);
+  ASSERT_EQ(tree.size(), 100u);
+  EXPECT_EQ(tree.tree().begin<InOrder>()->x, -1);
+  EXPECT_FALSE(tree.tree().contains(RawPoint(0, 0)));
+  EXPECT_TRUE(tree.tree().contains(RawPoint(9, 99)));
+  RemoveLoggedTreeFiles(path);
+}
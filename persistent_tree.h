@@ -0,0 +1,795 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "bst.h"
+
+// Персистентное множество: узлы после создания не изменяются, insert и erase копируют только
+// путь от корня до места изменения (AVL-балансировка), а нетронутые поддеревья разделяются
+// между версиями через счетчики ссылок. Поэтому копия дерева и snapshot() стоят O(1), а
+// изменение копии не затрагивает оригинал.
+// Счетчики атомарные: версии, разделяющие узлы, можно читать, менять и разрушать в разных
+// потоках. Один и тот же объект PersistentTree, как и любой контейнер, требует синхронизации.
+template<typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class PersistentTree {
+ public:
+  using value_type = T;
+  using allocator_type = Alloc;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using pointer = typename std::allocator_traits<allocator_type>::pointer;
+  using const_pointer = typename std::allocator_traits<allocator_type>::const_pointer;
+  using key_type = T;
+  using key_compare = Compare;
+  using value_compare = Compare;
+
+ private:
+  struct Node {
+    value_type value;
+    const Node* left;
+    const Node* right;
+    int height;
+    size_type size;
+    mutable std::atomic<size_type> refs{1};
+
+    template<typename V>
+    Node(V&& value, const Node* left, const Node* right)
+        : value(std::forward<V>(value)), left(left), right(right),
+          height(1 + std::max(height_of(left), height_of(right))),
+          size(1 + size_of(left) + size_of(right)) {}
+
+    static int height_of(const Node* node) noexcept {
+      return node != nullptr ? node->height : 0;
+    }
+
+    static size_type size_of(const Node* node) noexcept {
+      return node != nullptr ? node->size : 0;
+    }
+  };
+
+  using NodeAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+  using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+  // Высота AVL-дерева не больше 1.44 * log2(n + 2), для 64-битного size_type - меньше 96
+  static constexpr size_type kMaxHeight = 96;
+
+  NodeAllocator node_allocator_;
+  Compare comp_;
+  const Node* root_ = nullptr;
+
+ public:
+  // Узлы разделяются между версиями и не знают родителей, поэтому итератор хранит путь
+  // от корня. Итератор действителен, пока жива хотя бы одна версия, содержащая его узлы.
+  template<typename Order>
+  class const_iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = const T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator() = default;
+
+    const_iterator& operator++() {
+      increment(Order());
+      return *this;
+    }
+
+    const_iterator& operator--() {
+      decrement(Order());
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator result = *this;
+      --*this;
+      return result;
+    }
+
+    reference operator*() const {
+      return top()->value;
+    }
+
+    pointer operator->() const {
+      return &top()->value;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return current() == other.current();
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return current() != other.current();
+    }
+
+   private:
+    friend class PersistentTree;
+
+    explicit const_iterator(const Node* root) : root_(root) {}
+
+    const Node* current() const noexcept {
+      return depth_ != 0 ? path_[depth_ - 1] : nullptr;
+    }
+
+    const Node* top() const noexcept {
+      return path_[depth_ - 1];
+    }
+
+    void push(const Node* node) noexcept {
+      path_[depth_++] = node;
+    }
+
+    const Node* pop() noexcept {
+      return path_[--depth_];
+    }
+
+    void pushLeftmost(const Node* node) noexcept {
+      for (; node != nullptr; node = node->left) {
+        push(node);
+      }
+    }
+
+    void pushRightmost(const Node* node) noexcept {
+      for (; node != nullptr; node = node->right) {
+        push(node);
+      }
+    }
+
+    // Спуск к первому узлу поддерева в PostOrder: влево, если можно, иначе вправо
+    void pushFirstPostOrder(const Node* node) noexcept {
+      while (node != nullptr) {
+        push(node);
+        node = node->left != nullptr ? node->left : node->right;
+      }
+    }
+
+    // Спуск к последнему узлу поддерева в PreOrder: вправо, если можно, иначе влево
+    void pushLastPreOrder(const Node* node) noexcept {
+      while (node != nullptr) {
+        push(node);
+        node = node->right != nullptr ? node->right : node->left;
+      }
+    }
+
+    void increment(InOrder) {
+      if (depth_ == 0) {
+        return;
+      }
+      if (top()->right != nullptr) {
+        pushLeftmost(top()->right);
+        return;
+      }
+      // Поднимаемся, пока приходим из правого поддерева
+      const Node* child = pop();
+      while (depth_ != 0 && top()->right == child) {
+        child = pop();
+      }
+    }
+
+    void decrement(InOrder) {
+      if (depth_ == 0) {
+        pushRightmost(root_); // От конца - к максимуму
+        return;
+      }
+      if (top()->left != nullptr) {
+        pushRightmost(top()->left);
+        return;
+      }
+      const Node* child = pop();
+      while (depth_ != 0 && top()->left == child) {
+        child = pop();
+      }
+    }
+
+    void increment(PreOrder) {
+      if (depth_ == 0) {
+        return;
+      }
+      if (top()->left != nullptr) {
+        push(top()->left);
+      } else if (top()->right != nullptr) {
+        push(top()->right);
+      } else {
+        // Ищем ближайшего предка, в левом поддереве которого мы были и у которого есть правое
+        while (true) {
+          const Node* child = pop();
+          if (depth_ == 0) {
+            return;
+          }
+          if (top()->left == child && top()->right != nullptr) {
+            push(top()->right);
+            return;
+          }
+        }
+      }
+    }
+
+    void decrement(PreOrder) {
+      if (depth_ == 0) {
+        pushLastPreOrder(root_);
+        return;
+      }
+      const Node* child = pop();
+      if (depth_ != 0 && top()->right == child && top()->left != nullptr) {
+        pushLastPreOrder(top()->left); // Перед правым поддеревом заканчивается левое
+      }
+      // Иначе предыдущим является родитель, он уже на вершине пути
+    }
+
+    void increment(PostOrder) {
+      if (depth_ == 0) {
+        return;
+      }
+      const Node* child = pop();
+      if (depth_ != 0 && top()->left == child && top()->right != nullptr) {
+        pushFirstPostOrder(top()->right);
+      }
+      // Иначе следующим является родитель
+    }
+
+    void decrement(PostOrder) {
+      if (depth_ == 0) {
+        if (root_ != nullptr) {
+          push(root_); // В PostOrder последним идет корень
+        }
+        return;
+      }
+      if (top()->right != nullptr) {
+        push(top()->right);
+      } else if (top()->left != nullptr) {
+        push(top()->left);
+      } else {
+        while (true) {
+          const Node* child = pop();
+          if (depth_ == 0) {
+            return;
+          }
+          if (top()->right == child && top()->left != nullptr) {
+            push(top()->left);
+            return;
+          }
+        }
+      }
+    }
+
+    const Node* root_ = nullptr;
+    const Node* path_[kMaxHeight];
+    size_type depth_ = 0;
+  };
+
+  // Конструкторы и деструктор
+  PersistentTree() = default;
+
+  explicit PersistentTree(const allocator_type& alloc) : node_allocator_(alloc) {}
+
+  explicit PersistentTree(const Compare& comp, const allocator_type& alloc = allocator_type())
+      : node_allocator_(alloc), comp_(comp) {}
+
+  // Копия разделяет все узлы с оригиналом, O(1). Аллокатор копируется как есть:
+  // освобождать разделяемые узлы может любая из версий.
+  PersistentTree(const PersistentTree& other)
+      : node_allocator_(other.node_allocator_), comp_(other.comp_), root_(retain(other.root_)) {}
+
+  PersistentTree(PersistentTree&& other) noexcept
+      : node_allocator_(std::move(other.node_allocator_)), comp_(other.comp_), root_(other.root_) {
+    other.root_ = nullptr;
+  }
+
+  PersistentTree& operator=(PersistentTree other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~PersistentTree() {
+    release(root_);
+  }
+
+  void swap(PersistentTree& other) noexcept {
+    using std::swap;
+    swap(node_allocator_, other.node_allocator_);
+    swap(comp_, other.comp_);
+    swap(root_, other.root_);
+  }
+
+  // Неизменяемая точка во времени; последующие изменения этого дерева ее не затрагивают
+  PersistentTree snapshot() const {
+    return *this;
+  }
+
+  void clear() noexcept {
+    release(root_);
+    root_ = nullptr;
+  }
+
+  // Вставка и удаление копируют путь длиной O(log n)
+  std::pair<const_iterator<InOrder>, bool> insert(const value_type& value) {
+    return insertValue(value);
+  }
+
+  std::pair<const_iterator<InOrder>, bool> insert(value_type&& value) {
+    return insertValue(std::move(value));
+  }
+
+  template<typename... Args>
+  std::pair<const_iterator<InOrder>, bool> emplace(Args&&... args) {
+    return insertValue(value_type(std::forward<Args>(args)...));
+  }
+
+  size_type erase(const value_type& value) {
+    return eraseKey(value);
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  size_type erase(const K& key) {
+    return eraseKey(key);
+  }
+
+  // Поиск
+  const_iterator<InOrder> find(const value_type& value) const {
+    return findPosition(value);
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> find(const K& key) const {
+    return findPosition(key);
+  }
+
+  bool contains(const value_type& value) const {
+    return findNode(value) != nullptr;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  bool contains(const K& key) const {
+    return findNode(key) != nullptr;
+  }
+
+  size_type count(const value_type& value) const {
+    return contains(value) ? 1 : 0;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  size_type count(const K& key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  const_iterator<InOrder> lower_bound(const value_type& value) const {
+    return lowerBoundPosition(value);
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> lower_bound(const K& key) const {
+    return lowerBoundPosition(key);
+  }
+
+  const_iterator<InOrder> upper_bound(const value_type& value) const {
+    return upperBoundPosition(value);
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator<InOrder> upper_bound(const K& key) const {
+    return upperBoundPosition(key);
+  }
+
+  std::pair<const_iterator<InOrder>, const_iterator<InOrder>> equal_range(const value_type& value) const {
+
+    return std::make_pair(lower_bound(value), upper_bound(value));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  std::pair<const_iterator<InOrder>, const_iterator<InOrder>> equal_range(const K& key) const {
+
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  // Методы контейнера
+  template<typename Order>
+  const_iterator<Order> begin() const {
+    const_iterator<Order> it(root_);
+    if constexpr (std::is_same_v<Order, InOrder>) {
+      it.pushLeftmost(root_);
+    } else if constexpr (std::is_same_v<Order, PreOrder>) {
+      if (root_ != nullptr) {
+        it.push(root_);
+      }
+    } else if constexpr (std::is_same_v<Order, PostOrder>) {
+      it.pushFirstPostOrder(root_);
+    }
+
+    return it;
+  }
+
+  template<typename Order>
+  const_iterator<Order> end() const {
+
+    return const_iterator<Order>(root_);
+  }
+
+  template<typename Order>
+  const_iterator<Order> cbegin() const {
+
+    return begin<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> cend() const {
+
+    return end<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> rbegin() const {
+    const_iterator<Order> it = end<Order>();
+    --it;
+
+    return it;
+  }
+
+  template<typename Order>
+  const_iterator<Order> rend() const {
+
+    return const_iterator<Order>(root_);
+  }
+
+  template<typename Order>
+  const_iterator<Order> crbegin() const {
+
+    return rbegin<Order>();
+  }
+
+  template<typename Order>
+  const_iterator<Order> crend() const {
+
+    return rend<Order>();
+  }
+
+  bool empty() const noexcept {
+    return root_ == nullptr;
+  }
+
+  size_type size() const noexcept {
+    return Node::size_of(root_);
+  }
+
+  // Количество элементов, строго меньших value
+  size_type rank(const value_type& value) const {
+    size_type result = 0;
+    const Node* node = root_;
+    while (node != nullptr) {
+      if (comp_(node->value, value)) {
+        result += Node::size_of(node->left) + 1;
+        node = node->right;
+      } else {
+        node = node->left;
+      }
+    }
+
+    return result;
+  }
+
+  // k-й по возрастанию элемент (с нуля) или end, если k >= size()
+  const_iterator<InOrder> select(size_type k) const {
+    const_iterator<InOrder> it(root_);
+    const Node* node = root_;
+    while (node != nullptr) {
+      it.push(node);
+      size_type left_size = Node::size_of(node->left);
+      if (k < left_size) {
+        node = node->left;
+      } else if (k == left_size) {
+        return it;
+      } else {
+        k -= left_size + 1;
+        node = node->right;
+      }
+    }
+
+    return end<InOrder>();
+  }
+
+  size_type max_size() const noexcept {
+
+    return NodeTraits::max_size(node_allocator_);
+  }
+
+  key_compare key_comp() const {
+
+    return comp_;
+  }
+
+  value_compare value_comp() const {
+
+    return comp_;
+  }
+
+  allocator_type get_allocator() const noexcept {
+
+    return node_allocator_;
+  }
+
+ private:
+  static const Node* retain(const Node* node) noexcept {
+    if (node != nullptr) {
+      node->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return node;
+  }
+
+  // Освобождает ссылку; узлы, на которые больше никто не ссылается, удаляются вместе
+  // с поддеревьями. Рекурсия идет только влево, ее глубина ограничена высотой дерева.
+  void release(const Node* node) noexcept {
+    while (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      const Node* left = node->left;
+      const Node* right = node->right;
+      Node* mutable_node = const_cast<Node*>(node);
+      NodeTraits::destroy(node_allocator_, mutable_node);
+      NodeTraits::deallocate(node_allocator_, mutable_node, 1);
+      release(left);
+      node = right;
+    }
+  }
+
+  // Новый узел забирает по одной ссылке на left и right, в том числе при исключении
+  template<typename V>
+  const Node* makeNode(V&& value, const Node* left, const Node* right) {
+    Node* node;
+    try {
+      node = NodeTraits::allocate(node_allocator_, 1);
+    } catch (...) {
+      release(left);
+      release(right);
+      throw;
+    }
+    try {
+      NodeTraits::construct(node_allocator_, node, std::forward<V>(value), left, right);
+    } catch (...) {
+      NodeTraits::deallocate(node_allocator_, node, 1);
+      release(left);
+      release(right);
+      throw;
+    }
+    return node;
+  }
+
+  // Копия узла с новыми потомками и восстановлением AVL-баланса; забирает ссылки на left и right.
+  // Узел, разбираемый при повороте, сначала отдает ссылку на right, чтобы при исключении
+  // оставалось освободить только его самого.
+  const Node* balance(const value_type& value, const Node* left, const Node* right) {
+    int diff = Node::height_of(left) - Node::height_of(right);
+    if (diff > 1) {
+      const Node* l = left;
+      try {
+        if (Node::height_of(l->left) >= Node::height_of(l->right)) {
+          const Node* new_right = makeNode(value, retain(l->right), right);
+          const Node* result = makeNode(l->value, retain(l->left), new_right);
+          release(l);
+          return result;
+        }
+        const Node* pivot = l->right;
+        const Node* new_right = makeNode(value, retain(pivot->right), right);
+        const Node* new_left;
+        try {
+          new_left = makeNode(l->value, retain(l->left), retain(pivot->left));
+        } catch (...) {
+          release(new_right);
+          throw;
+        }
+        const Node* result = makeNode(pivot->value, new_left, new_right);
+        release(l);
+        return result;
+      } catch (...) {
+        release(l);
+        throw;
+      }
+    }
+    if (diff < -1) {
+      const Node* r = right;
+      try {
+        if (Node::height_of(r->right) >= Node::height_of(r->left)) {
+          const Node* new_left = makeNode(value, left, retain(r->left));
+          const Node* result = makeNode(r->value, new_left, retain(r->right));
+          release(r);
+          return result;
+        }
+        const Node* pivot = r->left;
+        const Node* new_left = makeNode(value, left, retain(pivot->left));
+        const Node* new_right;
+        try {
+          new_right = makeNode(r->value, retain(pivot->right), retain(r->right));
+        } catch (...) {
+          release(new_left);
+          throw;
+        }
+        const Node* result = makeNode(pivot->value, new_left, new_right);
+        release(r);
+        return result;
+      } catch (...) {
+        release(r);
+        throw;
+      }
+    }
+    return makeNode(value, left, right);
+  }
+
+  // Возвращает собственную ссылку на корень новой версии поддерева
+  template<typename V>
+  const Node* insertRecursive(const Node* node, V& value, bool& inserted) {
+    if (node == nullptr) {
+      inserted = true;
+      return makeNode(std::forward<V>(value), nullptr, nullptr);
+    }
+    if (comp_(value, node->value)) {
+      const Node* left = insertRecursive(node->left, value, inserted);
+      if (!inserted) {
+        release(left);
+        return retain(node);
+      }
+      return balance(node->value, left, retain(node->right));
+    }
+    if (comp_(node->value, value)) {
+      const Node* right = insertRecursive(node->right, value, inserted);
+      if (!inserted) {
+        release(right);
+        return retain(node);
+      }
+      return balance(node->value, retain(node->left), right);
+    }
+    return retain(node); // Повторы не допускаются
+  }
+
+  template<typename V>
+  std::pair<const_iterator<InOrder>, bool> insertValue(V&& value) {
+    // Значение может быть перемещено в узел, а повороты копируют узлы пути, поэтому
+    // позиция вставленного элемента запоминается как его порядковый номер
+    size_type position = rank(value);
+    bool inserted = false;
+    const Node* new_root = insertRecursive(root_, value, inserted);
+    if (!inserted) {
+      release(new_root);
+      return std::make_pair(select(position), false);
+    }
+    release(root_);
+    root_ = new_root;
+    return std::make_pair(select(position), true);
+  }
+
+  template<typename K>
+  size_type eraseKey(const K& key) {
+    bool erased = false;
+    const Node* new_root = eraseRecursive(root_, key, erased);
+    if (!erased) {
+      release(new_root);
+      return 0;
+    }
+    release(root_);
+    root_ = new_root;
+    return 1;
+  }
+
+  template<typename K>
+  const Node* eraseRecursive(const Node* node, const K& key, bool& erased) {
+    if (node == nullptr) {
+      return nullptr;
+    }
+    if (comp_(key, node->value)) {
+      const Node* left = eraseRecursive(node->left, key, erased);
+      if (!erased) {
+        release(left);
+        return retain(node);
+      }
+      return balance(node->value, left, retain(node->right));
+    }
+    if (comp_(node->value, key)) {
+      const Node* right = eraseRecursive(node->right, key, erased);
+      if (!erased) {
+        release(right);
+        return retain(node);
+      }
+      return balance(node->value, retain(node->left), right);
+    }
+    erased = true;
+    if (node->left == nullptr) {
+      return retain(node->right);
+    }
+    if (node->right == nullptr) {
+      return retain(node->left);
+    }
+    // Место узла занимает копия минимума правого поддерева
+    const Node* min = nullptr;
+    const Node* right = eraseMin(node->right, min);
+    return balance(min->value, retain(node->left), right);
+  }
+
+  const Node* eraseMin(const Node* node, const Node*& min) {
+    if (node->left == nullptr) {
+      min = node;
+      return retain(node->right);
+    }
+    const Node* left = eraseMin(node->left, min);
+    return balance(node->value, left, retain(node->right));
+  }
+
+  template<typename K>
+  const Node* findNode(const K& key) const {
+    const Node* node = root_;
+    while (node != nullptr) {
+      if (comp_(key, node->value)) {
+        node = node->left;
+      } else if (comp_(node->value, key)) {
+        node = node->right;
+      } else {
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+  template<typename K>
+  const_iterator<InOrder> findPosition(const K& key) const {
+    const_iterator<InOrder> it(root_);
+    const Node* node = root_;
+    while (node != nullptr) {
+      it.push(node);
+      if (comp_(key, node->value)) {
+        node = node->left;
+      } else if (comp_(node->value, key)) {
+        node = node->right;
+      } else {
+        return it;
+      }
+    }
+    return end<InOrder>();
+  }
+
+  // Путь к lower bound: после спуска снимаем узлы, пока вершина меньше ключа
+  template<typename K>
+  const_iterator<InOrder> lowerBoundPosition(const K& key) const {
+    const_iterator<InOrder> it(root_);
+    const Node* node = root_;
+    size_type result_depth = 0;
+    while (node != nullptr) {
+      it.push(node);
+      if (comp_(node->value, key)) {
+        node = node->right;
+      } else {
+        result_depth = it.depth_; // Кандидат; ищем меньший слева
+        node = node->left;
+      }
+    }
+    it.depth_ = result_depth;
+    return it;
+  }
+
+  template<typename K>
+  const_iterator<InOrder> upperBoundPosition(const K& key) const {
+    const_iterator<InOrder> it(root_);
+    const Node* node = root_;
+    size_type result_depth = 0;
+    while (node != nullptr) {
+      it.push(node);
+      if (comp_(key, node->value)) {
+        result_depth = it.depth_;
+        node = node->left;
+      } else {
+        node = node->right;
+      }
+    }
+    it.depth_ = result_depth;
+    return it;
+  }
+};
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// Пул блоков одинакового размера. Память берется крупными слябами, освобожденные
+// блоки возвращаются во встроенный (intrusive) список свободных блоков.
+// Размер блока фиксируется при первом выделении одиночного объекта.
+// Пул не потокобезопасен, как и само дерево.
+class NodePool {
+ public:
+  explicit NodePool(std::size_t blocks_per_slab) noexcept
+      : blocks_per_slab_(blocks_per_slab == 0 ? 1 : blocks_per_slab) {}
+
+  NodePool(const NodePool&) = delete;
+  NodePool& operator=(const NodePool&) = delete;
+
+  ~NodePool() {
+    release();
+  }
+
+  // Подходит ли объект такого размера и выравнивания для блоков пула
+  bool fits(std::size_t size, std::size_t alignment) noexcept {
+    if (block_size_ == 0) {
+      // Первое выделение определяет размер блока; в блоке должен помещаться указатель списка
+      block_align_ = std::max(alignment, alignof(FreeBlock));
+      block_size_ = std::max(size, sizeof(FreeBlock));
+      block_size_ = (block_size_ + block_align_ - 1) / block_align_ * block_align_;
+    }
+    return size <= block_size_ && alignment <= block_align_;
+  }
+
+  void* allocate() {
+    if (free_list_ != nullptr) {
+      FreeBlock* block = free_list_;
+      free_list_ = block->next;
+      return block;
+    }
+    if (cursor_ == end_) {
+      add_slab(blocks_per_slab_);
+    }
+    void* block = cursor_;
+    cursor_ += block_size_;
+    return block;
+  }
+
+  void deallocate(void* block) noexcept {
+    FreeBlock* free_block = static_cast<FreeBlock*>(block);
+    free_block->next = free_list_;
+    free_list_ = free_block;
+  }
+
+  // Гарантирует, что следующие count выделений пройдут без обращения к системному аллокатору.
+  // Если свободных блоков не хватает, новые блоки берутся из одного сляба подряд.
+  void reserve(std::size_t count) {
+    std::size_t available = static_cast<std::size_t>(end_ - cursor_) / block_size_;
+    for (FreeBlock* block = free_list_; block != nullptr && available < count; block = block->next) {
+      ++available;
+    }
+    if (available < count) {
+      recycle_tail();
+      add_slab(std::max(count, blocks_per_slab_));
+    }
+  }
+
+  // Возвращает всю память системе за O(количества слябов). Все выделенные блоки
+  // становятся недействительными.
+  void release() noexcept {
+    while (slabs_ != nullptr) {
+      Slab* next = slabs_->next;
+      ::operator delete(slabs_, std::align_val_t(slab_align()));
+      slabs_ = next;
+    }
+    free_list_ = nullptr;
+    cursor_ = end_ = nullptr;
+    slab_count_ = 0;
+  }
+
+  std::size_t slab_count() const noexcept {
+    return slab_count_;
+  }
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct Slab {
+    Slab* next;
+  };
+
+  std::size_t slab_align() const noexcept {
+    return std::max(block_align_, alignof(Slab));
+  }
+
+  // Остаток текущего сляба переносится в список свободных блоков, чтобы не потерять его
+  void recycle_tail() noexcept {
+    while (cursor_ != end_) {
+      deallocate(cursor_);
+      cursor_ += block_size_;
+    }
+  }
+
+  void add_slab(std::size_t blocks) {
+    std::size_t header = (sizeof(Slab) + block_align_ - 1) / block_align_ * block_align_;
+    char* memory = static_cast<char*>(::operator new(header + blocks * block_size_, std::align_val_t(slab_align())));
+    Slab* slab = reinterpret_cast<Slab*>(memory);
+    slab->next = slabs_;
+    slabs_ = slab;
+    ++slab_count_;
+    cursor_ = memory + header;
+    end_ = cursor_ + blocks * block_size_;
+  }
+
+  std::size_t blocks_per_slab_;
+  std::size_t block_size_ = 0;
+  std::size_t block_align_ = 0;
+  FreeBlock* free_list_ = nullptr;
+  Slab* slabs_ = nullptr;
+  std::size_t slab_count_ = 0;
+  char* cursor_ = nullptr; // Начало неразмеченной части текущего сляба
+  char* end_ = nullptr;
+};
+
+// Аллокатор для узлов BinarySearchTree: одиночные объекты берутся из общего пула,
+// массивы и объекты, не помещающиеся в блок пула, выделяются через std::allocator.
+// Копии аллокатора (в том числе после rebind) разделяют один пул.
+template<typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  template<typename U>
+  struct rebind {
+    using other = PoolAllocator<U>;
+  };
+
+  static constexpr std::size_t default_blocks_per_slab = 4096;
+
+  PoolAllocator() : PoolAllocator(default_blocks_per_slab) {}
+
+  explicit PoolAllocator(std::size_t blocks_per_slab) : pool_(std::make_shared<NodePool>(blocks_per_slab)) {}
+
+  // Перемещение копирует указатель на пул: аллокатор не должен оставаться без пула
+  PoolAllocator(const PoolAllocator&) noexcept = default;
+
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U>& other) noexcept : pool_(other.pool_) {}
+
+  T* allocate(size_type n) {
+    if (n == 1 && pool_->fits(sizeof(T), alignof(T))) {
+      return static_cast<T*>(pool_->allocate());
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, size_type n) noexcept {
+    if (n == 1 && pool_->fits(sizeof(T), alignof(T))) {
+      pool_->deallocate(p);
+    } else {
+      std::allocator<T>().deallocate(p, n);
+    }
+  }
+
+  // Подготавливает непрерывный участок под count одиночных выделений
+  void reserve(size_type count) {
+    if (pool_->fits(sizeof(T), alignof(T))) {
+      pool_->reserve(count);
+    }
+  }
+
+  // Освобождает весь пул разом, если им не пользуется никакая другая копия аллокатора.
+  // Деструкторы объектов не вызываются. Возвращает false, если пул разделяется.
+  bool release() noexcept {
+    if (pool_.use_count() != 1) {
+      return false;
+    }
+    pool_->release();
+    return true;
+  }
+
+  std::size_t slab_count() const noexcept {
+    return pool_->slab_count();
+  }
+
+  template<typename U>
+  bool operator==(const PoolAllocator<U>& other) const noexcept {
+    return pool_ == other.pool_;
+  }
+
+  template<typename U>
+  bool operator!=(const PoolAllocator<U>& other) const noexcept {
+    return pool_ != other.pool_;
+  }
+
+ private:
+  template<typename U>
+  friend class PoolAllocator;
+
+  std::shared_ptr<NodePool> pool_;
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Пул потоков для параллелизма вида fork-join с перехватом работы.
+// У каждого рабочего потока своя очередь задач: владелец берет с конца последнюю добавленную
+// (она ближе всего к его данным), а простаивающие потоки забирают с начала самые старые,
+// обычно самые крупные, задачи. Ожидающий завершения задачи поток не блокируется, а выполняет
+// чужие задачи, поэтому вложенные invoke не приводят к взаимной блокировке.
+class ThreadPool {
+  struct Task {
+    void (*run)(Task*);
+    Task* prev = nullptr;
+    Task* next = nullptr;
+    std::atomic<bool> done{false};
+  };
+
+  // Очередь задач потока: интрусивный двусвязный список под мьютексом
+  struct Worker {
+    std::mutex mutex;
+    Task* head = nullptr; // Самая старая задача, отсюда крадут
+    Task* tail = nullptr; // Самая новая задача, отсюда берет владелец
+    std::thread thread;
+  };
+
+ public:
+  explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency())
+      : workers_(threads != 0 ? new Worker[threads] : nullptr), worker_count_(threads) {
+    for (std::size_t i = 0; i < worker_count_; ++i) {
+      workers_[i].thread = std::thread(&ThreadPool::workerLoop, this, i);
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::size_t i = 0; i < worker_count_; ++i) {
+      workers_[i].thread.join();
+    }
+  }
+
+  std::size_t size() const noexcept {
+    return worker_count_;
+  }
+
+  // Выполняет left и right, возможно параллельно, и возвращается после завершения обеих.
+  // right ставится в очередь и может быть перехвачен другим потоком, left выполняется сразу.
+  // Исключение из любой из функций пробрасывается после завершения обеих.
+  template<typename Left, typename Right>
+  void invoke(Left&& left, Right&& right) {
+    if (worker_count_ == 0) {
+      left();
+      right();
+      return;
+    }
+    FunctionTask<Right> task(right);
+    push(&task);
+    std::exception_ptr error;
+    try {
+      left();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    // Задача живет в этом кадре стека, поэтому ждем ее даже при исключении
+    join(&task);
+    if (error == nullptr) {
+      error = task.error;
+    }
+    if (error != nullptr) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  template<typename F>
+  struct FunctionTask : Task {
+    explicit FunctionTask(F& function) : function(function) {
+      this->run = &FunctionTask::execute;
+    }
+
+    static void execute(Task* base) {
+      FunctionTask* task = static_cast<FunctionTask*>(base);
+      try {
+        task->function();
+      } catch (...) {
+        task->error = std::current_exception();
+      }
+      task->done.store(true, std::memory_order_release);
+    }
+
+    F& function;
+    std::exception_ptr error;
+  };
+
+  // Рабочий поток, которому принадлежит текущий поток, в рамках данного пула
+  struct Current {
+    const ThreadPool* pool = nullptr;
+    std::size_t index = 0;
+  };
+
+  static Current& current() noexcept {
+    thread_local Current value;
+    return value;
+  }
+
+  void push(Task* task) {
+    Current& self = current();
+    std::size_t index = self.pool == this
+        ? self.index
+        : next_external_.fetch_add(1, std::memory_order_relaxed) % worker_count_;
+    Worker& worker = workers_[index];
+    {
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      task->prev = worker.tail;
+      task->next = nullptr;
+      if (worker.tail != nullptr) {
+        worker.tail->next = task;
+      } else {
+        worker.head = task;
+      }
+      worker.tail = task;
+      pending_.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+      // Захват мьютекса упорядочивает увеличение pending_ с проверкой в workerLoop
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_one();
+  }
+
+  Task* popTail(Worker& worker) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    Task* task = worker.tail;
+    if (task != nullptr) {
+      worker.tail = task->prev;
+      if (worker.tail != nullptr) {
+        worker.tail->next = nullptr;
+      } else {
+        worker.head = nullptr;
+      }
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  Task* popHead(Worker& worker) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    Task* task = worker.head;
+    if (task != nullptr) {
+      worker.head = task->next;
+      if (worker.head != nullptr) {
+        worker.head->prev = nullptr;
+      } else {
+        worker.tail = nullptr;
+      }
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  // Своя очередь с конца, затем чужие с начала
+  Task* findTask() {
+    Current& self = current();
+    std::size_t start = 0;
+    if (self.pool == this) {
+      if (Task* task = popTail(workers_[self.index])) {
+        return task;
+      }
+      start = self.index + 1;
+    }
+    for (std::size_t i = 0; i < worker_count_; ++i) {
+      if (Task* task = popHead(workers_[(start + i) % worker_count_])) {
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+  void join(Task* task) {
+    while (!task->done.load(std::memory_order_acquire)) {
+      if (Task* other = findTask()) {
+        other->run(other);
+      } else {
+        std::this_thread::yield(); // Задачу выполняет другой поток
+      }
+    }
+  }
+
+  void workerLoop(std::size_t index) {
+    current() = Current{this, index};
+    while (true) {
+      if (Task* task = findTask()) {
+        task->run(task);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      wake_.wait(lock, [this] {
+        return stop_ || pending_.load(std::memory_order_relaxed) != 0;
+      });
+      if (stop_) {
+        return;
+      }
+    }
+  }
+
+  std::unique_ptr<Worker[]> workers_;
+  const std::size_t worker_count_;
+  std::atomic<std::size_t> pending_{0}; // Задачи, лежащие в очередях
+  std::atomic<std::size_t> next_external_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+};